@@ -98,6 +98,27 @@ class AbsDatabase {
          */
         virtual bool QueryBuffer(const char* key, size_t keySize, std::string& value) = 0;
 
+        /**
+         * @brief insert the (key, value) pair only if the key is absent (a single
+         * lookup, without the query-before-insert)
+         * 
+         * @param key 
+         * @param keySize 
+         * @param buffer 
+         * @param bufferSize 
+         * @return true inserted
+         * @return false the key already exists
+         */
+        virtual bool InsertOnlyBuffer(const char* key, size_t keySize, const char* buffer,
+            size_t bufferSize) = 0;
+
+        /**
+         * @brief reserve the space for a batch of incoming items
+         * 
+         * @param itemNum the number of incoming items
+         */
+        virtual void Reserve(size_t itemNum) = 0;
+
 
 };
 
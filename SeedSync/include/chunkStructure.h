@@ -122,6 +122,7 @@ typedef struct {
     // phase-1
     uint64_t total_chunk_num;
     uint64_t total_chunk_size;
+    uint64_t total_suppressed_num;
     // phase-3
     uint64_t total_unique_num;
     uint64_t total_unique_size;
@@ -160,6 +161,7 @@ typedef struct {
 typedef struct {
     uint8_t sim_tag; // sim; base; non-sim
     uint8_t baseHash[CHUNK_HASH_SIZE];
+    uint8_t queryHash[CHUNK_HASH_SIZE]; // index key of the chunk (for delta depth)
     uint32_t containerID; // the ID to current fetch buffer
     uint32_t offset;
     uint32_t length;
@@ -434,6 +436,8 @@ typedef struct {
     uint64_t sendRecipeBatchSize;
     uint64_t sendMetaBatchSize;
     uint64_t enclaveCacheItemNum;
+    uint64_t maxDeltaDepth;
+    uint64_t sentFPCacheItemNum;
 } SyncEnclaveConfig_t;
 
 #endif
\ No newline at end of file
@@ -143,7 +143,9 @@ enum LOCK_TYPE {SESSION_LCK_WRITE = 0, SESSION_LCK_READ, TOP_K_LCK_WRITE,
     TOP_K_LCK_READ};
 
 // for sync protocol
-enum SYNC_OPT_TYPE {SYNC_OPT = 0, WAIT_OPT};
+enum SYNC_OPT_TYPE {SYNC_OPT = 0, WAIT_OPT, LOCAL_OPT, BI_SYNC_OPT, BI_WAIT_OPT, DAEMON_OPT};
+// the order of the files in a session (mtime: as selected, i.e., the recipes by mtime)
+enum SYNC_SCHEDULE_TYPE {SCHEDULE_MTIME = 0, SCHEDULE_SIZE, SCHEDULE_PRIORITY, SCHEDULE_FAIR_SHARE};
 
 enum SYNC_PROTOCOL_SET {SYNC_LOGIN = 0, SYNC_LOGIN_RESPONSE, SYNC_FILE_NAME,
     SYNC_FILE_NAME_END_FLAG,
@@ -157,7 +159,50 @@ enum SYNC_PROTOCOL_SET {SYNC_LOGIN = 0, SYNC_LOGIN_RESPONSE, SYNC_FILE_NAME,
     SYNC_BASE_HASH, SYNC_BASE_HASH_END_FLAG, FILE_END_BASE_HASH,
     SYNC_DATA, FILE_END_SYNC_DATA, SYNC_DATA_END_FLAG,
     SYNC_FILE_START,
-    SYNC_FILE_END};
+    SYNC_FILE_END,
+    SYNC_NACK_FP, FILE_END_NACK_FP, SYNC_NACK_END,
+    SYNC_CREDIT,
+    SYNC_CHECKPOINT, SYNC_CHECKPOINT_ACK,
+    SYNC_RECIPE_LIST, SYNC_RECIPE_LIST_END,
+    SYNC_STOP};
+
+// for the multiplexed sync connection (all phases over one connection)
+static const uint32_t MUX_PHASE_NUM = 7; // indexed by the phase id (1-6)
+static const uint32_t SYNC_SEND_PHASE_NUM = 5; // the phases with a sender (1-5)
+static const uint32_t MUX_FRAME_HEAD_SIZE = sizeof(uint32_t) + sizeof(uint8_t);
+static const uint32_t MUX_RECV_QUEUE_SIZE = 64;
+static const uint32_t MUX_READ_BUF_SIZE = 64 * 1024;
+static const int MUX_POLL_TIMEOUT_MS = 10;
+static const uint8_t MUX_CREDIT_FLAG = 0x80; // credit frame: flag | send phase id
+
+// for the credit-based flow control between phases
+static const int FLOW_CREDIT_POLL_MS = 10;
+
+// for the TLS session resumption
+#define SSL_SESSION_ID_CONTEXT "SeedSync"
+static const long SSL_SESSION_TIMEOUT = 24 * 3600; // in seconds
+static const int SSL_TICKET_WAIT_MS = 100;
+
+// for reading the recipes (phase-1) in large aligned blocks (also for O_DIRECT)
+static const uint32_t RECIPE_IO_ALIGN = 4096;
+
+// for the incremental sync (recipe watermark)
+static const uint32_t WATERMARK_READ_BUF_SIZE = 1024 * 1024;
+
+// for the daemon mode (inotify events of the recipe dir)
+static const uint32_t DAEMON_EVENT_BUF_SIZE = 64 * 1024;
+static const int DAEMON_POLL_MS = 100; // check the stop flag while waiting
+
+// for the graceful stop (SIGTERM)
+static const uint32_t DRAIN_POLL_MS = 100;
+
+// for the blocking message queue
+static const uint32_t MQ_SPIN_NUM = 1024; // try times before backing off in push
+static const uint32_t MQ_PUSH_BACKOFF_US = 50;
+static const int64_t MQ_WAIT_TIMEOUT_US = 10000; // bound the wait in pop (for shutdown)
+
+// the num of recv buffers per phase (batch-granular MQ entries)
+static const uint32_t SYNC_BATCH_POOL_SIZE = 32;
 
 static const uint32_t MAX_MSG_TYPE_IN_BATCH = 2;
 
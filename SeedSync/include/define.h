@@ -13,6 +13,7 @@
 
 #include <bits/stdc++.h>
 #include <boost/filesystem.hpp>
+#include <fcntl.h>
 #include <getopt.h>
 #include <iomanip>
 #include <pthread.h>
@@ -223,5 +224,76 @@ inline uint64_t GetStrongSeed()
     return c;
 }
 
+/**
+ * @brief write the whole buffer to the fd
+ *
+ * @param fd the file descriptor
+ * @param buf the buffer
+ * @param len the length in byte
+ * @return true success
+ * @return false fail
+ */
+inline bool WriteAll(int fd, const uint8_t* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+/**
+ * @brief fsync the directory to persist the new directory entries
+ *
+ * @param dir_path the directory path
+ */
+inline void SyncDir(const std::string& dir_path)
+{
+    int dir_fd = open(dir_path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        return;
+    }
+    fsync(dir_fd);
+    close(dir_fd);
+    return;
+}
+
+/**
+ * @brief replace a small file atomically: write a tmp file, fsync, rename, 
+ * then fsync the parent dir (a crash keeps either the old or the new one)
+ *
+ * @param file_path the file path
+ * @param content the new content
+ * @return true success
+ * @return false fail (the old file is kept)
+ */
+inline bool PersistFile(const std::string& file_path, const std::string& content)
+{
+    std::string tmp_path = file_path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (!WriteAll(fd, (const uint8_t*)content.c_str(), content.size()) || fsync(fd) != 0) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+    if (rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        return false;
+    }
+
+    std::string dir_path = boost::filesystem::path(file_path).parent_path().string();
+    SyncDir(dir_path.empty() ? "." : dir_path);
+    return true;
+}
+
 } // namespace tool
 #endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+/**
+ * @file flow_credit.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the credits of a sender, i.e., the num of batches it can send before 
+ * the receiver consumes them
+ * @version 0.1
+ * @date 2024-08-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef FLOW_CREDIT_H
+#define FLOW_CREDIT_H
+
+#include "configure.h"
+#include <mutex>
+#include <condition_variable>
+
+class FlowCredit {
+    private:
+        string my_name_ = "FlowCredit";
+
+        // the window advertised by the receiver
+        uint64_t window_;
+        uint64_t credit_num_;
+
+        std::mutex credit_mutex_;
+        std::condition_variable credit_cond_;
+
+    public:
+        /**
+         * @brief Construct a new Flow Credit object
+         *
+         * @param window
+         */
+        FlowCredit(uint64_t window);
+
+        /**
+         * @brief Destroy the Flow Credit object
+         *
+         */
+        ~FlowCredit();
+
+        /**
+         * @brief take a credit, wait until the receiver returns one if none left
+         *
+         */
+        void Acquire();
+
+        /**
+         * @brief take a credit without waiting
+         *
+         * @return true success
+         * @return false no credit left
+         */
+        bool TryAcquire();
+
+        /**
+         * @brief return the credits (the batches consumed by the receiver)
+         *
+         * @param credit_num
+         */
+        void Grant(uint64_t credit_num);
+
+        /**
+         * @brief reset the credits to the whole window (for a new connection)
+         *
+         */
+        void Reset();
+};
+
+#endif
@@ -104,6 +104,26 @@ class InMemoryDatabase : public AbsDatabase {
          */
         bool QueryBuffer(const char* key, size_t keySize, std::string& value);
 
+        /**
+         * @brief insert the (key, value) pair only if the key is absent
+         * 
+         * @param key 
+         * @param keySize 
+         * @param buffer 
+         * @param bufferSize 
+         * @return true inserted
+         * @return false the key already exists
+         */
+        bool InsertOnlyBuffer(const char* key, size_t keySize, const char* buffer,
+            size_t bufferSize);
+
+        /**
+         * @brief reserve the space for a batch of incoming items
+         * 
+         * @param itemNum the number of incoming items
+         */
+        void Reserve(size_t itemNum);
+
 };
 
 #endif
\ No newline at end of file
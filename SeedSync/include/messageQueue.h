@@ -19,6 +19,8 @@
 #include <boost/lockfree/queue.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <thread>
+#include <chrono>
 
 
 template <class T>
@@ -28,7 +30,9 @@ class MessageQueue {
         // boost::lockfree::queue<T, boost::lockfree::fixed_sized<false>> lockFreeQueue_{0};
         // boost::lockfree::queue<T, boost::lockfree::capacity<QUEUE_SIZE>> lockFreeQueue_;
         // moodycamel::ConcurrentQueue<T>* lockFreeQueue_;
-        moodycamel::ReaderWriterQueue<T>* lockFreeQueue_;
+        // moodycamel::ReaderWriterQueue<T>* lockFreeQueue_;
+        // with a semaphore for the consumer to sleep on
+        moodycamel::BlockingReaderWriterQueue<T>* lockFreeQueue_;
 
     public:
         // to show whether the whole process is done
@@ -43,7 +47,7 @@ class MessageQueue {
         MessageQueue(uint32_t maxQueueSize) {
             // testpointer = new boost::lockfree::queue<T>(1);
             // lockFreeQueue_ = new moodycamel::ConcurrentQueue<T>(QUEUE_SIZE);
-            lockFreeQueue_ = new moodycamel::ReaderWriterQueue<T>(maxQueueSize);
+            lockFreeQueue_ = new moodycamel::BlockingReaderWriterQueue<T>(maxQueueSize);
             done_ = false;
             file_done_ = false;
         }
@@ -72,8 +76,14 @@ class MessageQueue {
          */
         bool Push(T& data) {
             // while (!lockFreeQueue_.push(data)) {
+            uint32_t spin_num = 0;
             while (!lockFreeQueue_->try_enqueue(data)) {
-                ;
+                // the queue is full: spin for a while, then back off
+                if (spin_num < MQ_SPIN_NUM) {
+                    spin_num ++;
+                    continue;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(MQ_PUSH_BACKOFF_US));
             }
             return true;
         }
@@ -90,6 +100,18 @@ class MessageQueue {
             return lockFreeQueue_->try_dequeue(data);
         }
 
+        /**
+         * @brief pop data from the queue, wait (spin, then sleep) if it is empty
+         * 
+         * @param data the original data
+         * @return true success
+         * @return false timeout (the caller can check the done flag)
+         */
+        bool PopWait(T& data) {
+            // the semaphore spins for a bounded time before sleeping in the kernel
+            return lockFreeQueue_->wait_dequeue_timed(data, MQ_WAIT_TIMEOUT_US);
+        }
+
         /**
          * @brief Decide whether the queue is empty
          * 
@@ -17,12 +17,16 @@
 #include "sync_configure.h"
 #include "sync_data_writer.h"
 #include "phase_sender.h"
+#include "sync_transport.h"
+#include "sync_buffer_pool.h"
+#include "sync_checkpoint.h"
 #include "stream_phase_1_thd.h"
 #include "stream_phase_2_thd.h"
 #include "stream_phase_3_thd.h"
 #include "stream_phase_4_thd.h"
 #include "stream_phase_5_thd.h"
 #include "../build/src/Enclave/storeEnclave_u.h"
+#include <atomic>
 
 extern SyncConfigure sync_config;
 
@@ -36,19 +40,26 @@ class PhaseRecv {
         SSLConnection* recv_channel_;
         pair<int, SSL*> recv_conn_record_;
 
+        // the shared transport, e.g., the mux (nullptr: use the dedicated connection)
+        SyncTransport* transport_ = nullptr;
+
         // config
         uint64_t recv_meta_batch_size_;
         uint64_t recv_data_batch_size_;
         // recv batch buffer
         SendMsgBuffer_t recv_buf_;
 
-        // MQs of sync protocol phases
-        MessageQueue<StreamPhase1MQ_t>* stream_p1_MQ_;
-        MessageQueue<StreamPhase2MQ_t>* stream_p2_MQ_;
-        MessageQueue<StreamPhase3MQ_t>* stream_p3_MQ_;
-        MessageQueue<StreamPhase4MQ_t>* stream_p4_MQ_;
+        // MQs of sync protocol phases (phase 2-5: one entry per received batch)
+        MessageQueue<StreamBatchMQ_t>* stream_batch_MQ_;
         MessageQueue<StreamPhase5MQ_t>* stream_p5_MQ_;
 
+        // recv buffers handed over to the phase thread (phase 2-5)
+        SyncBufferPool* batch_pool_ = nullptr;
+        SyncBatch_t* cur_batch_ = nullptr;
+
+        // the credits to return to the sender (over the dedicated connection)
+        std::atomic<uint64_t> pending_credit_num_{0};
+
         // for writer
         SyncDataWriter* sync_data_writer_obj_;
 
@@ -71,37 +82,126 @@ class PhaseRecv {
         SyncEnclaveInfo_t sync_enclave_info_;
         sgx_enclave_id_t eid_sgx_;
 
+        // for the files done in dest (source side)
+        uint64_t done_file_num_ = 0;
+        std::mutex file_done_mutex_;
+        std::condition_variable file_done_cond_;
+
+        // the checkpoint manifest (source side, nullptr: disabled)
+        SyncCheckpoint* checkpoint_ = nullptr;
+        // the index of the dest of this connection (fan-out)
+        uint32_t dest_idx_ = 0;
+
+        // the recipes of the other cloud (bidirectional sync, phase-2)
+        vector<string> peer_recipe_list_;
+        bool is_peer_list_done_ = false;
+        // one session only, exit at its end instead of waiting for the next
+        bool is_one_session_ = false;
+        // for the graceful stop (dest side, hold file_done_mutex_)
+        bool is_in_session_ = false;
+        bool is_draining_ = false;
+        // set once the dest asks to stop (source side, nullptr: ignored)
+        volatile sig_atomic_t* stop_flag_ = nullptr;
+
+        // for resending the chunks failing the integrity check (per file id)
+        std::unordered_map<uint32_t, uint64_t> resend_round_;
+        std::unordered_map<uint32_t, uint64_t> resend_chunk_num_;
 
-    public:
         /**
-         * @brief Construct a new Phase Recv object
+         * @brief check the written chunks of a file, ask the source to resend 
+         * the failed ones (via the phase-4 channel)
          * 
-         * @param recv_channel 
-         * @param recv_conn_record 
-         * @param p1_mq 
+         * @param file_id 
+         * @return true if some chunks need to be resent
+         * @return false 
          */
-        PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_record, 
-            MessageQueue<StreamPhase1MQ_t>* mq, uint8_t phase_id);
+        bool SendNack(uint32_t file_id);
 
         /**
-         * @brief Construct a new Phase Recv object
+         * @brief recv a message of this phase
          * 
-         * @param recv_channel 
-         * @param recv_conn_record 
-         * @param p3_mq 
+         * @param client_ssl 
+         * @param recv_size 
+         * @return true 
+         * @return false the connection is closed
          */
-        PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_record, 
-            MessageQueue<StreamPhase3MQ_t>* p3_mq, uint8_t phase_id);
+        bool RecvMsg(SSL* client_ssl, uint32_t& recv_size);
 
         /**
-         * @brief Construct a new Phase Recv object
+         * @brief clear the closed connection
+         * 
+         * @param client_ssl 
+         */
+        void CloseConn(SSL* client_ssl);
+
+        /**
+         * @brief wait for the connection of the next file
+         * 
+         * @param client_ssl 
+         */
+        void NextConn(SSL*& client_ssl);
+
+        /**
+         * @brief return the credits of the consumed batches to the sender
+         * 
+         * @param credit_num 
+         */
+        void ReturnCredit(uint32_t credit_num);
+
+        /**
+         * @brief send the pending credits over the dedicated connection
+         * 
+         * @param client_ssl 
+         */
+        void SendPendingCredit(SSL* client_ssl);
+
+        /**
+         * @brief a message of a session arrives (dest side)
+         * 
+         * @return true 
+         * @return false draining, refuse a new session
+         */
+        bool EnterSession();
+
+        /**
+         * @brief the session ends (dest side)
+         * 
+         */
+        void LeaveSession();
+
+        /**
+         * @brief check whether a failed recv is the end of a broken session 
+         * on the shared transport (dest side), then drop its state
+         * 
+         * @return true wait for the next session
+         * @return false the transport is closed
+         */
+        bool ResetSession();
+
+        /**
+         * @brief hand over the current recv buffer to the phase thread
+         * 
+         */
+        void PushBatch();
+
+        /**
+         * @brief notify the phase thread of the file end
+         * 
+         */
+        void PushFileEnd();
+
+
+    public:
+        /**
+         * @brief Construct a new Phase Recv object (phase 2-5)
          * 
          * @param recv_channel 
          * @param recv_conn_record 
-         * @param p4_mq 
+         * @param mq 
+         * @param phase_id 
          */
         PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_record, 
-            MessageQueue<StreamPhase4MQ_t>* p4_mq, uint8_t phase_id);
+            MessageQueue<StreamBatchMQ_t>* mq, uint8_t phase_id);
 
         /**
          * @brief Construct a new Phase Recv object
@@ -138,6 +238,47 @@ class PhaseRecv {
          */
         void SetDoneFlag();
 
+        /**
+         * @brief wait until the given number of files are done in dest
+         * 
+         * @param file_num 
+         */
+        void WaitFileDone(uint64_t file_num);
+
+        /**
+         * @brief wait for the recipe list of the other cloud (bidirectional sync)
+         * 
+         * @param recipe_list 
+         */
+        void WaitPeerRecipeList(vector<string>& recipe_list);
+
+        /**
+         * @brief exit at the end of the current session (bidirectional sync)
+         * 
+         */
+        void SetOneSession();
+
+        /**
+         * @brief refuse the next session (dest side, the first phase of a session)
+         * 
+         */
+        void Drain();
+
+        /**
+         * @brief check whether a session is in progress (dest side)
+         * 
+         * @return true 
+         * @return false 
+         */
+        bool IsInSession();
+
+        /**
+         * @brief Get the number of files done in dest
+         * 
+         * @return uint64_t 
+         */
+        uint64_t GetDoneFileNum();
+
         /**
          * @brief Set the Sender Obj object
          * 
@@ -152,6 +293,15 @@ class PhaseRecv {
          */
         void SetPhase1Obj(StreamPhase1Thd* stream_phase_1_obj, string& filename);
 
+        /**
+         * @brief Set the Stop Flag object, set by the stop request of the dest
+         * 
+         * @param stop_flag 
+         */
+        void SetStopFlag(volatile sig_atomic_t* stop_flag) {
+            stop_flag_ = stop_flag;
+        }
+
         /**
          * @brief Set the First Flag object
          * 
@@ -180,6 +330,26 @@ class PhaseRecv {
         void SetPhaseObjForSrcLog(StreamPhase3Thd* stream_phase_3_obj, 
             StreamPhase5Thd* stream_phase_5_obj);
 
+        /**
+         * @brief Set the shared transport (instead of the dedicated connection)
+         * 
+         * @param transport 
+         */
+        void SetTransport(SyncTransport* transport) {
+            transport_ = transport;
+        }
+
+        /**
+         * @brief Set the Checkpoint object (phase-5 of source)
+         * 
+         * @param checkpoint 
+         * @param dest_idx the index of the dest of this connection
+         */
+        void SetCheckpoint(SyncCheckpoint* checkpoint, uint32_t dest_idx) {
+            checkpoint_ = checkpoint;
+            dest_idx_ = dest_idx;
+        }
+
         /**
          * @brief Set the Sgx Eid object
          * 
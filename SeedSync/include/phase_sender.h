@@ -14,6 +14,13 @@
 
 #include "sslConnection.h"
 #include "chunkStructure.h"
+#include "sync_configure.h"
+#include "sync_transport.h"
+#include "flow_credit.h"
+#include "sync_rate_limiter.h"
+#include <poll.h>
+
+extern SyncConfigure sync_config;
 
 class PhaseSender {
     private:
@@ -23,7 +30,52 @@ class PhaseSender {
         SSLConnection* send_channel_;
         pair<int, SSL*> send_conn_record_;
 
+        // the shared transport, e.g., the mux (nullptr: use the dedicated connection)
+        SyncTransport* transport_ = nullptr;
+
         uint8_t phase_id_;
+
+        // the small messages waiting to be sent together (0 size: no buffering)
+        uint8_t* send_buf_ = nullptr;
+        uint32_t send_buf_size_ = 0;
+        uint32_t send_buf_offset_ = 0;
+
+        // the credits returned by the recv phase (nullptr: no flow control)
+        FlowCredit* flow_credit_ = nullptr;
+
+        // the sync-wide rate limit (nullptr: unlimited)
+        SyncRateLimiter* rate_limiter_ = nullptr;
+
+        // the phase-4 sender is shared by the phase-4 thread and the phase-6 recv 
+        // thread (nack), which may work on different files at once. only the write 
+        // holds it, the credits and rate tokens are taken before (the phase-6 thread 
+        // must not wait for the credits held by the phase-4 thread)
+        std::mutex send_mutex_;
+        // one thread reads the credits from the dedicated connection
+        std::mutex credit_mutex_;
+
+        /**
+         * @brief take a credit before sending a batch, wait for the recv phase 
+         * if none left
+         * 
+         */
+        void AcquireCredit();
+
+        /**
+         * @brief send out the buffered small messages
+         * 
+         */
+        void FlushSendBuf();
+
+        /**
+         * @brief send a message to the recv phase of the other cloud
+         * 
+         * @param data 
+         * @param size 
+         * @return true 
+         * @return false 
+         */
+        bool SendMsg(uint8_t* data, uint32_t size);
     
     public:
         /**
@@ -35,6 +87,14 @@ class PhaseSender {
          */
         PhaseSender(SSLConnection* send_channel, pair<int, SSL*> send_conn_record, uint8_t phase_id);
 
+        /**
+         * @brief Construct a new Phase Sender object over the shared transport
+         * 
+         * @param transport 
+         * @param phase_id 
+         */
+        PhaseSender(SyncTransport* transport, uint8_t phase_id);
+
         /**
          * @brief Destroy the Phase Sender object
          * 
@@ -65,6 +125,53 @@ class PhaseSender {
          * 
          */
         void LoginConnect();
+
+        /**
+         * @brief notify the start of a file on the (persistent) connection
+         * 
+         * @param file_name 
+         * @param file_id the id carried by all the batches of the file
+         */
+        void FileStart(string& file_name, uint32_t file_id);
+
+        /**
+         * @brief send a checkpoint marker of a file (or its ack from dest)
+         * 
+         * @param message_type SYNC_CHECKPOINT / SYNC_CHECKPOINT_ACK
+         * @param file_id 
+         * @param entry_offset the recipe entries before the marker
+         */
+        void Checkpoint(int message_type, uint32_t file_id, uint32_t entry_offset);
+
+        /**
+         * @brief send the local recipe names to the other cloud (bidirectional sync)
+         * 
+         * @param recipe_list 
+         */
+        void RecipeList(vector<string>& recipe_list);
+
+        /**
+         * @brief notify no more files on the connection (end of the sync session)
+         * 
+         */
+        void FileEnd();
+
+        /**
+         * @brief ask the source to stop issuing files (graceful stop of the dest)
+         * 
+         * @return true 
+         * @return false the session has ended
+         */
+        bool StopRequest();
+
+        /**
+         * @brief Set the Rate Limiter object
+         * 
+         * @param rate_limiter 
+         */
+        void SetRateLimiter(SyncRateLimiter* rate_limiter) {
+            rate_limiter_ = rate_limiter;
+        }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+/**
+ * @file recipe_reader.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief read the recipes of phase-1 in large aligned blocks, with read-ahead
+ * @version 0.1
+ * @date 2024-09-11
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef RECIPE_READER_H
+#define RECIPE_READER_H
+
+#include "configure.h"
+#include "sync_configure.h"
+#include <future>
+#include <fcntl.h>
+
+extern SyncConfigure sync_config;
+
+/**
+ * three reusable block buffers: the block being consumed, the next block of the
+ * current recipe (read in the background), and the first block of the next
+ * recipe (prefetched while the current one is being sent). with O_DIRECT, the
+ * one-shot recipe reads bypass the page cache; otherwise, the cached pages are
+ * dropped once a recipe is read.
+ */
+class RecipeReader {
+    private:
+        string my_name_ = "RecipeReader";
+
+        uint64_t block_size_;
+        bool is_direct_io_;
+
+        // the block buffers (indexed by the roles below)
+        uint8_t* block_buf_[3];
+        uint32_t cur_idx_ = 0;
+        uint32_t ahead_idx_ = 1;
+        uint32_t prefetch_idx_ = 2;
+
+        // the current recipe
+        int fd_ = -1;
+        uint64_t cur_block_off_ = 0;
+        size_t cur_block_len_ = 0;
+        size_t cur_pos_ = 0;
+        std::future<ssize_t> ahead_read_;
+
+        // the prefetched recipe
+        string prefetch_path_;
+        int prefetch_fd_ = -1;
+        std::future<ssize_t> prefetch_read_;
+
+        /**
+         * @brief open a recipe file (fall back to the buffered I/O if O_DIRECT
+         * is not supported)
+         *
+         * @param recipe_path
+         * @return int the fd (-1: fail)
+         */
+        int OpenFile(string& recipe_path);
+
+        /**
+         * @brief read a block in the background
+         *
+         * @param fd
+         * @param buf
+         * @param offset
+         * @return std::future<ssize_t>
+         */
+        std::future<ssize_t> ReadBlockAsync(int fd, uint8_t* buf, uint64_t offset);
+
+        /**
+         * @brief wait for a background read
+         *
+         * @param block_read
+         * @return size_t the read size
+         */
+        size_t WaitBlock(std::future<ssize_t>& block_read);
+
+        /**
+         * @brief drop the prefetched recipe
+         *
+         */
+        void DropPrefetch();
+
+    public:
+        /**
+         * @brief Construct a new Recipe Reader object
+         *
+         */
+        RecipeReader();
+
+        /**
+         * @brief Destroy the Recipe Reader object
+         *
+         */
+        ~RecipeReader();
+
+        /**
+         * @brief start to read the first block of the next recipe
+         *
+         * @param recipe_path
+         */
+        void Prefetch(string& recipe_path);
+
+        /**
+         * @brief open a recipe (use the prefetched block if any)
+         *
+         * @param recipe_path
+         * @return true
+         * @return false fail to open
+         */
+        bool Open(string& recipe_path);
+
+        /**
+         * @brief move to the given offset of the recipe
+         *
+         * @param offset
+         */
+        void Seek(uint64_t offset);
+
+        /**
+         * @brief read the recipe into the buffer
+         *
+         * @param buf
+         * @param len
+         * @return size_t the read size (less than len at the recipe end)
+         */
+        size_t Read(uint8_t* buf, size_t len);
+
+        /**
+         * @brief close the current recipe
+         *
+         */
+        void Close();
+};
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * @file recipe_watcher.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief watch the recipe dir of the source for the completed recipes (daemon mode)
+ * @version 0.1
+ * @date 2024-09-16
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef RECIPE_WATCHER_H
+#define RECIPE_WATCHER_H
+
+#include "configure.h"
+#include "sync_configure.h"
+#include <sys/inotify.h>
+#include <poll.h>
+#include <signal.h>
+#include <unordered_set>
+
+extern SyncConfigure sync_config;
+
+/**
+ * a recipe is complete once its writer closes it (or it is moved into the dir).
+ * only the recipes named by the events are checked against the watermark, such 
+ * that a recipe still in writing is not picked; the lost events (e.g., queue 
+ * overflow) fall back to a scan of the whole dir. a burst of recipes is gathered 
+ * until the dir is quiet for the settle time.
+ */
+class RecipeWatcher {
+    private:
+        string my_name_ = "RecipeWatcher";
+
+        string recipe_root_path_;
+        string recipe_suffix_;
+        uint64_t settle_ms_;
+
+        int inotify_fd_ = -1;
+        uint8_t* event_buf_;
+
+        // set by the graceful stop (nullptr: never stop)
+        volatile sig_atomic_t* stop_flag_ = nullptr;
+
+        // the completed recipes of the current wait
+        std::unordered_set<string> recipe_name_set_;
+        bool is_lost_ = false;
+
+        /**
+         * @brief wait for the events, and check the stop flag meanwhile
+         *
+         * @param timeout_ms -1: until an event or the stop
+         * @return int the poll result (-1: error or stop)
+         */
+        int PollEvents(int timeout_ms);
+
+        /**
+         * @brief read the pending events, and collect the completed recipes
+         *
+         * @return int the num of the events of the recipes (-1: error)
+         */
+        int ReadEvents();
+
+    public:
+        /**
+         * @brief Construct a new Recipe Watcher object
+         *
+         * @param recipe_root_path
+         */
+        RecipeWatcher(string recipe_root_path);
+
+        /**
+         * @brief Destroy the Recipe Watcher object
+         *
+         */
+        ~RecipeWatcher();
+
+        /**
+         * @brief Set the Stop Flag object
+         *
+         * @param stop_flag
+         */
+        void SetStopFlag(volatile sig_atomic_t* stop_flag);
+
+        /**
+         * @brief wait until some recipes are completed and the dir settles
+         *
+         * @param recipe_name_list the completed recipes
+         * @param is_lost some events are lost, scan the whole dir
+         * @return true
+         * @return false the watch fails or is stopped
+         */
+        bool WaitRecipes(vector<string>& recipe_name_list, bool& is_lost);
+};
+
+#endif
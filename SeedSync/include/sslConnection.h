@@ -19,6 +19,10 @@
 #include <sys/types.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <sys/uio.h> // for iovec
+#include <poll.h>
+#include <fcntl.h>
+#include <mutex>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -42,6 +46,48 @@ class SSLConnection {
         // the listen file descriptor
         int listenFd_;
 
+        // whether to offload the record crypto to the kernel (kTLS)
+        bool isKTLS_ = false;
+
+        // the latest session from the server (client side), for resumption
+        SSL_SESSION* cachedSession_ = NULL;
+        std::mutex sessionMutex_;
+
+        /**
+         * @brief keep the new session (ticket) issued by the server
+         * 
+         * @param connection the pointer to the connection
+         * @param session the new session
+         * @return int 1: the session is kept
+         */
+        static int NewSessionCallback(SSL* connection, SSL_SESSION* session);
+
+        /**
+         * @brief process the session tickets sent after the handshake
+         * 
+         * @param socketFd the socket of the connection
+         * @param connection the pointer to the connection
+         */
+        void WaitSessionTicket(int socketFd, SSL* connection);
+
+        /**
+         * @brief check whether the kernel takes over the record crypto of the connection
+         * 
+         * @param connection the pointer to the connection
+         */
+        void CheckKTLS(SSL* connection);
+
+        /**
+         * @brief write the whole buffer to the given connection
+         * 
+         * @param connection the pointer to the connection
+         * @param data the pointer to the data buffer
+         * @param dataSize the size of the data
+         * @return true success
+         * @return false fail
+         */
+        bool WriteAll(SSL* connection, const uint8_t* data, size_t dataSize);
+
     public:
         /**
          * @brief Construct a new SSLConnection object
@@ -97,6 +143,18 @@ class SSLConnection {
          */
         bool SendData(SSL* connection, uint8_t* data, uint32_t dataSize);
 
+        /**
+         * @brief write the gathered buffers to the given connection as raw bytes,
+         * coalescing the small buffers into full TLS records
+         * 
+         * @param connection the pointer to the connection
+         * @param iov the list of buffers
+         * @param iovNum the number of buffers
+         * @return true success
+         * @return false fail
+         */
+        bool WriteDataV(SSL* connection, const struct iovec* iov, int iovNum);
+
         /**
          * @brief receive the data from the given connection
          * 
@@ -108,6 +166,13 @@ class SSLConnection {
          */
         bool ReceiveData(SSL* connection, uint8_t* data, uint32_t& receiveDataSize);
 
+        /**
+         * @brief offload the record crypto of the following connections to the
+         * kernel (kTLS), fall back to the user-space crypto if not supported
+         * 
+         */
+        void EnableKTLS();
+
         /**
          * @brief Get the Listen Fd object
          * 
@@ -17,10 +17,13 @@
 #include "configure.h"
 #include "absDatabase.h"
 #include "cryptoPrimitive.h"
+#include "sync_checkpoint.h"
+#include "recipe_reader.h"
 
 #include "../build/src/Enclave/storeEnclave_u.h"
 
 #include <map>
+#include <signal.h>
 
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
@@ -37,14 +40,28 @@ class StreamPhase1Thd {
 
         SendMsgBuffer_t send_batch_buf_;
         uint8_t* read_recipe_buf_;
+        RecipeReader* recipe_reader_;
+        // the recipe to prefetch after the current one is opened (empty: none)
+        string next_recipe_name_;
 
-        // for sending
-        PhaseSender* phase_sender_obj_;
+        // for sending (one sender per dest, the batches are shared by the dests)
+        vector<PhaseSender*> phase_sender_list_;
 
         string recipe_path_;
 
         uint64_t recipe_batch_size_;
 
+        // the id of the last file (the batches of different files are in the 
+        // pipeline at once)
+        uint32_t last_file_id_ = 0;
+
+        // for resuming the interrupted sync (nullptr: disabled)
+        SyncCheckpoint* checkpoint_ = nullptr;
+        uint64_t checkpoint_batch_num_;
+
+        // cut the current file at the next batch once set (graceful stop)
+        volatile sig_atomic_t* stop_flag_ = nullptr;
+
         // for ecall
         sgx_enclave_id_t eid_sgx_;
 
@@ -53,8 +70,18 @@ class StreamPhase1Thd {
          * @brief process one file recipe
          * 
          * @param recipe_path 
+         * @return true 
+         * @return false the file is cut by the stop (resumed from the checkpoint)
          */
-        void ProcessOneRecipe(string recipe_path);
+        bool ProcessOneRecipe(string recipe_path);
+
+        /**
+         * @brief start to read the recipe of the next file (while the current 
+         * one is being sent)
+         * 
+         * @param recipe_name 
+         */
+        void PrefetchRecipe(string& recipe_name);
 
         /**
          * @brief insert the batch into send MQ
@@ -92,8 +119,66 @@ class StreamPhase1Thd {
          * @brief sync a single file
          * 
          * @param file_name 
+         * @return true 
+         * @return false the file has been synced in the interrupted session, 
+         * or is cut by the stop
+         */
+        bool SyncRequest(string& file_name);
+
+        /**
+         * @brief sync a single file by its recipe name
+         * 
+         * @param recipe_name 
+         * @return true 
+         * @return false the file has been synced in the interrupted session, 
+         * or is cut by the stop
+         */
+        bool SyncRecipe(string& recipe_name);
+
+        /**
+         * @brief get the recipe name of a file
+         * 
+         * @param file_name 
+         * @return string 
+         */
+        string GetRecipeName(string& file_name);
+
+        /**
+         * @brief Set the recipe of the next file, read ahead once the current 
+         * one is opened
+         * 
+         * @param recipe_name 
+         */
+        void SetNextRecipe(string& recipe_name) {
+            next_recipe_name_ = recipe_name;
+        }
+
+        /**
+         * @brief Set the Stop Flag object
+         * 
+         * @param stop_flag 
+         */
+        void SetStopFlag(volatile sig_atomic_t* stop_flag) {
+            stop_flag_ = stop_flag;
+        }
+
+        /**
+         * @brief Set the Checkpoint object
+         * 
+         * @param checkpoint 
+         */
+        void SetCheckpoint(SyncCheckpoint* checkpoint) {
+            checkpoint_ = checkpoint;
+        }
+
+        /**
+         * @brief add the sender of another dest (fan-out)
+         * 
+         * @param phase_sender_obj 
          */
-        void SyncRequest(string& file_name);
+        void AddSender(PhaseSender* phase_sender_obj) {
+            phase_sender_list_.push_back(phase_sender_obj);
+        }
 };
 
 #endif
\ No newline at end of file
@@ -18,6 +18,7 @@
 #include "configure.h"
 #include "absDatabase.h"
 #include "cryptoPrimitive.h"
+#include "sync_buffer_pool.h"
 
 #include "../build/src/Enclave/storeEnclave_u.h"
 
@@ -36,7 +37,7 @@ class StreamPhase2Thd {
         sgx_enclave_id_t sgx_eid_;
 
         // for input MQ
-        MessageQueue<StreamPhase1MQ_t>* inputMQ_;
+        MessageQueue<StreamBatchMQ_t>* inputMQ_;
 
         // for out query
         AbsDatabase* out_chunk_db_;
@@ -54,10 +55,13 @@ class StreamPhase2Thd {
         OutChunkQuery_t debug_out_query_;
 
         /**
-         * @brief process one batch of fp list
+         * @brief process one batch of fp list (in place), the uni fp list is 
+         * written into process_batch_buf_
          * 
+         * @param fp_list 
+         * @param fp_num 
          */
-        void ProcessOneBatch();
+        void ProcessOneBatch(uint8_t* fp_list, uint32_t fp_num);
 
         /**
          * @brief send one batch of fp list
@@ -83,7 +87,7 @@ class StreamPhase2Thd {
          * @param out_fp_db 
          * @param eid_sgx 
          */
-        StreamPhase2Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase1MQ_t>* inputMQ,
+        StreamPhase2Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ,
             AbsDatabase* out_fp_db, sgx_enclave_id_t eid_sgx);
 
         /**
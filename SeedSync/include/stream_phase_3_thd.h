@@ -18,6 +18,7 @@
 #include "configure.h"
 #include "absDatabase.h"
 #include "cryptoPrimitive.h"
+#include "sync_buffer_pool.h"
 
 #include "../build/src/Enclave/storeEnclave_u.h"
 
@@ -34,9 +35,12 @@ class StreamPhase3Thd {
         
         // for Ecall
         sgx_enclave_id_t sgx_eid_;
+        // the ecall buffers in the enclave are shared by the threads of all 
+        // the dests (fan-out)
+        static std::mutex ecall_mutex_;
 
         // for input MQ
-        MessageQueue<StreamPhase2MQ_t>* inputMQ_;
+        MessageQueue<StreamBatchMQ_t>* inputMQ_;
 
         // for out query
         // the global chunk index should include chunk feature in value
@@ -45,15 +49,14 @@ class StreamPhase3Thd {
 
         SendMsgBuffer_t send_batch_buf_;
         ReqContainer_t req_containers_;
-        uint8_t* recv_buf_;
-        uint32_t recv_num_;
-        uint32_t recv_offset_;
 
         /**
-         * @brief process one batch of uni fp list, return the features
+         * @brief process one batch of uni fp list (in place), return the features
          * 
+         * @param unifp_list 
+         * @param unifp_num 
          */
-        void ProcessOneBatch();
+        void ProcessOneBatch(uint8_t* unifp_list, uint32_t unifp_num);
 
         /**
          * @brief insert the batch into send MQ
@@ -73,7 +76,7 @@ class StreamPhase3Thd {
          * @param out_fp_db 
          * @param eid_sgx 
          */
-        StreamPhase3Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase2MQ_t>* inputMQ,
+        StreamPhase3Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ,
             AbsDatabase* out_fp_db, sgx_enclave_id_t eid_sgx);
 
         /**
@@ -87,6 +90,12 @@ class StreamPhase3Thd {
          * 
          */
         void Run();
+
+        /**
+         * @brief Set the Done Flag object
+         * 
+         */
+        void SetDoneFlag();
 };
 
 #endif
\ No newline at end of file
@@ -18,6 +18,8 @@
 #include "configure.h"
 #include "absDatabase.h"
 #include "cryptoPrimitive.h"
+#include "sync_data_writer.h"
+#include "sync_buffer_pool.h"
 
 #include "../build/src/Enclave/storeEnclave_u.h"
 
@@ -36,15 +38,20 @@ class StreamPhase4Thd {
         sgx_enclave_id_t sgx_eid_;
 
         // for input MQ
-        MessageQueue<StreamPhase3MQ_t>* inputMQ_;
+        MessageQueue<StreamBatchMQ_t>* inputMQ_;
         
         SendMsgBuffer_t send_batch_buf_;
 
+        // for integrity check of the written chunks
+        SyncDataWriter* sync_data_writer_obj_ = nullptr;
+
         /**
-         * @brief process one batch of uni fp list, return the features
+         * @brief process one batch of features (in place), return the base hashes
          * 
+         * @param feature_list 
+         * @param feature_num 
          */
-        void ProcessOneBatch();
+        void ProcessOneBatch(uint8_t* feature_list, uint32_t feature_num);
 
         /**
          * @brief insert the batch into send MQ
@@ -63,7 +70,7 @@ class StreamPhase4Thd {
          * @param inputMQ 
          * @param eid_sgx 
          */
-        StreamPhase4Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase3MQ_t>* inputMQ,
+        StreamPhase4Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ,
             sgx_enclave_id_t eid_sgx);
 
         /**
@@ -83,6 +90,13 @@ class StreamPhase4Thd {
          * 
          */
         void SetDoneFlag();
+
+        /**
+         * @brief Set the Sync Data Writer object
+         * 
+         * @param sync_data_writer_obj 
+         */
+        void SetSyncDataWriter(SyncDataWriter* sync_data_writer_obj);
 };
 
 #endif
\ No newline at end of file
@@ -18,6 +18,7 @@
 #include "configure.h"
 #include "absDatabase.h"
 #include "cryptoPrimitive.h"
+#include "sync_buffer_pool.h"
 #include <future>
 
 #include "../build/src/Enclave/storeEnclave_u.h"
@@ -35,9 +36,12 @@ class StreamPhase5Thd {
         
         // for Ecall
         sgx_enclave_id_t sgx_eid_;
+        // the ecall buffers in the enclave are shared by the threads of all 
+        // the dests (fan-out)
+        static std::mutex ecall_mutex_;
 
         // for input MQ
-        MessageQueue<StreamPhase4MQ_t>* inputMQ_;
+        MessageQueue<StreamBatchMQ_t>* inputMQ_;
 
         // for out query
         AbsDatabase* out_fp_db_;
@@ -47,15 +51,16 @@ class StreamPhase5Thd {
         uint64_t total_base_size_ = 0;
         uint64_t total_delta_size_ = 0;
 
-        SendMsgBuffer_t recv_batch_buf_;
         SendMsgBuffer_t send_batch_buf_;
         ReqContainer_t req_containers_;
 
         /**
-         * @brief process one batch of uni fp list, return the features
+         * @brief process one batch of base hashes (in place), return the data
          * 
+         * @param in_buf 
+         * @param in_size 
          */
-        void ProcessOneBatch();
+        void ProcessOneBatch(uint8_t* in_buf, uint32_t in_size);
 
         /**
          * @brief insert the batch into send MQ
@@ -75,7 +80,7 @@ class StreamPhase5Thd {
          * @param out_fp_db 
          * @param eid_sgx 
          */
-        StreamPhase5Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase4MQ_t>* inputMQ, 
+        StreamPhase5Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ, 
             AbsDatabase* out_fp_db, sgx_enclave_id_t eid_sgx);
 
         /**
@@ -89,6 +94,12 @@ class StreamPhase5Thd {
          * 
          */
         void Run();
+
+        /**
+         * @brief Set the Done Flag object
+         * 
+         */
+        void SetDoneFlag();
 };
 
 #endif
\ No newline at end of file
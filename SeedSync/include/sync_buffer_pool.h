@@ -0,0 +1,99 @@
+/**
+ * @file sync_buffer_pool.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the pool of recv buffers handed over between PhaseRecv and StreamPhaseNThd
+ * @version 0.1
+ * @date 2024-08-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_BUFFER_POOL_H
+#define SYNC_BUFFER_POOL_H
+
+#include "configure.h"
+#include "chunkStructure.h"
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class SyncBufferPool;
+
+typedef struct {
+    SendMsgBuffer_t msg_buf; // the received msg (NetworkHead_t + data)
+    SyncBufferPool* pool; // the owner pool, for recycling
+} SyncBatch_t;
+
+// a whole received batch per MQ entry
+typedef struct {
+    SyncBatch_t* batch; // nullptr for file end
+    uint8_t is_file_end;
+    uint32_t file_id; // the file of the batch (the clientID of the msg header)
+} StreamBatchMQ_t;
+
+class SyncBufferPool {
+    private:
+        string my_name_ = "SyncBufferPool";
+
+        // the size of each buffer (including the header)
+        uint64_t buf_size_;
+
+        vector<SyncBatch_t*> all_batch_list_;
+        vector<SyncBatch_t*> free_batch_list_;
+        std::mutex pool_mutex_;
+        std::condition_variable pool_cond_;
+
+        // called when a buffer is recycled (e.g., return the credit to the sender)
+        std::function<void()> release_callback_;
+
+    public:
+        /**
+         * @brief Construct a new Sync Buffer Pool object
+         *
+         * @param buf_size the size of each buffer (including the header)
+         * @param buf_num
+         */
+        SyncBufferPool(uint64_t buf_size, uint32_t buf_num);
+
+        /**
+         * @brief Destroy the Sync Buffer Pool object
+         *
+         */
+        ~SyncBufferPool();
+
+        /**
+         * @brief get a free buffer (wait if all buffers are in use)
+         *
+         * @return SyncBatch_t*
+         */
+        SyncBatch_t* Get();
+
+        /**
+         * @brief recycle the buffer (by its single owner, the phase thread 
+         * processing it)
+         *
+         * @param batch
+         */
+        void Release(SyncBatch_t* batch);
+
+        /**
+         * @brief Get the Buf Size object
+         *
+         * @return uint64_t
+         */
+        uint64_t GetBufSize() {
+            return buf_size_;
+        }
+
+        /**
+         * @brief Set the Release Callback object
+         *
+         * @param release_callback
+         */
+        void SetReleaseCallback(std::function<void()> release_callback) {
+            release_callback_ = release_callback;
+        }
+};
+
+#endif
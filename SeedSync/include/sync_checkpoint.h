@@ -0,0 +1,124 @@
+/**
+ * @file sync_checkpoint.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the checkpoint manifest of the source, to resume an interrupted sync
+ * @version 0.1
+ * @date 2024-09-05
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_CHECKPOINT_H
+#define SYNC_CHECKPOINT_H
+
+#include "configure.h"
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <fcntl.h>
+
+/**
+ * the manifest records the recipes synced completely and, for the unfinished
+ * ones, the recipe entries acked by dest (i.e., the chunks before them are durable
+ * in dest). each update rewrites the manifest atomically (tmp file + rename), the
+ * manifest is removed once a whole session is done. with several dests (fan-out),
+ * a recipe entry counts as acked once all the dests have acked it.
+ */
+class SyncCheckpoint {
+    private:
+        string my_name_ = "SyncCheckpoint";
+
+        string checkpoint_name_;
+
+        // the recipes synced completely
+        std::unordered_set<string> done_file_set_;
+        // the acked recipe entries of the unfinished recipes
+        std::unordered_map<string, uint64_t> file_offset_list_;
+        // the recipes in the pipeline (file id -> recipe name)
+        std::unordered_map<uint32_t, string> inflight_file_list_;
+        // the acked recipe entries of each dest (file id -> offset per dest, 
+        // UINT64_MAX: done in the dest)
+        std::unordered_map<uint32_t, vector<uint64_t>> dest_offset_list_;
+        uint32_t dest_num_;
+
+        std::mutex checkpoint_mutex_;
+
+        /**
+         * @brief load the manifest of the last (interrupted) session
+         *
+         */
+        void Load();
+
+        /**
+         * @brief persist the manifest (hold checkpoint_mutex_)
+         *
+         */
+        void Persist();
+
+    public:
+        /**
+         * @brief Construct a new Sync Checkpoint object
+         *
+         * @param checkpoint_name the manifest path
+         * @param dest_num the num of dests sharing the source pipeline
+         */
+        SyncCheckpoint(string checkpoint_name, uint32_t dest_num);
+
+        /**
+         * @brief Destroy the Sync Checkpoint object
+         *
+         */
+        ~SyncCheckpoint();
+
+        /**
+         * @brief check whether the recipe has been synced completely
+         *
+         * @param recipe_name
+         * @return true
+         * @return false
+         */
+        bool IsFileDone(string& recipe_name);
+
+        /**
+         * @brief get the recipe entry to resume from
+         *
+         * @param recipe_name
+         * @return uint64_t 0 if not synced before
+         */
+        uint64_t GetResumeOffset(string& recipe_name);
+
+        /**
+         * @brief record the recipe of a file id (phase-1)
+         *
+         * @param file_id
+         * @param recipe_name
+         */
+        void StartFile(uint32_t file_id, string& recipe_name);
+
+        /**
+         * @brief dest has made the chunks before the recipe entry durable
+         *
+         * @param file_id
+         * @param entry_offset
+         * @param dest_idx
+         */
+        void Ack(uint32_t file_id, uint64_t entry_offset, uint32_t dest_idx);
+
+        /**
+         * @brief dest has checked all the chunks of the file
+         *
+         * @param file_id
+         * @param dest_idx
+         */
+        void FileDone(uint32_t file_id, uint32_t dest_idx);
+
+        /**
+         * @brief remove the manifest after all the files of the session are done
+         *
+         */
+        void Clear();
+};
+
+#endif
@@ -20,6 +20,26 @@
 
 using namespace std;
 
+// a time-of-day window with its own rate limit
+typedef struct {
+    uint32_t start_min; // minutes since 00:00 (local time)
+    uint32_t end_min;
+    uint64_t rate_limit_mbps; // 0 = unlimited
+} RateSchedule_t;
+
+// a dest of the source (fan-out: the phase-1 batches are shared by all the dests)
+typedef struct {
+    int id;
+    string ip;
+    int mux_recv_port;
+} SyncDest_t;
+
+// the weight of a dir in the fair-share schedule
+typedef struct {
+    string dir;
+    uint64_t weight;
+} SyncDirWeight_t;
+
 class SyncConfigure {
     private:
         string my_name_ = "SyncConfigure";
@@ -59,15 +79,76 @@ class SyncConfigure {
         int p4_recv_port_;
         int p4_send_port_;
         int p6_recv_port_;
+        int mux_recv_port_;
         string file_root_path_2_;
 
+        // the dests of the source (cloud-2 first, then the fan-out ones)
+        vector<SyncDest_t> dest_list_;
+
         // sender settings
         uint64_t send_data_batch_size_;
         uint64_t send_meta_batch_size_;
+        // the num of files in the pipeline at once (1: one file at a time)
+        uint64_t max_inflight_files_;
+        uint64_t recipe_read_size_;
+        bool is_recipe_direct_io_;
+        // the num of sent chunk fps kept in the enclave (0: send all the fps), 
+        // CHUNK_HASH_SIZE bytes of EPC each
+        uint64_t sent_fp_cache_item_;
 
         // enclave cache size
         uint64_t enclave_cache_size_;
 
+        // max depth of the delta chain in a sync batch
+        uint64_t max_delta_depth_;
+
+        // max rounds of resending the chunks failing the integrity check
+        uint64_t max_resend_round_;
+
+        // network settings
+        bool enable_mux_;
+        uint64_t send_buf_size_;
+        uint64_t flow_window_;
+        bool enable_ktls_;
+
+        // rate limit settings
+        uint64_t rate_limit_mbps_;
+        uint64_t rate_burst_size_;
+        uint64_t phase_weight_[SYNC_SEND_PHASE_NUM]; // phase 1-5
+        vector<RateSchedule_t> rate_schedule_;
+
+        /**
+         * @brief parse the time of day ("HH:MM")
+         * 
+         * @param time_str 
+         * @return uint32_t minutes since 00:00
+         */
+        uint32_t ParseTimeOfDay(string time_str);
+
+        // durability settings (group commit)
+        uint64_t group_commit_container_num_;
+        uint64_t group_commit_interval_ms_;
+        string index_delta_log_name_;
+        string commit_manifest_name_;
+
+        // resumable sync settings (checkpoint)
+        string sync_checkpoint_name_;
+        uint64_t checkpoint_batch_num_;
+
+        // incremental sync settings (recipe watermark)
+        string watermark_name_;
+
+        // daemon settings
+        uint64_t daemon_settle_ms_;
+
+        // graceful stop settings
+        uint64_t drain_timeout_sec_;
+
+        // schedule settings (the order of the files)
+        int schedule_policy_;
+        string priority_list_name_;
+        vector<SyncDirWeight_t> dir_weight_list_;
+
         /**
          * @brief parse the json file
          * 
@@ -162,18 +243,102 @@ class SyncConfigure {
         int GetP6RecvPort() {
             return p6_recv_port_;
         }
+        int GetMuxRecvPort() {
+            return mux_recv_port_;
+        }
         string GetCloud2Path() {
             return file_root_path_2_;
         }
+        vector<SyncDest_t>& GetDestList() {
+            return dest_list_;
+        }
         uint64_t GetDataBatchSize() {
             return send_data_batch_size_;
         }
         uint64_t GetMetaBatchSize() {
             return send_meta_batch_size_;
         }
+        uint64_t GetMaxInflightFiles() {
+            return max_inflight_files_;
+        }
+        uint64_t GetRecipeReadSize() {
+            return recipe_read_size_;
+        }
+        bool IsRecipeDirectIO() {
+            return is_recipe_direct_io_;
+        }
+        uint64_t GetSentFPCacheItem() {
+            return sent_fp_cache_item_;
+        }
         uint64_t GetEnclaveCacheSize() {
             return enclave_cache_size_;
         }
+        uint64_t GetMaxDeltaDepth() {
+            return max_delta_depth_;
+        }
+        uint64_t GetMaxResendRound() {
+            return max_resend_round_;
+        }
+        bool IsMuxEnabled() {
+            return enable_mux_;
+        }
+        uint64_t GetSendBufSize() {
+            return send_buf_size_;
+        }
+        uint64_t GetFlowWindow() {
+            return flow_window_;
+        }
+        bool IsKTLSEnabled() {
+            return enable_ktls_;
+        }
+        uint64_t GetRateLimit() {
+            return rate_limit_mbps_;
+        }
+        uint64_t GetRateBurstSize() {
+            return rate_burst_size_;
+        }
+        uint64_t GetPhaseWeight(uint8_t phase_id) {
+            return phase_weight_[phase_id - 1];
+        }
+        vector<RateSchedule_t>& GetRateSchedule() {
+            return rate_schedule_;
+        }
+        uint64_t GetGroupCommitContainerNum() {
+            return group_commit_container_num_;
+        }
+        uint64_t GetGroupCommitInterval() {
+            return group_commit_interval_ms_;
+        }
+        string GetIndexDeltaLogName() {
+            return index_delta_log_name_;
+        }
+        string GetCommitManifestName() {
+            return commit_manifest_name_;
+        }
+        string GetSyncCheckpointName() {
+            return sync_checkpoint_name_;
+        }
+        uint64_t GetCheckpointBatchNum() {
+            return checkpoint_batch_num_;
+        }
+        string GetWatermarkName() {
+            return watermark_name_;
+        }
+        uint64_t GetDaemonSettleTime() {
+            return daemon_settle_ms_;
+        }
+        uint64_t GetDrainTimeout() {
+            return drain_timeout_sec_;
+        }
+        int GetSchedulePolicy() {
+            return schedule_policy_;
+        }
+        string GetPriorityListName() {
+            return priority_list_name_;
+        }
+        vector<SyncDirWeight_t>& GetDirWeightList() {
+            return dir_weight_list_;
+        }
 };
 
 #endif
\ No newline at end of file
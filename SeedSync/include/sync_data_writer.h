@@ -18,6 +18,7 @@
 #include "send_thd.h"
 #include "absDatabase.h"
 #include "../build/src/Enclave/storeEnclave_u.h"
+#include "../src/Enclave/include/syncOcall.h"
 
 class SyncDataWriter {
     private:
@@ -38,10 +39,28 @@ class SyncDataWriter {
         // for debug
         OutChunkQuery_t debug_index_;
 
+        // for integrity check (chunks expected to be written, per file id)
+        std::unordered_map<uint32_t, vector<string>> expected_fp_list_;
+        // the number of expected chunks before each checkpoint marker in flight
+        std::unordered_map<uint32_t, std::deque<size_t>> checkpoint_fp_num_;
+        std::mutex expected_fp_mutex_;
+        OutChunkQuery_t check_index_;
+
         // for container buf
         Container_t container_buf_;
+        // the graceful stop flushes the tail container from another thread
+        std::mutex writer_mutex_;
         // Container_t* container_buf_;
         // PtrContainer_t container_buf_;
+
+        /**
+         * @brief check the first chunks of the expected list (hold expected_fp_mutex_)
+         * 
+         * @param fp_list 
+         * @param fp_num 
+         * @param fail_fp_list the chunks failing the check
+         */
+        void CheckWritten(vector<string>& fp_list, size_t fp_num, vector<string>& fail_fp_list);
     
     public:
         uint64_t _total_write_data_size = 0;
@@ -76,6 +95,46 @@ class SyncDataWriter {
          * 
          */
         void ProcessTailBatch();
+
+        /**
+         * @brief add the chunks (from phase-4) expected to be written
+         * 
+         * @param file_id 
+         * @param entry_list 
+         * @param entry_num 
+         */
+        void AddExpectedChunk(uint32_t file_id, uint8_t* entry_list, uint32_t entry_num);
+
+        /**
+         * @brief check whether the expected chunks of a file have been written
+         * 
+         * @param file_id 
+         * @param fail_fp_list the chunks failing the check
+         */
+        void CheckIntegrity(uint32_t file_id, vector<string>& fail_fp_list);
+
+        /**
+         * @brief mark a checkpoint after the expected chunks added so far (phase-4)
+         * 
+         * @param file_id 
+         */
+        void MarkCheckpoint(uint32_t file_id);
+
+        /**
+         * @brief check the expected chunks before the next checkpoint of a file
+         * 
+         * @param file_id 
+         * @return true all of them (and the earlier ones) have been written
+         * @return false 
+         */
+        bool CheckCheckpoint(uint32_t file_id);
+
+        /**
+         * @brief clear the expected chunks of a file
+         * 
+         * @param file_id 
+         */
+        void ClearExpectedChunk(uint32_t file_id);
 };
 
 
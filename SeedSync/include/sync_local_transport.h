@@ -0,0 +1,111 @@
+/**
+ * @file sync_local_transport.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief carry the messages of all sync phases in memory, for running the source
+ * and the dest in one process
+ * @version 0.1
+ * @date 2024-09-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_LOCAL_TRANSPORT_H
+#define SYNC_LOCAL_TRANSPORT_H
+
+#include "sync_transport.h"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * one object is shared by both sides: the phase ids of the source (1/3/5) and
+ * the dest (2/4/6) never overlap, so the messages are queued per recv phase and
+ * the credits are granted to the sender directly. like the send queues of the
+ * mux, the queues are not bounded: the credits bound the batches in flight, and
+ * a sender never blocks on a recv thread (which may wait for the sender itself).
+ */
+class SyncLocalTransport : public SyncTransport {
+    private:
+        string my_name_ = "SyncLocalTransport";
+
+        // per-phase message queues (indexed by the recv phase id)
+        std::deque<string> recv_queue_[MUX_PHASE_NUM];
+        std::mutex queue_mutex_;
+        std::condition_variable recv_cond_;
+        bool is_closed_ = false;
+
+        // the credits of the senders (indexed by the send phase id)
+        FlowCredit* flow_credit_list_[MUX_PHASE_NUM] = {nullptr};
+
+    public:
+        /**
+         * @brief Construct a new Sync Local Transport object
+         *
+         */
+        SyncLocalTransport();
+
+        /**
+         * @brief Destroy the Sync Local Transport object
+         *
+         */
+        ~SyncLocalTransport();
+
+        /**
+         * @brief start to carry the messages
+         *
+         */
+        void Start();
+
+        /**
+         * @brief stop after the queued messages are received
+         *
+         */
+        void Stop();
+
+        /**
+         * @brief send a message to the given phase
+         *
+         * @param recv_phase_id
+         * @param data
+         * @param size
+         */
+        void SendFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t size);
+
+        /**
+         * @brief recv a message of the given phase
+         *
+         * @param recv_phase_id
+         * @param data
+         * @param size
+         * @return true success
+         * @return false the transport is stopped and no message left
+         */
+        bool RecvFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t& size);
+
+        /**
+         * @brief check whether the transport is stopped
+         *
+         * @return true
+         * @return false
+         */
+        bool IsClosed();
+
+        /**
+         * @brief return the credits to the given phase (sender)
+         *
+         * @param send_phase_id
+         * @param credit_num
+         */
+        void SendCredit(uint8_t send_phase_id, uint32_t credit_num);
+
+        /**
+         * @brief Set the Flow Credit object of a sender
+         *
+         * @param send_phase_id
+         * @param flow_credit
+         */
+        void SetFlowCredit(uint8_t send_phase_id, FlowCredit* flow_credit);
+};
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @file sync_mux.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief multiplex the messages of all sync phases over a single SSL connection
+ * @version 0.1
+ * @date 2024-08-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_MUX_H
+#define SYNC_MUX_H
+
+#include "sslConnection.h"
+#include "chunkStructure.h"
+#include "sync_transport.h"
+#include <poll.h>
+#include <fcntl.h>
+#include <mutex>
+#include <condition_variable>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+
+/**
+ * frame format on the wire: | payload size (4B) | recv phase id (1B) | payload |
+ * the payload is the original message (NetworkHead_t + data) of the phase.
+ * a credit frame (MUX_CREDIT_FLAG | send phase id) carries the num of credits 
+ * returned to the sender of that phase.
+ *
+ * all the SSL_read/SSL_write are issued by the single I/O thread on a non-blocking
+ * socket, such that the two directions never block each other.
+ */
+class SyncMux : public SyncTransport {
+    private:
+        string my_name_ = "SyncMux";
+
+        // network connection
+        SSLConnection* mux_channel_;
+        pair<int, SSL*> mux_conn_record_;
+        int conn_type_;
+        // read by the I/O thread without the lock
+        boost::atomic<bool> is_connected_{false};
+        // one session only (bidirectional sync), the server side does not wait for the next
+        bool is_one_session_ = false;
+
+        // the I/O thread
+        boost::thread* io_thd_ = nullptr;
+        // set by stop, read by the I/O thread
+        boost::atomic<bool> done_flag_{false};
+
+        // per-phase send queues (indexed by the recv phase id, 0 for the credit frames)
+        std::deque<string> send_queue_[MUX_PHASE_NUM];
+        std::mutex send_mutex_;
+        std::condition_variable flush_cond_;
+        uint64_t pending_frame_num_ = 0;
+        uint8_t last_send_phase_ = 0;
+
+        // the frame in writing
+        string out_frame_;
+        size_t out_offset_ = 0;
+        bool is_out_frame_ = false;
+
+        // per-phase recv queues (indexed by the recv phase id)
+        std::deque<string> recv_queue_[MUX_PHASE_NUM];
+        std::mutex recv_mutex_;
+        std::condition_variable recv_cond_;
+        bool is_closed_ = false;
+        // the phases with a local receiver
+        bool is_recv_phase_[MUX_PHASE_NUM] = {false};
+
+        // the frames held back from the full recv queues (only the I/O thread
+        // touches them), the other phases and the credits go on meanwhile.
+        // an empty frame marks the end of a session (server side)
+        std::deque<string> backlog_[MUX_PHASE_NUM];
+
+        // the credits of the local senders (indexed by the send phase id)
+        FlowCredit* flow_credit_list_[MUX_PHASE_NUM] = {nullptr};
+
+        // the received bytes not forming a whole frame yet
+        string in_buf_;
+        uint8_t* read_buf_;
+
+        /**
+         * @brief the main loop of the I/O thread
+         *
+         */
+        void Run();
+
+        /**
+         * @brief read the available frames from the connection
+         *
+         * @return true the connection is alive
+         * @return false the connection is closed
+         */
+        bool ReadFrames();
+
+        /**
+         * @brief write the pending frames to the connection
+         *
+         * @return true the connection is alive
+         * @return false the connection is closed
+         */
+        bool WriteFrames();
+
+        /**
+         * @brief pick the next frame to write (round-robin among phases)
+         *
+         * @return true get a frame
+         * @return false no pending frame
+         */
+        bool NextOutFrame();
+
+        /**
+         * @brief dispatch the whole frames in the in-buffer to the recv queues
+         *
+         */
+        void DispatchFrames();
+
+        /**
+         * @brief move the held-back frames to the recv queues with free space
+         *
+         */
+        void DeliverBacklog();
+
+        /**
+         * @brief set the connection as non-blocking after the handshake
+         *
+         */
+        void SetNonBlocking();
+
+        /**
+         * @brief clear the closed connection (and the frames of this session)
+         *
+         */
+        void CloseSession();
+
+    public:
+        /**
+         * @brief Construct a new Sync Mux object
+         *
+         * @param mux_channel
+         * @param conn_type IN_CLIENTSIDE (source) / IN_SERVERSIDE (dest)
+         */
+        SyncMux(SSLConnection* mux_channel, int conn_type);
+
+        /**
+         * @brief Destroy the Sync Mux object
+         *
+         */
+        ~SyncMux();
+
+        /**
+         * @brief start the I/O thread (the client side connects first)
+         *
+         */
+        void Start();
+
+        /**
+         * @brief carry one session only, with both clouds sending over it
+         * (call before start)
+         *
+         */
+        void SetOneSession();
+
+        /**
+         * @brief stop the I/O thread after flushing the pending frames
+         *
+         */
+        void Stop();
+
+        /**
+         * @brief send a message to the given phase of the other cloud
+         *
+         * @param recv_phase_id
+         * @param data
+         * @param size
+         */
+        void SendFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t size);
+
+        /**
+         * @brief recv a message of the given phase
+         *
+         * @param recv_phase_id
+         * @param data
+         * @param size
+         * @return true success
+         * @return false the connection is closed, or the session is reset
+         */
+        bool RecvFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t& size);
+
+        /**
+         * @brief check whether the mux is closed (otherwise a failed recv is
+         * a reset session)
+         *
+         * @return true
+         * @return false
+         */
+        bool IsClosed();
+
+        /**
+         * @brief return the credits to the given phase (sender) of the other cloud
+         *
+         * @param send_phase_id
+         * @param credit_num
+         */
+        void SendCredit(uint8_t send_phase_id, uint32_t credit_num);
+
+        /**
+         * @brief Set the Flow Credit object of a local sender
+         *
+         * @param send_phase_id
+         * @param flow_credit
+         */
+        void SetFlowCredit(uint8_t send_phase_id, FlowCredit* flow_credit);
+};
+
+#endif
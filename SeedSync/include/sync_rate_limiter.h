@@ -0,0 +1,82 @@
+/**
+ * @file sync_rate_limiter.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the sync-wide token bucket shared by the phase senders
+ * @version 0.1
+ * @date 2024-08-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_RATE_LIMITER_H
+#define SYNC_RATE_LIMITER_H
+
+#include "configure.h"
+#include "sync_configure.h"
+#include <mutex>
+#include <condition_variable>
+#include <set>
+
+extern SyncConfigure sync_config;
+
+/**
+ * the senders waiting for the tokens are served in the order of their virtual 
+ * finish time (msg size / phase weight), such that the phases share the rate 
+ * by their weights (e.g., the metadata phases before the bulk data of phase-5).
+ */
+class SyncRateLimiter {
+    private:
+        string my_name_ = "SyncRateLimiter";
+
+        // the token bucket (in bytes), negative when a large message is in debt
+        double token_num_;
+        double burst_size_;
+        struct timeval last_refill_time_;
+
+        // for the weighted sharing among phases
+        double phase_vtime_[MUX_PHASE_NUM] = {0};
+        double global_vtime_ = 0;
+        std::set<pair<double, uint64_t>> wait_list_; // <virtual finish time, ticket>
+        uint64_t next_ticket_ = 0;
+
+        std::mutex rate_mutex_;
+        std::condition_variable rate_cond_;
+
+        /**
+         * @brief get the rate limit of current time (by the schedule)
+         *
+         * @return uint64_t bytes per second (0: unlimited)
+         */
+        uint64_t GetCurRate();
+
+        /**
+         * @brief add the tokens since the last refill
+         *
+         * @param rate bytes per second
+         */
+        void Refill(uint64_t rate);
+
+    public:
+        /**
+         * @brief Construct a new Sync Rate Limiter object
+         *
+         */
+        SyncRateLimiter();
+
+        /**
+         * @brief Destroy the Sync Rate Limiter object
+         *
+         */
+        ~SyncRateLimiter();
+
+        /**
+         * @brief wait until the message of the phase can be sent under the rate limit
+         *
+         * @param phase_id
+         * @param size
+         */
+        void Acquire(uint8_t phase_id, uint32_t size);
+};
+
+#endif
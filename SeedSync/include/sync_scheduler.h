@@ -0,0 +1,111 @@
+/**
+ * @file sync_scheduler.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the scheduling policy of the files in a sync session
+ * @version 0.1
+ * @date 2024-09-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_SCHEDULER_H
+#define SYNC_SCHEDULER_H
+
+#include "configure.h"
+#include "sync_configure.h"
+#include "stream_phase_1_thd.h"
+#include <unordered_map>
+
+extern SyncConfigure sync_config;
+extern Configure config;
+
+/**
+ * the files are issued to phase-1 in the scheduled order, such that a session 
+ * cut short has covered the files that matter most:
+ * - mtime: as selected (the recipes by mtime, the given files as they are)
+ * - size: the smaller recipes first, the small files are not stuck behind a huge one
+ * - priority: the files in the priority list first (in its order), then the others
+ * - fair_share: round-robin among the dirs, a dir issues its weight of files per round
+ * 
+ * the priority list holds a file path or a recipe name per line, and is re-read 
+ * per session (e.g., updated while the daemon runs). a recipe is mapped to its dir 
+ * by hashing the files under the weighted dirs (the recipe names carry no path).
+ */
+class SyncScheduler {
+    private:
+        string my_name_ = "SyncScheduler";
+
+        int policy_;
+        string recipe_root_path_;
+        string recipe_suffix_;
+
+        // for the recipe names of the files
+        StreamPhase1Thd* stream_phase_1_obj_;
+
+        /**
+         * @brief get the recipe name of an entry in the list
+         *
+         * @param entry
+         * @param is_recipe_list
+         * @return string
+         */
+        string GetRecipeName(string& entry, bool is_recipe_list);
+
+        /**
+         * @brief check whether a file is under a dir (by whole path components)
+         *
+         * @param file_path
+         * @param dir
+         * @return size_t the length of the matched dir (0: not under it)
+         */
+        size_t MatchDir(string& file_path, string& dir);
+
+        /**
+         * @brief the smaller recipes first
+         *
+         * @param sync_file_list
+         * @param is_recipe_list
+         */
+        void OrderBySize(vector<string>& sync_file_list, bool is_recipe_list);
+
+        /**
+         * @brief the files in the priority list first
+         *
+         * @param sync_file_list
+         * @param is_recipe_list
+         */
+        void OrderByPriority(vector<string>& sync_file_list, bool is_recipe_list);
+
+        /**
+         * @brief weighted round-robin among the dirs
+         *
+         * @param sync_file_list
+         * @param is_recipe_list
+         */
+        void OrderByFairShare(vector<string>& sync_file_list, bool is_recipe_list);
+
+    public:
+        /**
+         * @brief Construct a new Sync Scheduler object
+         *
+         * @param stream_phase_1_obj
+         */
+        SyncScheduler(StreamPhase1Thd* stream_phase_1_obj);
+
+        /**
+         * @brief Destroy the Sync Scheduler object
+         *
+         */
+        ~SyncScheduler();
+
+        /**
+         * @brief order the files of a session by the policy
+         *
+         * @param sync_file_list
+         * @param is_recipe_list the list holds the recipe names
+         */
+        void Order(vector<string>& sync_file_list, bool is_recipe_list);
+};
+
+#endif
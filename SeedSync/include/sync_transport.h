@@ -0,0 +1,91 @@
+/**
+ * @file sync_transport.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the transport carrying the messages of all sync phases between the
+ * source and the dest
+ * @version 0.1
+ * @date 2024-09-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_TRANSPORT_H
+#define SYNC_TRANSPORT_H
+
+#include "configure.h"
+#include "flow_credit.h"
+
+/**
+ * the messages are addressed by phase id: a message sent by phase-i is received
+ * by phase-(i+1), and the credits of phase-(i+1) go back to phase-i.
+ * implementations: SyncMux (over one SSL connection), SyncLocalTransport (in
+ * memory, both sides in one process).
+ */
+class SyncTransport {
+    public:
+        /**
+         * @brief Destroy the Sync Transport object
+         *
+         */
+        virtual ~SyncTransport() {};
+
+        /**
+         * @brief start to carry the messages
+         *
+         */
+        virtual void Start() = 0;
+
+        /**
+         * @brief stop after the pending messages are delivered
+         *
+         */
+        virtual void Stop() = 0;
+
+        /**
+         * @brief send a message to the given phase of the other side
+         *
+         * @param recv_phase_id
+         * @param data
+         * @param size
+         */
+        virtual void SendFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t size) = 0;
+
+        /**
+         * @brief recv a message of the given phase
+         *
+         * @param recv_phase_id
+         * @param data
+         * @param size
+         * @return true success
+         * @return false the transport is closed, or the session is reset
+         */
+        virtual bool RecvFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t& size) = 0;
+
+        /**
+         * @brief check whether the transport is closed (otherwise a failed recv
+         * is a reset session)
+         *
+         * @return true
+         * @return false
+         */
+        virtual bool IsClosed() = 0;
+
+        /**
+         * @brief return the credits to the given phase (sender) of the other side
+         *
+         * @param send_phase_id
+         * @param credit_num
+         */
+        virtual void SendCredit(uint8_t send_phase_id, uint32_t credit_num) = 0;
+
+        /**
+         * @brief Set the Flow Credit object of a local sender
+         *
+         * @param send_phase_id
+         * @param flow_credit
+         */
+        virtual void SetFlowCredit(uint8_t send_phase_id, FlowCredit* flow_credit) = 0;
+};
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file sync_watermark.h
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief the per-dest watermark of the source, to sync the new or changed recipes only
+ * @version 0.1
+ * @date 2024-09-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SYNC_WATERMARK_H
+#define SYNC_WATERMARK_H
+
+#include "configure.h"
+#include "chunkStructure.h"
+#include <openssl/evp.h>
+#include <unordered_map>
+#include <fcntl.h>
+
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+/**
+ * the watermark file holds the last synced mtime, and the digest of each synced
+ * recipe. the recipes older than the watermark are skipped by their mtime only
+ * (without reading them), the others are read to compare the digest, such that
+ * a sync costs in proportion to the changed recipes. the watermark advances only
+ * after all the selected recipes are done in dest.
+ */
+class SyncWatermark {
+    private:
+        string my_name_ = "SyncWatermark";
+
+        string watermark_name_;
+
+        // the last synced mtime
+        std::time_t watermark_time_ = 0;
+        // the digest of the synced recipes (recipe name -> digest)
+        std::unordered_map<string, string> recipe_digest_list_;
+
+        // the selected recipes of the current session (applied in commit)
+        std::unordered_map<string, string> pending_digest_list_;
+        std::time_t pending_time_ = 0;
+
+        EVP_MD_CTX* md_ctx_;
+        uint8_t* read_buf_;
+
+        /**
+         * @brief load the watermark file
+         *
+         */
+        void Load();
+
+        /**
+         * @brief compute the digest of a recipe file
+         *
+         * @param recipe_path
+         * @param digest
+         */
+        void GetRecipeDigest(string recipe_path, string& digest);
+
+    public:
+        /**
+         * @brief Construct a new Sync Watermark object
+         *
+         * @param watermark_name the watermark path (of a dest)
+         */
+        SyncWatermark(string watermark_name);
+
+        /**
+         * @brief Destroy the Sync Watermark object
+         *
+         */
+        ~SyncWatermark();
+
+        /**
+         * @brief select the new or changed recipes since the watermark
+         *
+         * @param recipe_root_path
+         * @param recipe_list the selected recipe names (in the order of mtime)
+         */
+        void SelectRecipes(string recipe_root_path, vector<string>& recipe_list);
+
+        /**
+         * @brief select the new or changed recipes among the given ones (e.g., 
+         * the completed recipes), the watermark mtime is kept
+         *
+         * @param recipe_root_path
+         * @param recipe_name_list
+         * @param recipe_list the selected recipe names (in the order of mtime)
+         */
+        void SelectNamedRecipes(string recipe_root_path, vector<string>& recipe_name_list,
+            vector<string>& recipe_list);
+
+        /**
+         * @brief advance the watermark after the selected recipes are synced
+         *
+         */
+        void Commit();
+};
+
+#endif
@@ -46,6 +46,11 @@ SSLConnection::SSLConnection(string ip, int port, int type) {
             SSL_CTX_set_mode(sslCtx_, SSL_MODE_AUTO_RETRY); // handle for multiple time hand shakes
             keyFileStr.assign(SERVER_KEY);
             crtFileStr.assign(SERVER_CERT);
+            // issue session tickets, such that the reconnects resume the session
+            SSL_CTX_set_session_cache_mode(sslCtx_, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_session_id_context(sslCtx_, (const uint8_t*)SSL_SESSION_ID_CONTEXT,
+                strlen(SSL_SESSION_ID_CONTEXT));
+            SSL_CTX_set_timeout(sslCtx_, SSL_SESSION_TIMEOUT);
             socketAddr_.sin_addr.s_addr = htons(INADDR_ANY);
             if (setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0) {
                 // tool::Logging(myName_.c_str(), "cannot set the port reusable.\n");
@@ -66,6 +71,11 @@ SSLConnection::SSLConnection(string ip, int port, int type) {
             sslCtx_ = SSL_CTX_new(TLS_client_method());
             keyFileStr.assign(CLIENT_KEY);
             crtFileStr.assign(CLIENT_CERT);
+            // keep the latest session by ourselves for the next connect
+            SSL_CTX_set_session_cache_mode(sslCtx_, SSL_SESS_CACHE_CLIENT | 
+                SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_set_app_data(sslCtx_, this);
+            SSL_CTX_sess_set_new_cb(sslCtx_, NewSessionCallback);
             socketAddr_.sin_addr.s_addr = inet_addr(serverIP_.c_str());
             break;
         default:
@@ -117,6 +127,9 @@ SSLConnection::SSLConnection(string ip, int port, int type) {
  * 
  */
 SSLConnection::~SSLConnection() {
+    if (cachedSession_ != NULL) {
+        SSL_SESSION_free(cachedSession_);
+    }
     SSL_CTX_free(sslCtx_);
     close(listenFd_);
 }
@@ -164,6 +177,8 @@ void SSLConnection::Finish(pair<int, SSL*> sslPair) {
  */
 void SSLConnection::ClearAcceptedClientSd(SSL* SSLPtr) {
     int sd = SSL_get_fd(SSLPtr);
+    // a quiet shutdown, otherwise openssl marks the session as not resumable
+    SSL_set_shutdown(SSLPtr, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
     SSL_free(SSLPtr);
     close(sd);
     return ;
@@ -191,6 +206,14 @@ pair<int, SSL*> SSLConnection::ConnectSSL() {
         ERR_print_errors_fp(stderr);
         exit(EXIT_FAILURE);
     }
+
+    // try to resume the last session (abbreviated handshake)
+    {
+        std::lock_guard<std::mutex> lck(sessionMutex_);
+        if (cachedSession_ != NULL) {
+            SSL_set_session(sslConnectionPtr, cachedSession_);
+        }
+    }
     
     // start the SSL handshake 
     if (SSL_connect(sslConnectionPtr) != 1) {
@@ -199,6 +222,14 @@ pair<int, SSL*> SSLConnection::ConnectSSL() {
         exit(EXIT_FAILURE);
     } 
 
+    // the senders may never read, get the ticket for the next connect here 
+    // (a TLS 1.3 ticket is used only once)
+    this->WaitSessionTicket(socketFd, sslConnectionPtr);
+
+    if (isKTLS_) {
+        this->CheckKTLS(sslConnectionPtr);
+    }
+
     return make_pair(socketFd, sslConnectionPtr);
 }
 
@@ -232,6 +263,10 @@ pair<int, SSL*> SSLConnection::ListenSSL() {
         exit(EXIT_FAILURE);
     }
 
+    if (isKTLS_) {
+        this->CheckKTLS(sslConnectionPtr);
+    }
+
     return make_pair(socketFd, sslConnectionPtr);
 }
 
@@ -245,26 +280,95 @@ pair<int, SSL*> SSLConnection::ListenSSL() {
  * @return false fail
  */
 bool SSLConnection::SendData(SSL* connection, uint8_t* data, uint32_t dataSize) {
-    int writeStatus;
-    // cout<<"before ssl_write "<<dataSize<<endl;
-    writeStatus = SSL_write(connection, (char*)&dataSize, sizeof(uint32_t));
-    if (writeStatus <= 0) {
-        // // tool::Logging(myName_.c_str(), "write the data fails. ret: %d\n", SSL_get_error(connection, writeStatus));
-        // ERR_print_errors_fp(stderr);
-        // tool::Logging(myName_.c_str(), "write the data fails. ret: %d\n", writeStatus);
-        // ERR_print_errors_fp(stderr);
-        return false;
+    // the length and the data go out in the same TLS record
+    struct iovec iov[2];
+    iov[0].iov_base = &dataSize;
+    iov[0].iov_len = sizeof(uint32_t);
+    iov[1].iov_base = data;
+    iov[1].iov_len = dataSize;
+
+    return this->WriteDataV(connection, iov, 2);
+}
+
+/**
+ * @brief write the gathered buffers to the given connection as raw bytes,
+ * coalescing the small buffers into full TLS records
+ * 
+ * @param connection the pointer to the connection
+ * @param iov the list of buffers
+ * @param iovNum the number of buffers
+ * @return true success
+ * @return false fail
+ */
+bool SSLConnection::WriteDataV(SSL* connection, const struct iovec* iov, int iovNum) {
+    // the pending TLS record (one per sending thread)
+    static thread_local uint8_t recordBuf[SSL3_RT_MAX_PLAIN_LENGTH];
+    size_t recordSize = 0;
+
+    for (int i = 0; i < iovNum; i++) {
+        const uint8_t* segment = (const uint8_t*)iov[i].iov_base;
+        size_t segmentSize = iov[i].iov_len;
+        if (segmentSize == 0) {
+            continue;
+        }
+
+        if (recordSize != 0 || segmentSize < SSL3_RT_MAX_PLAIN_LENGTH) {
+            // fill the pending record with the head of this buffer
+            size_t copySize = min(segmentSize, SSL3_RT_MAX_PLAIN_LENGTH - recordSize);
+            memcpy(recordBuf + recordSize, segment, copySize);
+            recordSize += copySize;
+            segment += copySize;
+            segmentSize -= copySize;
+
+            if (recordSize < SSL3_RT_MAX_PLAIN_LENGTH) {
+                continue;
+            }
+            if (!this->WriteAll(connection, recordBuf, recordSize)) {
+                return false;
+            }
+            recordSize = 0;
+        }
+
+        // the rest of a large buffer is written without copy
+        if (segmentSize >= SSL3_RT_MAX_PLAIN_LENGTH) {
+            if (!this->WriteAll(connection, segment, segmentSize)) {
+                return false;
+            }
+        }
+        else if (segmentSize != 0) {
+            memcpy(recordBuf, segment, segmentSize);
+            recordSize = segmentSize;
+        }
     }
 
-    // cout<<"after sslwrite"<<endl;
+    if (recordSize != 0) {
+        return this->WriteAll(connection, recordBuf, recordSize);
+    }
 
-    int sendedSize = 0;
+    return true;
+}
+
+/**
+ * @brief write the whole buffer to the given connection
+ * 
+ * @param connection the pointer to the connection
+ * @param data the pointer to the data buffer
+ * @param dataSize the size of the data
+ * @return true success
+ * @return false fail
+ */
+bool SSLConnection::WriteAll(SSL* connection, const uint8_t* data, size_t dataSize) {
+    size_t sendedSize = 0;
     while (sendedSize < dataSize) {
-        sendedSize += SSL_write(connection, data + sendedSize, dataSize - sendedSize);
+        int writeStatus = SSL_write(connection, data + sendedSize, dataSize - sendedSize);
+        if (writeStatus <= 0) {
+            // tool::Logging(myName_.c_str(), "write the data fails. ret: %d\n", SSL_get_error(connection, writeStatus));
+            return false;
+        }
+        sendedSize += writeStatus;
     }
 
     return true;
-
 }
 
 /**
@@ -299,6 +403,91 @@ bool SSLConnection::ReceiveData(SSL* connection, uint8_t* data, uint32_t& receiv
 }
 
 
+/**
+ * @brief keep the new session (ticket) issued by the server
+ * 
+ * @param connection the pointer to the connection
+ * @param session the new session
+ * @return int 1: the session is kept
+ */
+int SSLConnection::NewSessionCallback(SSL* connection, SSL_SESSION* session) {
+    SSLConnection* sslConnObj = (SSLConnection*)SSL_CTX_get_app_data(
+        SSL_get_SSL_CTX(connection));
+    
+    std::lock_guard<std::mutex> lck(sslConnObj->sessionMutex_);
+    if (sslConnObj->cachedSession_ != NULL) {
+        SSL_SESSION_free(sslConnObj->cachedSession_);
+    }
+    sslConnObj->cachedSession_ = session;
+
+    return 1;
+}
+
+/**
+ * @brief process the session tickets sent after the handshake
+ * 
+ * @param socketFd the socket of the connection
+ * @param connection the pointer to the connection
+ */
+void SSLConnection::WaitSessionTicket(int socketFd, SSL* connection) {
+    if (SSL_version(connection) < TLS1_3_VERSION) {
+        // the session of TLS 1.2 is ready after the handshake
+        return ;
+    }
+
+    struct pollfd pollFd;
+    pollFd.fd = socketFd;
+    pollFd.events = POLLIN;
+    pollFd.revents = 0;
+    if (poll(&pollFd, 1, SSL_TICKET_WAIT_MS) <= 0) {
+        return ;
+    }
+
+    // peek without blocking: only the tickets are consumed, not the data
+    int flags = fcntl(socketFd, F_GETFL, 0);
+    fcntl(socketFd, F_SETFL, flags | O_NONBLOCK);
+    uint8_t tmp;
+    SSL_peek(connection, &tmp, sizeof(tmp));
+    ERR_clear_error();
+    fcntl(socketFd, F_SETFL, flags);
+
+    return ;
+}
+
+/**
+ * @brief offload the record crypto of the following connections to the
+ * kernel (kTLS), fall back to the user-space crypto if not supported
+ * 
+ */
+void SSLConnection::EnableKTLS() {
+#ifdef SSL_OP_ENABLE_KTLS
+    // openssl uses kTLS only if the kernel (tls module) supports the negotiated cipher
+    SSL_CTX_set_options(sslCtx_, SSL_OP_ENABLE_KTLS);
+    isKTLS_ = true;
+#else
+    tool::Logging(myName_.c_str(), "kTLS is not supported by this openssl, use the user-space crypto.\n");
+#endif
+    return ;
+}
+
+/**
+ * @brief check whether the kernel takes over the record crypto of the connection
+ * 
+ * @param connection the pointer to the connection
+ */
+void SSLConnection::CheckKTLS(SSL* connection) {
+#ifdef SSL_OP_ENABLE_KTLS
+    // the BIO kTLS queries come with the kTLS support (openssl 3.0)
+    bool isSendKTLS = BIO_get_ktls_send(SSL_get_wbio(connection));
+    bool isRecvKTLS = BIO_get_ktls_recv(SSL_get_rbio(connection));
+    if (!isSendKTLS || !isRecvKTLS) {
+        tool::Logging(myName_.c_str(), "kTLS is unavailable for port %d (send: %d, recv: %d), "
+            "fall back to the user-space crypto.\n", port_, isSendKTLS, isRecvKTLS);
+    }
+#endif
+    return ;
+}
+
 /**
  * @brief Get the Client Ip object
  * 
@@ -192,4 +192,34 @@ bool InMemoryDatabase::QueryBuffer(const char* key, size_t keySize, std::string&
         return true;
     }
     return false;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief insert the (key, value) pair only if the key is absent
+ * 
+ * @param key 
+ * @param keySize 
+ * @param buffer 
+ * @param bufferSize 
+ * @return true inserted
+ * @return false the key already exists
+ */
+bool InMemoryDatabase::InsertOnlyBuffer(const char* key, size_t keySize, const char* buffer,
+    size_t bufferSize) {
+    return indexObj_.emplace(piecewise_construct, forward_as_tuple(key, keySize),
+        forward_as_tuple(buffer, bufferSize)).second;
+}
+
+/**
+ * @brief reserve the space for a batch of incoming items
+ * 
+ * @param itemNum the number of incoming items
+ */
+void InMemoryDatabase::Reserve(size_t itemNum) {
+    size_t targetNum = indexObj_.size() + itemNum;
+    if (targetNum > indexObj_.bucket_count() * indexObj_.max_load_factor()) {
+        // grow geometrically to avoid a rehash per batch
+        indexObj_.reserve(max(targetNum, indexObj_.size() * 2));
+    }
+    return;
+}
@@ -48,6 +48,8 @@ void Ecall_Sync_Enclave_Init(SyncEnclaveConfig_t* enclave_config)
     SyncEnclave::send_meta_batch_size_ = enclave_config->sendMetaBatchSize;
     SyncEnclave::send_recipe_batch_size_ = enclave_config->sendRecipeBatchSize;
     SyncEnclave::enclave_cache_item_num_ = enclave_config->enclaveCacheItemNum;
+    SyncEnclave::max_delta_depth_ = enclave_config->maxDeltaDepth;
+    SyncEnclave::sent_fp_cache_item_num_ = enclave_config->sentFPCacheItemNum;
     // SyncEnclave::max_seg_index_entry_size_ =
 
 #if RECIPE_HMAC == 1 && RECIPE_HMAC_PERSIST == 1
@@ -132,13 +134,14 @@ void Ecall_Destroy_Sync()
  * @param recipe_buf
  * @param recipe_num
  * @param chunk_hash_buf
+ * @param fp_num the num of chunk fps in chunk_hash_buf
  */
 void Ecall_Stream_Phase1_ProcessBatch(uint8_t* filename_buf, uint32_t currentBatchID,
-    uint8_t* recipe_buf, size_t recipe_num, uint8_t* chunk_hash_buf)
+    uint8_t* recipe_buf, size_t recipe_num, uint8_t* chunk_hash_buf, size_t* fp_num)
 {
 
     ecall_streamchunkhash_obj_->ProcessBatch(filename_buf, currentBatchID, recipe_buf,
-        recipe_num, chunk_hash_buf);
+        recipe_num, chunk_hash_buf, fp_num);
 
     return;
 }
@@ -285,6 +288,19 @@ void Ecall_Stream_Phase6_ProcessBatch_Debug(uint8_t* recv_buf, uint32_t recv_siz
     return;
 }
 
+/**
+ * @brief check whether the recovered chunks exist in the chunk index
+ *
+ * @param check_query
+ */
+void Ecall_Stream_Phase6_CheckIntegrity(OutChunkQuery_t* check_query)
+{
+
+    ecall_streamwriter_obj_->CheckIntegrity(check_query);
+
+    return;
+}
+
 /**
  * @brief get the sync info from enclave
  *
@@ -297,6 +313,7 @@ void Ecall_GetSyncEnclaveInfo(SyncEnclaveInfo_t* sync_info, uint8_t type)
         // for source cloud logs
         sync_info->total_chunk_num = ecall_streamchunkhash_obj_->_total_chunk_fp_num;
         sync_info->total_chunk_size = ecall_streamchunkhash_obj_->_total_chunk_size;
+        sync_info->total_suppressed_num = ecall_streamchunkhash_obj_->_total_suppressed_num;
 
         sync_info->total_unique_num = ecall_streamfeature_obj_->_total_unique_num;
         sync_info->total_unique_size = ecall_streamfeature_obj_->_total_unique_size;
@@ -25,6 +25,12 @@ EcallStreamChunkHash::EcallStreamChunkHash() {
     plain_recipe_buf_ = (uint8_t*)malloc(SyncEnclave::send_recipe_batch_size_ * sizeof(RecipeEntry_t));
     plain_fp_list_ = (uint8_t*)malloc(SyncEnclave::send_meta_batch_size_ * CHUNK_HASH_SIZE);
 
+    if (SyncEnclave::sent_fp_cache_item_num_ != 0) {
+        // one allocation of fixed-size keys (EPC)
+        sent_fp_slot_num_ = SyncEnclave::sent_fp_cache_item_num_;
+        sent_fp_table_ = (uint8_t*)calloc(sent_fp_slot_num_, CHUNK_HASH_SIZE);
+    }
+
 #if (DEBUG_FLAG == 1)
     SyncEnclave::Logging(my_name_.c_str(), "recipeBatchSize = %d.\n", SyncEnclave::send_recipe_batch_size_);
     SyncEnclave::Logging(my_name_.c_str(), "init the StreamChunkHash.\n");
@@ -42,6 +48,9 @@ EcallStreamChunkHash::~EcallStreamChunkHash() {
 
     free(plain_recipe_buf_);
     free(plain_fp_list_);
+    if (sent_fp_table_ != nullptr) {
+        free(sent_fp_table_);
+    }
 }
 
 /**
@@ -51,9 +60,10 @@ EcallStreamChunkHash::~EcallStreamChunkHash() {
  * @param recipe_buf
  * @param recipe_num
  * @param chunk_hash_buf
+ * @param fp_num the num of chunk fps in chunk_hash_buf
  */
 void EcallStreamChunkHash::ProcessBatch(uint8_t* filename_buf, uint32_t currentBatchID, uint8_t* recipe_buf,
-    size_t recipe_num, uint8_t* chunk_hash_buf) {
+    size_t recipe_num, uint8_t* chunk_hash_buf, size_t* fp_num) {
     string recipe_path((char*)filename_buf);
     std::string recipePath = recipe_path;
     size_t lastSlashPos = recipePath.find_last_of('/');
@@ -111,8 +121,24 @@ void EcallStreamChunkHash::ProcessBatch(uint8_t* filename_buf, uint32_t currentB
 
     // get chunk hash for a batch
     for (size_t i = 0; i < recipe_num; i++) {
-        // copy the chunk fp back to output buf
         RecipeEntry_t* tmp_recipe_entry = (RecipeEntry_t*)(plain_recipe_buf_ + sizeof(RecipeEntry_t) * i);
+        _total_chunk_fp_num++;
+        _total_chunk_size += tmp_recipe_entry->length;
+
+        if (sent_fp_table_ != nullptr) {
+            // the fps are keyed hashes, their prefix picks the slot
+            uint64_t slot_id;
+            memcpy(&slot_id, tmp_recipe_entry->chunkHash, sizeof(uint64_t));
+            uint8_t* slot = sent_fp_table_ + (slot_id % sent_fp_slot_num_) * CHUNK_HASH_SIZE;
+            if (memcmp(slot, tmp_recipe_entry->chunkHash, CHUNK_HASH_SIZE) == 0) {
+                // dest has got (or is getting) this chunk from an earlier batch
+                _total_suppressed_num++;
+                continue;
+            }
+            memcpy(slot, tmp_recipe_entry->chunkHash, CHUNK_HASH_SIZE);
+        }
+
+        // copy the chunk fp back to output buf
         memcpy(plain_fp_list_ + offset, tmp_recipe_entry->chunkHash,
             CHUNK_HASH_SIZE);
         offset += CHUNK_HASH_SIZE;
@@ -124,15 +150,14 @@ void EcallStreamChunkHash::ProcessBatch(uint8_t* filename_buf, uint32_t currentB
         memcpy(check_chunk_hash, tmp_recipe_entry->chunkHash, CHUNK_HASH_SIZE);
         Ocall_PrintfBinary(check_chunk_hash, CHUNK_HASH_SIZE);
 #endif       
-
-
-        _total_chunk_fp_num++;
-        _total_chunk_size += tmp_recipe_entry->length;
     }
 
     // encrypt the chunk fp batch with sessionkey
-    crypto_util_->EncryptWithKey(cipher_ctx_, plain_fp_list_,
-        recipe_num * CHUNK_HASH_SIZE, session_key_, chunk_hash_buf);
+    *fp_num = offset / CHUNK_HASH_SIZE;
+    if (offset != 0) {
+        crypto_util_->EncryptWithKey(cipher_ctx_, plain_fp_list_,
+            offset, session_key_, chunk_hash_buf);
+    }
 
     return;
 }
\ No newline at end of file
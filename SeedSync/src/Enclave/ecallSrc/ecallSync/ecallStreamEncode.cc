@@ -24,6 +24,8 @@ EcallStreamEncode::EcallStreamEncode() {
 
     plain_in_buf_ = (uint8_t*)malloc(SyncEnclave::send_chunk_batch_size_ * (MAX_CHUNK_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + CHUNK_HASH_SIZE));
     out_offset_ = 0;
+    batch_depth_map_.reserve(SyncEnclave::send_chunk_batch_size_);
+    _total_depth_capped_num = 0;
 #if (DEBUG_FLAG == 1) 
     SyncEnclave::Logging(my_name_.c_str(), "init EcallStreamEncode.\n");
 #endif    
@@ -57,6 +59,7 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
     
     // reset
     out_offset_ = 0;
+    batch_depth_map_.clear();
 
     // SyncEnclave::Logging("stream encode recv batch ", "%d\n", in_size/sizeof(StreamPhase4MQ_t));
 
@@ -188,6 +191,7 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
         tmp_local_addr_entry.offset = dec_query_entry.offset;
         tmp_local_addr_entry.length = dec_query_entry.length;
         tmp_local_addr_entry.sim_tag = tmp_query_entry->dedupFlag;
+        memcpy(tmp_local_addr_entry.queryHash, tmp_query_entry->chunkHash, CHUNK_HASH_SIZE);
         if (tmp_query_entry->dedupFlag == BASE_CHUNK) {
 
             // if (tmp_query_entry->existFlag == 101) {
@@ -266,7 +270,8 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
                     // TODO: compute HMAC to verify non-similar chunk
                     uint8_t currentNonSimilarChunkHMAC[CHUNK_HASH_SIZE];
                     // crypto_util_->GenerateHMAC(local_chunk_data, local_size, currentNonSimilarChunkHMAC);
-                    this->ProcessNonSimChunk(local_chunk_data, local_size);
+                    this->ProcessNonSimChunk(local_chunk_data, local_size,
+                        local_addr_list_[k].queryHash);
                 }
                 if (local_addr_list_[k].sim_tag == SIMILAR_CHUNK || 
                     local_addr_list_[k].sim_tag == BATCH_SIMILAR_CHUNK) {
@@ -293,7 +298,8 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
                     uint8_t currentBaseChunkHMAC[CHUNK_HASH_SIZE];
                     // crypto_util_->GenerateHMAC(base_chunk_data, base_size, currentBaseChunkHMAC);
                     this->PocessSimChunk(base_chunk_data, base_size, 
-                        local_addr_list_[k + 1].baseHash, sim_chunk_data, sim_size);
+                        local_addr_list_[k + 1].baseHash, sim_chunk_data, sim_size,
+                        local_addr_list_[k + 1].queryHash, local_addr_list_[k].queryHash);
                 }
             }
 
@@ -329,7 +335,8 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
                         uint8_t* local_chunk_data = container_array[local_id] + local_offset
                             + meta_offset + sizeof(uint32_t);
 
-                        this->ProcessNonSimChunk(local_chunk_data, local_size);
+                        this->ProcessNonSimChunk(local_chunk_data, local_size,
+                            local_addr_list_[k].queryHash);
                     }
                     if (local_addr_list_[k].sim_tag == SIMILAR_CHUNK || 
                         local_addr_list_[k].sim_tag == BATCH_SIMILAR_CHUNK) {
@@ -352,7 +359,8 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
                             + meta_offset + sizeof(uint32_t);
 
                         this->PocessSimChunk(base_chunk_data, base_size, 
-                            local_addr_list_[k + 1].baseHash, sim_chunk_data, sim_size);
+                            local_addr_list_[k + 1].baseHash, sim_chunk_data, sim_size,
+                            local_addr_list_[k + 1].queryHash, local_addr_list_[k].queryHash);
                     }
                 }
 
@@ -397,7 +405,8 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
                 // // SyncEnclave::Logging("check compress:", "metaoffset=%d, offset=%d, len=%d\n", meta_offset, local_offset, local_size);
 #endif
 
-                this->ProcessNonSimChunk(local_chunk_data, local_size);
+                this->ProcessNonSimChunk(local_chunk_data, local_size,
+                    local_addr_list_[k].queryHash);
             }
             if (local_addr_list_[k].sim_tag == SIMILAR_CHUNK ||
                 local_addr_list_[k].sim_tag == BATCH_SIMILAR_CHUNK) {
@@ -432,7 +441,8 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
                     + meta_offset + sizeof(uint32_t);
 
                 this->PocessSimChunk(base_chunk_data, base_size, 
-                    local_addr_list_[k + 1].baseHash, sim_chunk_data, sim_size);
+                    local_addr_list_[k + 1].baseHash, sim_chunk_data, sim_size,
+                    local_addr_list_[k + 1].queryHash, local_addr_list_[k].queryHash);
             }
         }
 
@@ -457,12 +467,27 @@ void EcallStreamEncode::ProcessBatch(uint8_t* in_buf, uint32_t in_size,
  * @param base_size 
  * @param input_chunk 
  * @param input_size 
+ * @param base_key 
+ * @param sim_key 
  */
 void EcallStreamEncode::PocessSimChunk(uint8_t* base_chunk_data, uint32_t base_size,
-    uint8_t* base_hash, uint8_t* sim_chunk_data, uint32_t sim_size) {
+    uint8_t* base_hash, uint8_t* sim_chunk_data, uint32_t sim_size,
+    uint8_t* base_key, uint8_t* sim_key) {
     
     _total_similar_num ++;
 
+    // bound the delta chain within current batch
+    DeltaDepth_t cur_depth;
+    if (!this->CheckDeltaDepth(base_key, cur_depth)) {
+        // send it as a non-similar chunk
+        _total_depth_capped_num ++;
+        this->ProcessNonSimChunk(sim_chunk_data, sim_size, sim_key);
+        return ;
+    }
+
+    string tmp_key;
+    tmp_key.assign((char*)sim_key, CHUNK_HASH_SIZE);
+
     uint8_t delta_chunk[MAX_CHUNK_SIZE];
     uint32_t delta_size = 0;
     uint8_t chunk_type;
@@ -472,6 +497,11 @@ void EcallStreamEncode::PocessSimChunk(uint8_t* base_chunk_data, uint32_t base_s
 #if (DEBUG_FLAG == 1)              
         // SyncEnclave::Logging("delta encode fails", "\n");
 #endif
+        // sent as a materialized chunk
+        cur_depth.depth = 0;
+        cur_depth.is_local = true;
+        batch_depth_map_[tmp_key] = cur_depth;
+
         // prepare the [chunkSize; chunkType]
         memcpy(plain_in_buf_ + out_offset_, &sim_size, sizeof(uint32_t));
         out_offset_ += sizeof(uint32_t);
@@ -511,18 +541,60 @@ void EcallStreamEncode::PocessSimChunk(uint8_t* base_chunk_data, uint32_t base_s
 #endif
         memcpy(plain_in_buf_ + out_offset_, delta_chunk, delta_size);
         out_offset_ += delta_size;
+
+        batch_depth_map_[tmp_key] = cur_depth;
     }
 
     return ;
 }
 
+/**
+ * @brief get the delta depth of a similar chunk if it is encoded with the base
+ * 
+ * @param base_key 
+ * @param depth 
+ * @return true if the chain does not exceed the max delta depth
+ * @return false 
+ */
+bool EcallStreamEncode::CheckDeltaDepth(uint8_t* base_key, DeltaDepth_t& depth) {
+    string tmp_key;
+    tmp_key.assign((char*)base_key, CHUNK_HASH_SIZE);
+
+    auto base_find = batch_depth_map_.find(tmp_key);
+    if (base_find == batch_depth_map_.end()) {
+        // the base is stored in dest, dest decodes it after the batch loop
+        depth.depth = 1;
+        depth.is_local = false;
+        return depth.depth <= SyncEnclave::max_delta_depth_;
+    }
+
+    if (!base_find->second.is_local) {
+        // the base is a pending delta in dest, cannot be a base in this batch
+        return false;
+    }
+
+    depth.depth = base_find->second.depth + 1;
+    depth.is_local = true;
+    return depth.depth <= SyncEnclave::max_delta_depth_;
+}
+
 /**
  * @brief process a non-similar chunk
  * 
  * @param input_chunk 
  * @param input_size 
+ * @param chunk_key 
  */
-void EcallStreamEncode::ProcessNonSimChunk(uint8_t* input_chunk, uint32_t input_size) {
+void EcallStreamEncode::ProcessNonSimChunk(uint8_t* input_chunk, uint32_t input_size,
+    uint8_t* chunk_key) {
+    // a materialized chunk in current batch
+    string tmp_key;
+    tmp_key.assign((char*)chunk_key, CHUNK_HASH_SIZE);
+    DeltaDepth_t cur_depth;
+    cur_depth.depth = 0;
+    cur_depth.is_local = true;
+    batch_depth_map_[tmp_key] = cur_depth;
+
     // prepare the [chunkSize; chunkType]
     memcpy(plain_in_buf_ + out_offset_, &input_size, sizeof(uint32_t));
     out_offset_ += sizeof(uint32_t);
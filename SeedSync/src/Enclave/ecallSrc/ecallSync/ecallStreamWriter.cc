@@ -31,7 +31,21 @@ EcallStreamWriter::EcallStreamWriter() {
 
     plain_in_buf_ = (uint8_t*)malloc(SyncEnclave::send_chunk_batch_size_ * (MAX_CHUNK_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + CHUNK_HASH_SIZE));
 
+#if EXTRA_HASH_FUNCTION == 1
+    // for batched extra hash
+    hash_batch_buf_ = (uint8_t*)malloc(SyncEnclave::send_chunk_batch_size_ * MAX_CHUNK_SIZE);
+    hash_batch_ptr_list_ = (uint8_t**)malloc(SyncEnclave::send_chunk_batch_size_ * sizeof(uint8_t*));
+    hash_batch_size_list_ = (int*)malloc(SyncEnclave::send_chunk_batch_size_ * sizeof(int));
+    hash_batch_out_ = (uint8_t*)malloc(SyncEnclave::send_chunk_batch_size_ * CHUNK_HASH_SIZE);
+    for (size_t i = 0; i < SyncEnclave::send_chunk_batch_size_; i++) {
+        hash_batch_ptr_list_[i] = hash_batch_buf_ + i * MAX_CHUNK_SIZE;
+    }
+    hash_batch_num_ = 0;
+#endif
+
     batch_fp_index_.reserve(SyncEnclave::send_chunk_batch_size_);
+    batch_base_buf_ = (uint8_t*)malloc(SyncEnclave::send_chunk_batch_size_ * MAX_CHUNK_SIZE);
+    batch_base_offset_ = 0;
 
 #if (DEBUG_FLAG == 1)    
     SyncEnclave::Logging(my_name_.c_str(), "init the StreamWriter.\n");
@@ -53,6 +67,87 @@ EcallStreamWriter::~EcallStreamWriter() {
     delete finesse_util_;
 
     free(plain_in_buf_);
+    free(batch_base_buf_);
+
+#if EXTRA_HASH_FUNCTION == 1
+    free(hash_batch_buf_);
+    free(hash_batch_ptr_list_);
+    free(hash_batch_size_list_);
+    free(hash_batch_out_);
+#endif
+}
+
+/**
+ * @brief get the base chunk data in current batch
+ * 
+ * @param base_addr 
+ * @return uint8_t* 
+ */
+uint8_t* EcallStreamWriter::GetLocalBase(BatchAddrValue_t& base_addr) {
+    if (base_addr.type == COMP_ONLY_CHUNK) {
+        return plain_in_buf_ + base_addr.offset;
+    }
+    // a recovered delta chunk
+    return batch_base_buf_ + base_addr.offset;
+}
+
+/**
+ * @brief keep a recovered delta chunk as a base in current batch
+ * 
+ * @param chunk_hash 
+ * @param chunk_data 
+ * @param chunk_size 
+ * @param chunk_type 
+ * @param depth 
+ */
+void EcallStreamWriter::AddLocalBase(uint8_t* chunk_hash, uint8_t* chunk_data,
+    uint32_t chunk_size, uint8_t chunk_type, uint8_t depth) {
+    if (depth >= SyncEnclave::max_delta_depth_) {
+        // cannot be a base of another delta chunk
+        return ;
+    }
+
+    BatchAddrValue_t tmp_batch_addr_value;
+    tmp_batch_addr_value.offset = batch_base_offset_;
+    tmp_batch_addr_value.size = chunk_size;
+    tmp_batch_addr_value.type = chunk_type;
+    tmp_batch_addr_value.depth = depth;
+    memcpy(batch_base_buf_ + batch_base_offset_, chunk_data, chunk_size);
+    batch_base_offset_ += chunk_size;
+
+    string tmp_key;
+    tmp_key.assign((char*)chunk_hash, CHUNK_HASH_SIZE);
+    batch_fp_index_.insert(make_pair(tmp_key, tmp_batch_addr_value));
+    return ;
+}
+
+/**
+ * @brief add a recovered chunk to the hash batch
+ * 
+ * @param chunk_data 
+ * @param chunk_size 
+ */
+void EcallStreamWriter::AddToHashBatch(uint8_t* chunk_data, uint32_t chunk_size) {
+    if (hash_batch_num_ == SyncEnclave::send_chunk_batch_size_) {
+        this->FlushHashBatch();
+    }
+    memcpy(hash_batch_ptr_list_[hash_batch_num_], chunk_data, chunk_size);
+    hash_batch_size_list_[hash_batch_num_] = chunk_size;
+    hash_batch_num_++;
+    return ;
+}
+
+/**
+ * @brief hash all chunks in the hash batch
+ * 
+ */
+void EcallStreamWriter::FlushHashBatch() {
+    if (hash_batch_num_ != 0) {
+        crypto_util_->GenerateHashBatch(hash_batch_ptr_list_, hash_batch_size_list_,
+            hash_batch_num_, hash_batch_out_);
+        hash_batch_num_ = 0;
+    }
+    return ;
 }
 
 /**
@@ -93,6 +188,7 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
 
     // prepare the batch fp index
     batch_fp_index_.clear();
+    batch_base_offset_ = 0;
     BatchAddrValue_t tmp_batch_addr_value;
 
     // process recv batch
@@ -114,6 +210,7 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
         tmp_batch_addr_value.type = cur_type;
         tmp_batch_addr_value.size = cur_size;
         tmp_batch_addr_value.offset = process_size;
+        tmp_batch_addr_value.depth = 0;
 
         uint8_t* cur_iv = this->PickNewIV();
 
@@ -158,9 +255,8 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
             // generate chunkhash
             crypto_util_->GenerateHMAC(tmp_original_chunk, tmp_original_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-            // use the extra hash function
-            uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-            crypto_util_->GenerateHash(tmp_original_chunk, tmp_original_size, tmp_hash_val);
+            // use the extra hash function (hashed per batch)
+            this->AddToHashBatch(tmp_original_chunk, tmp_original_size);
 #endif
             // insert the chunk to batch index
             string tmp_key;
@@ -238,15 +334,12 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
 #endif
 
                 // get the base chunk in current batch
-                if (local_find->second.type != COMP_ONLY_CHUNK) {
-#if (DEBUG_FLAG == 1)                      
-                    SyncEnclave::Logging("error ", "multi-level delta\n");
-#endif                    
-                    continue;
-                }
+                // a chunk beyond the max depth is still decoded and written, it 
+                // is only not kept as a base (checked in AddLocalBase)
+                uint8_t cur_depth = local_find->second.depth + 1;
                 
                 // delta decode
-                tmp_original_size = DeltaDecode(plain_in_buf_ + local_find->second.offset,
+                tmp_original_size = DeltaDecode(this->GetLocalBase(local_find->second),
                     local_find->second.size, delta_data, cur_size, tmp_original_chunk);
                 
 #if (DEBUG_FLAG == 1)
@@ -255,9 +348,8 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                 // generate chunkhash
                 crypto_util_->GenerateHMAC(tmp_original_chunk, tmp_original_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-                // use the extra hash function
-                uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-                crypto_util_->GenerateHash(tmp_original_chunk, tmp_original_size, tmp_hash_val);
+                // use the extra hash function (hashed per batch)
+                this->AddToHashBatch(tmp_original_chunk, tmp_original_size);
 #endif
                 // extract features
                 this->ExtractFeature(rabin_ctx_, tmp_original_chunk, tmp_original_size, cur_feature);
@@ -309,6 +401,16 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                     _comp_similar_size += tmp_original_size;
                 }
 
+                // keep it as a base for the following delta chunks in the batch
+                if (tmp_compress_size > 0) {
+                    this->AddLocalBase(cur_hash, tmp_compress_chunk, tmp_compress_size,
+                        cur_type, cur_depth);
+                }
+                else {
+                    this->AddLocalBase(cur_hash, tmp_original_chunk, tmp_original_size,
+                        cur_type, cur_depth);
+                }
+
                 // move on
                 tmp_update_entry ++;
                 update_num ++;
@@ -380,18 +482,15 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
             auto local_find = batch_fp_index_.find(query_local);
             if (local_find != batch_fp_index_.end()) {
                 // get the base chunk in current batch
-                if (local_find->second.type != COMP_ONLY_CHUNK) {
-#if (DEBUG_FLAG == 1)                      
-                    SyncEnclave::Logging("error ", "multi-level delta\n");
-#endif                    
-                    continue;
-                }
+                // a chunk beyond the max depth is still decoded and written, it 
+                // is only not kept as a base (checked in AddLocalBase)
+                uint8_t cur_depth = local_find->second.depth + 1;
 #if (DEBUG_FLAG == 1)
                 // // SyncEnclave::Logging("writer check base: local delta comp", "\n");
                 // Ocall_PrintfBinary(check_basehash, CHUNK_HASH_SIZE);
 #endif
                 // delta decode
-                tmp_original_size = DeltaDecode(plain_in_buf_ + local_find->second.offset, 
+                tmp_original_size = DeltaDecode(this->GetLocalBase(local_find->second),
                     local_find->second.size, tmp_decomp_chunk, tmp_decomp_size, tmp_original_chunk);
 #if (DEBUG_FLAG == 1)  
                 // // SyncEnclave::Logging("batch local decode size 6: ", "original = %d; decode = %d\n", tmp_decomp_size,tmp_original_size);
@@ -399,9 +498,8 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                 // generate chunkhash
                 crypto_util_->GenerateHMAC(tmp_original_chunk, tmp_original_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-                // use the extra hash function
-                uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-                crypto_util_->GenerateHash(tmp_original_chunk, tmp_original_size, tmp_hash_val);
+                // use the extra hash function (hashed per batch)
+                this->AddToHashBatch(tmp_original_chunk, tmp_original_size);
 #endif
                 // extract features
                 this->ExtractFeature(rabin_ctx_, tmp_original_chunk, tmp_original_size, cur_feature);
@@ -453,6 +551,16 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                     _comp_similar_size += tmp_original_size;
                 }
 
+                // keep it as a base for the following delta chunks in the batch
+                if (tmp_compress_size > 0) {
+                    this->AddLocalBase(cur_hash, tmp_compress_chunk, tmp_compress_size,
+                        cur_type, cur_depth);
+                }
+                else {
+                    this->AddLocalBase(cur_hash, tmp_original_chunk, tmp_original_size,
+                        cur_type, cur_depth);
+                }
+
                 // move on
                 tmp_update_entry ++;
                 update_num ++;
@@ -799,8 +907,13 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
     // // SyncEnclave::Logging("fp index insert: update num = ", "%d (%d)\n", update_index->queryNum, update_num);
 #endif
 
-    // update the fp index here
-    Ocall_UpdateOutFPIndex((void*)update_index);
+#if EXTRA_HASH_FUNCTION == 1
+    // hash the whole batch at once
+    this->FlushHashBatch();
+#endif
+
+    // update the fp index here (insert-only, entries are unique)
+    Ocall_InsertOutFPIndex((void*)update_index);
 
     if (pending_delta_list_.size() != 0) {
 #if (DEBUG_FLAG == 1)          
@@ -853,6 +966,7 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
 
     // prepare the batch fp index
     batch_fp_index_.clear();
+    batch_base_offset_ = 0;
     BatchAddrValue_t tmp_batch_addr_value;
 
     // process recv batch
@@ -878,6 +992,7 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
         tmp_batch_addr_value.type = cur_type;
         tmp_batch_addr_value.size = cur_size;
         tmp_batch_addr_value.offset = process_size;
+        tmp_batch_addr_value.depth = 0;
 
         uint8_t* cur_iv = this->PickNewIV();
 
@@ -926,9 +1041,8 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
             // generate chunkhash
             crypto_util_->GenerateHMAC(tmp_original_chunk, tmp_original_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-            // use the extra hash function
-            uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-            crypto_util_->GenerateHash(tmp_original_chunk, tmp_original_size, tmp_hash_val);
+            // use the extra hash function (hashed per batch)
+            this->AddToHashBatch(tmp_original_chunk, tmp_original_size);
 #endif
 
             // insert the chunk to batch index
@@ -1016,15 +1130,12 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
 #endif
 
                 // get the base chunk in current batch
-                if (local_find->second.type != COMP_ONLY_CHUNK) {
-#if (DEBUG_FLAG == 1)                      
-                    SyncEnclave::Logging("error ", "multi-level delta\n");
-#endif                    
-                    continue;
-                }
+                // a chunk beyond the max depth is still decoded and written, it 
+                // is only not kept as a base (checked in AddLocalBase)
+                uint8_t cur_depth = local_find->second.depth + 1;
                 
                 // delta decode
-                tmp_original_size = DeltaDecode(plain_in_buf_ + local_find->second.offset,
+                tmp_original_size = DeltaDecode(this->GetLocalBase(local_find->second),
                     local_find->second.size, delta_data, cur_size, tmp_original_chunk);
 #if (DEBUG_FLAG == 1)  
                 // // SyncEnclave::Logging("batch local decode size 7: ", "original = %d; decode = %d\n", cur_size,tmp_original_size);
@@ -1032,9 +1143,8 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                 // generate chunkhash
                 crypto_util_->GenerateHMAC(tmp_original_chunk, tmp_original_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-                // use the extra hash function
-                uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-                crypto_util_->GenerateHash(tmp_original_chunk, tmp_original_size, tmp_hash_val);
+                // use the extra hash function (hashed per batch)
+                this->AddToHashBatch(tmp_original_chunk, tmp_original_size);
 #endif
                 // extract features
                 this->ExtractFeature(rabin_ctx_, tmp_original_chunk, tmp_original_size, cur_feature);
@@ -1093,6 +1203,16 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                     _comp_similar_size += tmp_original_size;
                 }
 
+                // keep it as a base for the following delta chunks in the batch
+                if (tmp_compress_size > 0) {
+                    this->AddLocalBase(cur_hash, tmp_compress_chunk, tmp_compress_size,
+                        cur_type, cur_depth);
+                }
+                else {
+                    this->AddLocalBase(cur_hash, tmp_original_chunk, tmp_original_size,
+                        cur_type, cur_depth);
+                }
+
                 // move on
                 tmp_update_entry ++;
                 update_num ++;
@@ -1165,19 +1285,16 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
             auto local_find = batch_fp_index_.find(query_local);
             if (local_find != batch_fp_index_.end()) {
                 // get the base chunk in current batch
-                if (local_find->second.type != COMP_ONLY_CHUNK) {
-#if (DEBUG_FLAG == 1)                      
-                    SyncEnclave::Logging("error ", "multi-level delta\n");
-#endif                    
-                    continue;
-                }
+                // a chunk beyond the max depth is still decoded and written, it 
+                // is only not kept as a base (checked in AddLocalBase)
+                uint8_t cur_depth = local_find->second.depth + 1;
 
 #if (DEBUG_FLAG == 1)
                 // // SyncEnclave::Logging("writer check base: local delta comp", "\n");
                 // Ocall_PrintfBinary(check_basehash, CHUNK_HASH_SIZE);
 #endif
                 // delta decode
-                tmp_original_size = DeltaDecode(plain_in_buf_ + local_find->second.offset, 
+                tmp_original_size = DeltaDecode(this->GetLocalBase(local_find->second),
                     local_find->second.size, tmp_decomp_chunk, tmp_decomp_size, tmp_original_chunk);
 
 #if (DEBUG_FLAG == 1)  
@@ -1187,9 +1304,8 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                 // generate chunkhash
                 crypto_util_->GenerateHMAC(tmp_original_chunk, tmp_original_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-                // use the extra hash function
-                uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-                crypto_util_->GenerateHash(tmp_original_chunk, tmp_original_size, tmp_hash_val);
+                // use the extra hash function (hashed per batch)
+                this->AddToHashBatch(tmp_original_chunk, tmp_original_size);
 #endif
                 // extract features
                 this->ExtractFeature(rabin_ctx_, tmp_original_chunk, tmp_original_size, cur_feature);
@@ -1246,6 +1362,16 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
                     _comp_similar_size += tmp_original_size;
                 }
 
+                // keep it as a base for the following delta chunks in the batch
+                if (tmp_compress_size > 0) {
+                    this->AddLocalBase(cur_hash, tmp_compress_chunk, tmp_compress_size,
+                        cur_type, cur_depth);
+                }
+                else {
+                    this->AddLocalBase(cur_hash, tmp_original_chunk, tmp_original_size,
+                        cur_type, cur_depth);
+                }
+
                 // move on
                 tmp_update_entry ++;
                 update_num ++;
@@ -1666,8 +1792,13 @@ void EcallStreamWriter::ProcessBatch(uint8_t* recv_buf, uint32_t recv_size,
     // // SyncEnclave::Logging("fp index insert: update num = ", "%d (%d)\n", update_index->queryNum, update_num);
 #endif
 
-    // update the fp index here
-    Ocall_UpdateOutFPIndex((void*)update_index);
+#if EXTRA_HASH_FUNCTION == 1
+    // hash the whole batch at once
+    this->FlushHashBatch();
+#endif
+
+    // update the fp index here (insert-only, entries are unique)
+    Ocall_InsertOutFPIndex((void*)update_index);
 
     // SyncEnclave::Logging("after update index", "\n");
 
@@ -1698,9 +1829,8 @@ void EcallStreamWriter::ProcessOneChunk(Container_t* container_buf, uint8_t* chu
     uint8_t cur_hash[CHUNK_HASH_SIZE];
     crypto_util_->GenerateHMAC(chunk_data, chunk_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-    // use the extra hash function
-    uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-    crypto_util_->GenerateHash(chunk_data, chunk_size, tmp_hash_val);
+    // use the extra hash function (hashed per batch)
+    this->AddToHashBatch(chunk_data, chunk_size);
 #endif
 #if (DEBUG_FLAG == 1)
     // // debug
@@ -1772,9 +1902,8 @@ void EcallStreamWriter::ProcessOneChunk(Container_t* container_buf, uint8_t* chu
     uint8_t cur_hash[CHUNK_HASH_SIZE];
     crypto_util_->GenerateHMAC(chunk_data, chunk_size, cur_hash);
 #if EXTRA_HASH_FUNCTION == 1
-    // use the extra hash function
-    uint8_t tmp_hash_val[CHUNK_HASH_SIZE];
-    crypto_util_->GenerateHash(chunk_data, chunk_size, tmp_hash_val);
+    // use the extra hash function (hashed per batch)
+    this->AddToHashBatch(chunk_data, chunk_size);
 #endif
 #if (DEBUG_FLAG == 1)
     // // debug
@@ -1985,4 +2114,28 @@ void EcallStreamWriter::SaveChunk(Container_t* container_buf, uint8_t* chunk_dat
 #endif    
 
     return ;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief check whether the recovered chunks exist in the chunk index
+ * 
+ * @param check_query (in: chunk hash; out: dedupFlag)
+ */
+void EcallStreamWriter::CheckIntegrity(OutChunkQuery_t* check_query) {
+    OutChunkQueryEntry_t* tmp_check_entry = check_query->OutChunkQueryBase;
+    for (size_t i = 0; i < check_query->queryNum; i++) {
+        // convert the chunk hash to the index key
+#if (INDEX_ENC == 1)
+        uint8_t tmp_hash[CHUNK_HASH_SIZE];
+        memcpy(tmp_hash, tmp_check_entry->chunkHash, CHUNK_HASH_SIZE);
+        crypto_util_->IndexAESCMCEnc(cipher_ctx_, tmp_hash, CHUNK_HASH_SIZE,
+            SyncEnclave::index_query_key_, tmp_check_entry->chunkHash);
+#endif
+        tmp_check_entry ++;
+    }
+
+    // the chunk is written iff its hash exists in the index (DUPLICATE)
+    Ocall_QueryChunkIndex((void*)check_query);
+
+    return ;
+}
@@ -41,6 +41,8 @@ uint64_t send_meta_batch_size_;
 uint64_t send_recipe_batch_size_;
 // uint64_t max_seg_index_entry_size_;
 uint64_t enclave_cache_item_num_;
+uint64_t max_delta_depth_;
+uint64_t sent_fp_cache_item_num_;
 // lock
 mutex enclave_cache_lck_;
 
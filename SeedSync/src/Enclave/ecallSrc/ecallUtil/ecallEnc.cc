@@ -11,6 +11,241 @@
 
 #include "../../include/ecallEnc.h"
 
+// multi-buffer SHA-256: one chunk per SIMD lane
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MB_SHA256_LANES 8
+typedef __m256i MBVec_t;
+#define MB_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define MB_STORE(p, a) _mm256_storeu_si256((__m256i*)(p), a)
+#define MB_SET1(x) _mm256_set1_epi32(x)
+#define MB_ADD(a, b) _mm256_add_epi32(a, b)
+#define MB_XOR(a, b) _mm256_xor_si256(a, b)
+#define MB_AND(a, b) _mm256_and_si256(a, b)
+#define MB_OR(a, b) _mm256_or_si256(a, b)
+#define MB_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define MB_SRL(a, n) _mm256_srli_epi32(a, n)
+#define MB_SLL(a, n) _mm256_slli_epi32(a, n)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MB_SHA256_LANES 4
+typedef __m128i MBVec_t;
+#define MB_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define MB_STORE(p, a) _mm_storeu_si128((__m128i*)(p), a)
+#define MB_SET1(x) _mm_set1_epi32(x)
+#define MB_ADD(a, b) _mm_add_epi32(a, b)
+#define MB_XOR(a, b) _mm_xor_si128(a, b)
+#define MB_AND(a, b) _mm_and_si128(a, b)
+#define MB_OR(a, b) _mm_or_si128(a, b)
+#define MB_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define MB_SRL(a, n) _mm_srli_epi32(a, n)
+#define MB_SLL(a, n) _mm_slli_epi32(a, n)
+#endif
+
+#if defined(MB_SHA256_LANES)
+#define MB_ROTR(a, n) MB_OR(MB_SRL(a, n), MB_SLL(a, 32 - (n)))
+
+static const uint32_t mb_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t mb_sha256_init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+typedef struct {
+    const uint8_t* data;
+    uint64_t fullBlockNum; // the number of blocks read from data
+    uint64_t blockNum; // including the padding blocks
+    uint64_t blockIndex;
+    uint8_t* hash;
+    uint8_t tail[128]; // the padded tail blocks
+} MBSha256Lane_t;
+
+/**
+ * @brief init a lane with a new message (pad the tail blocks)
+ *
+ * @param lane the lane
+ * @param data the message
+ * @param size the message size
+ * @param hash the output hash
+ */
+static void MBSha256InitLane(MBSha256Lane_t* lane, const uint8_t* data, uint64_t size,
+    uint8_t* hash)
+{
+    uint64_t tailSize = size % 64;
+    uint64_t tailBlockNum = (tailSize + 9 <= 64) ? 1 : 2;
+    uint64_t bitSize = size * 8;
+
+    lane->data = data;
+    lane->fullBlockNum = size / 64;
+    lane->blockNum = lane->fullBlockNum + tailBlockNum;
+    lane->blockIndex = 0;
+    lane->hash = hash;
+
+    memset(lane->tail, 0, sizeof(lane->tail));
+    memcpy(lane->tail, data + lane->fullBlockNum * 64, tailSize);
+    lane->tail[tailSize] = 0x80;
+    for (size_t i = 0; i < 8; i++) {
+        lane->tail[tailBlockNum * 64 - 1 - i] = (uint8_t)(bitSize >> (8 * i));
+    }
+    return;
+}
+
+/**
+ * @brief compress one block per lane
+ *
+ * @param state the lane states (state[word][lane])
+ * @param blockList the current block of each lane
+ */
+static void MBSha256Compress(uint32_t state[8][MB_SHA256_LANES],
+    const uint8_t* blockList[MB_SHA256_LANES])
+{
+    MBVec_t w[16];
+    uint32_t tmpWord[MB_SHA256_LANES];
+    for (size_t t = 0; t < 16; t++) {
+        for (size_t lane = 0; lane < MB_SHA256_LANES; lane++) {
+            const uint8_t* p = blockList[lane] + t * 4;
+            tmpWord[lane] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+                | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+        }
+        w[t] = MB_LOAD(tmpWord);
+    }
+
+    MBVec_t a = MB_LOAD(state[0]);
+    MBVec_t b = MB_LOAD(state[1]);
+    MBVec_t c = MB_LOAD(state[2]);
+    MBVec_t d = MB_LOAD(state[3]);
+    MBVec_t e = MB_LOAD(state[4]);
+    MBVec_t f = MB_LOAD(state[5]);
+    MBVec_t g = MB_LOAD(state[6]);
+    MBVec_t h = MB_LOAD(state[7]);
+
+    for (size_t t = 0; t < 64; t++) {
+        if (t >= 16) {
+            MBVec_t w15 = w[(t - 15) & 15];
+            MBVec_t w2 = w[(t - 2) & 15];
+            MBVec_t s0 = MB_XOR(MB_XOR(MB_ROTR(w15, 7), MB_ROTR(w15, 18)), MB_SRL(w15, 3));
+            MBVec_t s1 = MB_XOR(MB_XOR(MB_ROTR(w2, 17), MB_ROTR(w2, 19)), MB_SRL(w2, 10));
+            w[t & 15] = MB_ADD(MB_ADD(w[t & 15], s0), MB_ADD(w[(t - 7) & 15], s1));
+        }
+        MBVec_t bigSigma1 = MB_XOR(MB_XOR(MB_ROTR(e, 6), MB_ROTR(e, 11)), MB_ROTR(e, 25));
+        MBVec_t ch = MB_XOR(MB_AND(e, f), MB_ANDNOT(e, g));
+        MBVec_t t1 = MB_ADD(MB_ADD(MB_ADD(h, bigSigma1), MB_ADD(ch, MB_SET1(mb_sha256_k[t]))),
+            w[t & 15]);
+        MBVec_t bigSigma0 = MB_XOR(MB_XOR(MB_ROTR(a, 2), MB_ROTR(a, 13)), MB_ROTR(a, 22));
+        MBVec_t maj = MB_OR(MB_AND(a, b), MB_AND(c, MB_OR(a, b)));
+        MBVec_t t2 = MB_ADD(bigSigma0, maj);
+        h = g;
+        g = f;
+        f = e;
+        e = MB_ADD(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = MB_ADD(t1, t2);
+    }
+
+    MB_STORE(state[0], MB_ADD(MB_LOAD(state[0]), a));
+    MB_STORE(state[1], MB_ADD(MB_LOAD(state[1]), b));
+    MB_STORE(state[2], MB_ADD(MB_LOAD(state[2]), c));
+    MB_STORE(state[3], MB_ADD(MB_LOAD(state[3]), d));
+    MB_STORE(state[4], MB_ADD(MB_LOAD(state[4]), e));
+    MB_STORE(state[5], MB_ADD(MB_LOAD(state[5]), f));
+    MB_STORE(state[6], MB_ADD(MB_LOAD(state[6]), g));
+    MB_STORE(state[7], MB_ADD(MB_LOAD(state[7]), h));
+    return;
+}
+
+/**
+ * @brief SHA-256 over a batch of buffers, a lane is refilled with the next
+ * buffer once its current buffer is done
+ *
+ * @param dataBufferList the list of input buffers
+ * @param dataSizeList the list of input sizes
+ * @param bufferNum the number of buffers
+ * @param hashList the output hashes (CHUNK_HASH_SIZE per buffer)
+ */
+static void MBSha256(uint8_t** dataBufferList, const int* dataSizeList, size_t bufferNum,
+    uint8_t* hashList)
+{
+    static const uint8_t idleBlock[64] = { 0 };
+    MBSha256Lane_t laneList[MB_SHA256_LANES];
+    bool isActive[MB_SHA256_LANES];
+    uint32_t state[8][MB_SHA256_LANES];
+    const uint8_t* blockList[MB_SHA256_LANES];
+    size_t nextBuffer = 0;
+    size_t activeNum = 0;
+
+    for (size_t lane = 0; lane < MB_SHA256_LANES; lane++) {
+        isActive[lane] = (nextBuffer < bufferNum);
+        if (isActive[lane]) {
+            MBSha256InitLane(&laneList[lane], dataBufferList[nextBuffer],
+                dataSizeList[nextBuffer], hashList + nextBuffer * CHUNK_HASH_SIZE);
+            nextBuffer++;
+            activeNum++;
+        }
+        for (size_t i = 0; i < 8; i++) {
+            state[i][lane] = mb_sha256_init[i];
+        }
+    }
+
+    while (activeNum != 0) {
+        for (size_t lane = 0; lane < MB_SHA256_LANES; lane++) {
+            MBSha256Lane_t* curLane = &laneList[lane];
+            if (!isActive[lane]) {
+                blockList[lane] = idleBlock;
+            } else if (curLane->blockIndex < curLane->fullBlockNum) {
+                blockList[lane] = curLane->data + curLane->blockIndex * 64;
+            } else {
+                blockList[lane] = curLane->tail
+                    + (curLane->blockIndex - curLane->fullBlockNum) * 64;
+            }
+        }
+
+        MBSha256Compress(state, blockList);
+
+        for (size_t lane = 0; lane < MB_SHA256_LANES; lane++) {
+            MBSha256Lane_t* curLane = &laneList[lane];
+            if (!isActive[lane]) {
+                continue;
+            }
+            curLane->blockIndex++;
+            if (curLane->blockIndex != curLane->blockNum) {
+                continue;
+            }
+
+            // output the digest in big-endian
+            for (size_t i = 0; i < 8; i++) {
+                curLane->hash[i * 4] = (uint8_t)(state[i][lane] >> 24);
+                curLane->hash[i * 4 + 1] = (uint8_t)(state[i][lane] >> 16);
+                curLane->hash[i * 4 + 2] = (uint8_t)(state[i][lane] >> 8);
+                curLane->hash[i * 4 + 3] = (uint8_t)state[i][lane];
+                state[i][lane] = mb_sha256_init[i];
+            }
+
+            // refill the lane
+            if (nextBuffer < bufferNum) {
+                MBSha256InitLane(curLane, dataBufferList[nextBuffer],
+                    dataSizeList[nextBuffer], hashList + nextBuffer * CHUNK_HASH_SIZE);
+                nextBuffer++;
+            } else {
+                isActive[lane] = false;
+                activeNum--;
+            }
+        }
+    }
+    return;
+}
+#endif
+
 /**
  * @brief Construct a new Ecall Crypto:: Ecall Crypto object
  *
@@ -41,6 +276,12 @@ EcallCrypto::EcallCrypto(int cipherType, int hashType)
     if ((mdCtx_ = EVP_MD_CTX_new()) == NULL) {
         Ocall_SGX_Exit_Error("EcallCrypto: allocate md ctx fails");
     }
+
+    // check SHA-NI (CPUID.(EAX=7, ECX=0):EBX[29])
+    int cpuInfo[4] = { 0 };
+    if (sgx_cpuidex(cpuInfo, 7, 0) == SGX_SUCCESS) {
+        isShaNI_ = (cpuInfo[1] >> 29) & 1;
+    }
 }
 
 /**
@@ -114,6 +355,31 @@ void EcallCrypto::GenerateHash(uint8_t* dataBuffer, const int dataSize, uint8_t*
     return;
 }
 
+/**
+ * @brief generate the hashes of a batch of buffers (multi-buffer SHA-256
+ * in SIMD lanes; fall back to GenerateHash with SHA-NI or other hash types)
+ *
+ * @param dataBufferList the list of input data buffers
+ * @param dataSizeList the list of input data sizes
+ * @param bufferNum the number of buffers
+ * @param hashList the result hashes (CHUNK_HASH_SIZE per buffer)
+ */
+void EcallCrypto::GenerateHashBatch(uint8_t** dataBufferList, const int* dataSizeList,
+    size_t bufferNum, uint8_t* hashList)
+{
+#if defined(MB_SHA256_LANES)
+    if (hashType_ == SHA_256 && bufferNum > 1 && !isShaNI_) {
+        MBSha256(dataBufferList, dataSizeList, bufferNum, hashList);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < bufferNum; i++) {
+        this->GenerateHash(dataBufferList[i], dataSizeList[i],
+            hashList + i * CHUNK_HASH_SIZE);
+    }
+    return;
+}
+
 /**
  * @brief generate the hmac of the data
  *
@@ -82,6 +82,8 @@ extern uint64_t send_recipe_batch_size_;
 extern uint64_t send_meta_batch_size_;
 // extern uint64_t max_seg_index_entry_size_;
 extern uint64_t enclave_cache_item_num_;
+extern uint64_t max_delta_depth_;
+extern uint64_t sent_fp_cache_item_num_;
 // lock
 extern mutex enclave_cache_lck_;
 
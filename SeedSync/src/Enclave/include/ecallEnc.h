@@ -17,6 +17,7 @@
 #include "openssl/hmac.h"
 #include "openssl/sha.h"
 #include "string.h"
+#include "sgx_cpuid.h"
 
 #include "../../../include/chunkStructure.h"
 #include "../../../include/constVar.h"
@@ -42,6 +43,8 @@ class EcallCrypto {
         HMAC_CTX* hmacCtx_;
         EVP_MD_CTX* mdCtx_;
         uint64_t hmacCounter_ = 0;
+        // SHA-NI is available (prefer the single-buffer path in openssl)
+        bool isShaNI_ = false;
 
         /**
          * @brief revise the buffer
@@ -84,6 +87,18 @@ class EcallCrypto {
          */
         void GenerateHash(uint8_t* dataBuffer, const int dataSize, uint8_t* hash);
 
+        /**
+         * @brief generate the hashes of a batch of buffers (multi-buffer SHA-256
+         * in SIMD lanes; fall back to GenerateHash with SHA-NI or other hash types)
+         *
+         * @param dataBufferList the list of input data buffers
+         * @param dataSizeList the list of input data sizes
+         * @param bufferNum the number of buffers
+         * @param hashList the result hashes (CHUNK_HASH_SIZE per buffer)
+         */
+        void GenerateHashBatch(uint8_t** dataBufferList, const int* dataSizeList,
+            size_t bufferNum, uint8_t* hashList);
+
         /**
          * @brief generate the hmac of the data
          * 
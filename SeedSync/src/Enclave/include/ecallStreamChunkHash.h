@@ -41,10 +41,18 @@ private:
     // chunk fp buffer
     uint8_t* plain_fp_list_;
 
+    // the chunk fps sent in this session (bounded, nullptr: disabled), the 
+    // repeated ones in later batches are left to their first occurrence. 
+    // direct-mapped slots of whole fps: a new fp overwrites its slot, and only 
+    // an exact match is suppressed
+    uint8_t* sent_fp_table_ = nullptr;
+    uint64_t sent_fp_slot_num_ = 0;
+
 public:
     // for logs
     uint64_t _total_chunk_fp_num = 0;
     uint64_t _total_chunk_size = 0;
+    uint64_t _total_suppressed_num = 0;
 
     /**
      * @brief Construct a new Ecall Stream Chunk Hash object
@@ -65,9 +73,10 @@ public:
      * @param recipe_buf
      * @param recipe_num
      * @param chunk_hash_buf
+     * @param fp_num the num of chunk fps in chunk_hash_buf
      */
     void ProcessBatch(uint8_t* filename_buf, uint32_t currentBatchID, uint8_t* recipe_buf,
-        size_t recipe_num, uint8_t* chunk_hash_buf);
+        size_t recipe_num, uint8_t* chunk_hash_buf, size_t* fp_num);
 };
 
 #endif
\ No newline at end of file
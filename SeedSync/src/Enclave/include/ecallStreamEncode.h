@@ -20,6 +20,11 @@
 
 class EcallCrypto;
 
+typedef struct {
+    uint8_t depth; // delta chain length to a materialized chunk
+    bool is_local; // whether dest can decode it within the batch
+} DeltaDepth_t;
+
 class EcallStreamEncode {
     private:
         string my_name_ = "EcallStreamEncode";
@@ -41,6 +46,9 @@ class EcallStreamEncode {
 
         std::vector<SyncRecipeEntry_t> local_addr_list_;
 
+        // delta depth of the chunks sent in current batch (key: index key)
+        unordered_map<string, DeltaDepth_t> batch_depth_map_;
+
         /**
          * @brief perform delta encoding
          * 
@@ -64,17 +72,32 @@ class EcallStreamEncode {
          * @param base_size 
          * @param input_chunk 
          * @param input_size 
+         * @param base_key 
+         * @param sim_key 
          */
         void PocessSimChunk(uint8_t* base_chunk_data, uint32_t base_size,
-            uint8_t* base_hash, uint8_t* sim_chunk_data, uint32_t sim_size);
+            uint8_t* base_hash, uint8_t* sim_chunk_data, uint32_t sim_size,
+            uint8_t* base_key, uint8_t* sim_key);
 
         /**
          * @brief process a non-similar chunk
          * 
          * @param input_chunk 
          * @param input_size 
+         * @param chunk_key 
+         */
+        void ProcessNonSimChunk(uint8_t* input_chunk, uint32_t input_size,
+            uint8_t* chunk_key);
+
+        /**
+         * @brief get the delta depth of a similar chunk if it is encoded with the base
+         * 
+         * @param base_key 
+         * @param depth 
+         * @return true if the chain does not exceed the max delta depth
+         * @return false 
          */
-        void ProcessNonSimChunk(uint8_t* input_chunk, uint32_t input_size);
+        bool CheckDeltaDepth(uint8_t* base_key, DeltaDepth_t& depth);
     
     public:
         // for logs
@@ -83,6 +106,7 @@ class EcallStreamEncode {
         uint64_t _total_base_chunk_size;
         uint64_t _total_delta_size;
         uint64_t _total_comp_delta_size;
+        uint64_t _total_depth_capped_num;
 
         /**
          * @brief Construct a new Ecall Stream Encode object
@@ -24,6 +24,7 @@ typedef struct {
     uint32_t offset;
     uint32_t size;
     uint8_t type;
+    uint8_t depth; // delta chain depth in the batch
 } BatchAddrValue_t;
 
 typedef struct {
@@ -61,6 +62,10 @@ class EcallStreamWriter {
         // local batch fp index
         unordered_map<string, BatchAddrValue_t> batch_fp_index_;
 
+        // recovered delta chunks in current batch (as bases of following deltas)
+        uint8_t* batch_base_buf_;
+        uint32_t batch_base_offset_;
+
         // delta chunk pos in plain_in_buf (pending for decoding)
         // std::vector<BatchAddrValue_t> pending_delta_list_;
         std::queue<DeltaBatchAddrValue_t> pending_delta_list_;
@@ -70,6 +75,33 @@ class EcallStreamWriter {
         // for update index
         // OutChunkQuery_t* update_index_;
 
+        // for batched extra hash (multi-buffer)
+        uint8_t* hash_batch_buf_;
+        uint8_t** hash_batch_ptr_list_;
+        int* hash_batch_size_list_;
+        uint8_t* hash_batch_out_;
+        size_t hash_batch_num_;
+
+        /**
+         * @brief get the base chunk data in current batch
+         * 
+         * @param base_addr 
+         * @return uint8_t* 
+         */
+        uint8_t* GetLocalBase(BatchAddrValue_t& base_addr);
+
+        /**
+         * @brief keep a recovered delta chunk as a base in current batch
+         * 
+         * @param chunk_hash 
+         * @param chunk_data 
+         * @param chunk_size 
+         * @param chunk_type 
+         * @param depth 
+         */
+        void AddLocalBase(uint8_t* chunk_hash, uint8_t* chunk_data,
+            uint32_t chunk_size, uint8_t chunk_type, uint8_t depth);
+
         /**
          * @brief delta decoding
          * 
@@ -137,6 +169,20 @@ class EcallStreamWriter {
             OutChunkQueryEntry_t* debug_check_entry);
 
 
+        /**
+         * @brief add a recovered chunk to the hash batch
+         * 
+         * @param chunk_data 
+         * @param chunk_size 
+         */
+        void AddToHashBatch(uint8_t* chunk_data, uint32_t chunk_size);
+
+        /**
+         * @brief hash all chunks in the hash batch
+         * 
+         */
+        void FlushHashBatch();
+
         // void ProcessCompOnlyChunk()
 
     public:
@@ -195,6 +241,13 @@ class EcallStreamWriter {
             ReqContainer_t* req_container, OutChunkQuery_t* base_addr_query,
             Container_t* container_buf, OutChunkQuery_t* update_index, 
             OutChunkQuery_t* debug_check_quary);
+
+        /**
+         * @brief check whether the recovered chunks exist in the chunk index
+         * 
+         * @param check_query (in: chunk hash; out: dedupFlag)
+         */
+        void CheckIntegrity(OutChunkQuery_t* check_query);
 };
 
 #endif
\ No newline at end of file
@@ -77,8 +77,9 @@ void Ecall_Destroy_Sync();
  * @param recipe_buf
  * @param recipe_num
  * @param chunk_hash_buf
+ * @param fp_num the num of chunk fps in chunk_hash_buf
  */
-void Ecall_Stream_Phase1_ProcessBatch(uint8_t* filename_buf, uint32_t currentBatchID, uint8_t* recipe_buf, size_t recipe_num, uint8_t* chunk_hash_buf);
+void Ecall_Stream_Phase1_ProcessBatch(uint8_t* filename_buf, uint32_t currentBatchID, uint8_t* recipe_buf, size_t recipe_num, uint8_t* chunk_hash_buf, size_t* fp_num);
 
 /**
  * @brief process the batch of phase-2 in stream mode: identify uni chunk hash
@@ -180,4 +181,11 @@ void Ecall_Stream_Phase6_ProcessBatch_Debug(uint8_t* recv_buf, uint32_t recv_siz
     Container_t* container_buf, OutChunkQuery_t* update_index,
     OutChunkQuery_t* debug_check_quary);
 
+/**
+ * @brief check whether the recovered chunks exist in the chunk index
+ *
+ * @param check_query
+ */
+void Ecall_Stream_Phase6_CheckIntegrity(OutChunkQuery_t* check_query);
+
 #endif
@@ -15,16 +15,22 @@
 #include "ocallUtil.h"
 #include "../../../include/absDatabase.h"
 #include "../../../include/sync_storage.h"
+#include "../../../include/sync_configure.h"
 #include "../../../include/phase_sender.h"
 #include "../../../build/src/Enclave/storeEnclave_u.h"
 
 // for sgx
 #include "sgx_urts.h"
 
+// for group commit
+#include <fcntl.h>
+
+extern SyncConfigure sync_config;
+
 namespace SyncOutEnclave {
-    // ocall for out-enclave global indexes
-    extern AbsDatabase* out_chunk_index_;
-    extern AbsDatabase* out_feature_index_;
+    // ocall for out-enclave global indexes (of the side the calling thread runs for)
+    extern thread_local AbsDatabase* out_chunk_index_;
+    extern thread_local AbsDatabase* out_feature_index_;
 
     extern string my_name_;
     
@@ -47,11 +53,50 @@ namespace SyncOutEnclave {
     void Init(AbsDatabase* out_chunk_index, AbsDatabase* out_feature_index, 
         SyncStorage* sync_storage);
 
+    /**
+     * @brief bind the calling thread to the indexes and storage of one side (when
+     * the source and the dest run in one process)
+     * 
+     * @param out_chunk_index 
+     * @param out_feature_index 
+     * @param sync_storage 
+     */
+    void BindThread(AbsDatabase* out_chunk_index, AbsDatabase* out_feature_index, 
+        SyncStorage* sync_storage);
+
     /**
      * @brief destroy the sync ocall var
      * 
      */
     void Destroy();
+
+    /**
+     * @brief replay the committed index delta into the outside fp index
+     * (the outside index itself is only dumped at clean shutdown)
+     * 
+     */
+    void ReplayIndexDelta();
+
+    /**
+     * @brief make the pending containers and index delta durable, and
+     * record the commit point in the manifest (hold sync_storage_lck_)
+     * 
+     */
+    void GroupCommit();
+
+    /**
+     * @brief force a group commit (e.g., at the end of a file)
+     * 
+     */
+    void ForceGroupCommit();
+
+    /**
+     * @brief drop the index delta once the outside fp index is dumped (clean 
+     * shutdown), and reset the commit point
+     * 
+     * @param chunk_index_name the dumped outside fp index
+     */
+    void ResetIndexDelta(string chunk_index_name);
 };
 
 /**
@@ -221,6 +266,13 @@ void Ocall_WriteSyncContainer(Container_t* newContainer);
  */
 void Ocall_UpdateOutFPIndex(void* update_index);
 
+/**
+ * @brief insert a batch of unique fps to the outside fp index (insert-only)
+ * 
+ * @param update_index 
+ */
+void Ocall_InsertOutFPIndex(void* update_index);
+
 // for debugging
 void Ocall_InsertDebugIndex(void* debug_index);
 
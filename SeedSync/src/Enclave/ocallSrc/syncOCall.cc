@@ -12,9 +12,16 @@
 #include "../include/syncOcall.h"
 
 namespace SyncOutEnclave {
-AbsDatabase* out_chunk_index_ = NULL;
-AbsDatabase* out_feature_index_ = NULL;
-SyncStorage* sync_storage_ = NULL;
+// set by Init, used by the threads not bound to a side
+AbsDatabase* default_chunk_index_ = NULL;
+AbsDatabase* default_feature_index_ = NULL;
+SyncStorage* default_sync_storage_ = NULL;
+
+// the indexes and storage of the side the calling thread runs for (the ocalls
+// run on the thread issuing the ecall)
+thread_local AbsDatabase* out_chunk_index_ = default_chunk_index_;
+thread_local AbsDatabase* out_feature_index_ = default_feature_index_;
+thread_local SyncStorage* sync_storage_ = default_sync_storage_;
 
 string my_name_ = "SyncOcall";
 
@@ -30,6 +37,18 @@ ifstream inSealedFile_;
 pthread_rwlock_t chunk_index_lck_;
 pthread_rwlock_t feature_index_lck_;
 pthread_mutex_t sync_storage_lck_;
+
+// for group commit
+bool is_group_commit_ = false;
+uint64_t group_commit_container_num_ = 0;
+uint64_t group_commit_interval_ms_ = 0;
+vector<int> pending_container_fds_;
+struct timeval last_commit_time_;
+uint64_t commit_seq_ = 0;
+int index_delta_fd_ = -1;
+uint64_t index_delta_size_ = 0;
+uint64_t committed_delta_size_ = 0;
+pthread_mutex_t index_delta_lck_;
 };
 
 using namespace SyncOutEnclave;
@@ -42,12 +61,42 @@ using namespace SyncOutEnclave;
  */
 void SyncOutEnclave::Init(AbsDatabase* out_chunk_index, AbsDatabase* out_feature_index,
     SyncStorage* sync_storage) {
+    default_chunk_index_ = out_chunk_index;
+    default_feature_index_ = out_feature_index;
+    default_sync_storage_ = sync_storage;
     out_chunk_index_ = out_chunk_index;
     out_feature_index_ = out_feature_index;
     sync_storage_ = sync_storage;
     pthread_rwlock_init(&chunk_index_lck_, NULL);
     pthread_rwlock_init(&feature_index_lck_, NULL);
     pthread_mutex_init(&sync_storage_lck_, NULL);
+    pthread_mutex_init(&index_delta_lck_, NULL);
+
+    // group commit: N containers per fdatasync (0: disable)
+    group_commit_container_num_ = sync_config.GetGroupCommitContainerNum();
+    group_commit_interval_ms_ = sync_config.GetGroupCommitInterval();
+    is_group_commit_ = (group_commit_container_num_ != 0);
+    if (is_group_commit_) {
+        ReplayIndexDelta();
+        gettimeofday(&last_commit_time_, NULL);
+    }
+
+    return;
+}
+
+/**
+ * @brief bind the calling thread to the indexes and storage of one side (when
+ * the source and the dest run in one process)
+ *
+ * @param out_chunk_index
+ * @param out_feature_index
+ * @param sync_storage
+ */
+void SyncOutEnclave::BindThread(AbsDatabase* out_chunk_index, AbsDatabase* out_feature_index,
+    SyncStorage* sync_storage) {
+    out_chunk_index_ = out_chunk_index;
+    out_feature_index_ = out_feature_index;
+    sync_storage_ = sync_storage;
 
     return;
 }
@@ -57,6 +106,19 @@ void SyncOutEnclave::Init(AbsDatabase* out_chunk_index, AbsDatabase* out_feature
  *
  */
 void SyncOutEnclave::Destroy() {
+    if (is_group_commit_) {
+        // the containers not committed yet are dropped in recovery
+        for (auto fd : pending_container_fds_) {
+            close(fd);
+        }
+        pending_container_fds_.clear();
+        if (index_delta_fd_ != -1) {
+            close(index_delta_fd_);
+            index_delta_fd_ = -1;
+        }
+    }
+
+    pthread_mutex_destroy(&index_delta_lck_);
     pthread_rwlock_destroy(&chunk_index_lck_);
     pthread_rwlock_destroy(&feature_index_lck_);
     pthread_mutex_destroy(&sync_storage_lck_);
@@ -64,6 +126,195 @@ void SyncOutEnclave::Destroy() {
     return;
 }
 
+/**
+ * @brief append the index delta records to the log (not synced)
+ *
+ * @param delta_buf the buffer of <chunk hash, recipe entry> records
+ * @param delta_size the size of records in byte
+ */
+static void AppendIndexDelta(const string& delta_buf, size_t delta_size) {
+    pthread_mutex_lock(&index_delta_lck_);
+    if (!tool::WriteAll(index_delta_fd_, (uint8_t*)&delta_buf[0], delta_size)) {
+        tool::Logging(my_name_.c_str(), "cannot append the index delta log.\n");
+        exit(EXIT_FAILURE);
+    }
+    index_delta_size_ += delta_size;
+    pthread_mutex_unlock(&index_delta_lck_);
+    return;
+}
+
+/**
+ * @brief record the commit point in the manifest (atomic rename)
+ *
+ * @param delta_size the committed size of the index delta log
+ */
+static void WriteManifest(uint64_t delta_size) {
+    commit_seq_++;
+    string content = "commit_seq " + to_string(commit_seq_) + "\n"
+        + "index_delta_size " + to_string(delta_size) + "\n";
+
+    if (!tool::PersistFile(sync_config.GetCommitManifestName(), content)) {
+        tool::Logging(my_name_.c_str(), "fail to write the commit manifest.\n");
+        exit(EXIT_FAILURE);
+    }
+    return;
+}
+
+/**
+ * @brief replay the committed index delta into the outside fp index
+ * (the outside index itself is only dumped at clean shutdown)
+ *
+ */
+void SyncOutEnclave::ReplayIndexDelta() {
+    string manifest_name = sync_config.GetCommitManifestName();
+    string delta_name = sync_config.GetIndexDeltaLogName();
+
+    // read the last commit point
+    ifstream manifest_file;
+    manifest_file.open(manifest_name, ios_base::in);
+    if (manifest_file.is_open()) {
+        string key;
+        uint64_t value;
+        while (manifest_file >> key >> value) {
+            if (key == "commit_seq") {
+                commit_seq_ = value;
+            } else if (key == "index_delta_size") {
+                committed_delta_size_ = value;
+            }
+        }
+        manifest_file.close();
+    }
+
+    index_delta_fd_ = open(delta_name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (index_delta_fd_ < 0) {
+        tool::Logging(my_name_.c_str(), "cannot open index delta log: %s\n",
+            delta_name.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    // replay the committed prefix: <chunk hash, recipe entry>
+    const size_t record_size = CHUNK_HASH_SIZE + sizeof(RecipeEntry_t);
+    uint8_t record[record_size];
+    uint64_t replay_num = 0;
+    uint64_t offset = 0;
+    while (offset + record_size <= committed_delta_size_) {
+        if (pread(index_delta_fd_, record, record_size, offset) != (ssize_t)record_size) {
+            break;
+        }
+        out_chunk_index_->InsertBothBuffer((char*)record, CHUNK_HASH_SIZE,
+            (char*)record + CHUNK_HASH_SIZE, sizeof(RecipeEntry_t));
+        offset += record_size;
+        replay_num++;
+    }
+
+    // drop the uncommitted tail (its containers may not be durable)
+    if (ftruncate(index_delta_fd_, offset) != 0) {
+        tool::Logging(my_name_.c_str(), "cannot truncate index delta log.\n");
+        exit(EXIT_FAILURE);
+    }
+    lseek(index_delta_fd_, offset, SEEK_SET);
+    index_delta_size_ = offset;
+    committed_delta_size_ = offset;
+
+    if (replay_num != 0) {
+        tool::Logging(my_name_.c_str(), "replay %lu index entries from commit %lu.\n",
+            replay_num, commit_seq_);
+    }
+
+    return;
+}
+
+/**
+ * @brief make the pending containers and index delta durable, and
+ * record the commit point in the manifest (hold sync_storage_lck_)
+ *
+ */
+void SyncOutEnclave::GroupCommit() {
+    if (!is_group_commit_) {
+        return;
+    }
+
+    // step-1: persist the containers of this group
+    for (auto fd : pending_container_fds_) {
+        if (fdatasync(fd) != 0) {
+            tool::Logging(my_name_.c_str(), "fail to fdatasync the container.\n");
+            exit(EXIT_FAILURE);
+        }
+        close(fd);
+    }
+    if (pending_container_fds_.size() != 0) {
+        tool::SyncDir(config.GetContainerRootPath());
+    }
+    pending_container_fds_.clear();
+
+    // step-2: persist the matching index delta (only called after a container
+    // write or at the end of a file, so all logged entries point to written containers)
+    pthread_mutex_lock(&index_delta_lck_);
+    uint64_t delta_size = index_delta_size_;
+    if (delta_size != committed_delta_size_) {
+        if (fdatasync(index_delta_fd_) != 0) {
+            tool::Logging(my_name_.c_str(), "fail to fdatasync the index delta.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_mutex_unlock(&index_delta_lck_);
+
+    // step-3: record the commit point in the manifest (atomic rename)
+    if (delta_size != committed_delta_size_ || commit_seq_ == 0) {
+        WriteManifest(delta_size);
+        committed_delta_size_ = delta_size;
+    }
+
+    gettimeofday(&last_commit_time_, NULL);
+
+    return;
+}
+
+/**
+ * @brief force a group commit (e.g., at the end of a file)
+ *
+ */
+void SyncOutEnclave::ForceGroupCommit() {
+    pthread_mutex_lock(&sync_storage_lck_);
+    GroupCommit();
+    pthread_mutex_unlock(&sync_storage_lck_);
+    return;
+}
+
+/**
+ * @brief drop the index delta once the outside fp index is dumped (clean
+ * shutdown), and reset the commit point
+ *
+ * @param chunk_index_name the dumped outside fp index
+ */
+void SyncOutEnclave::ResetIndexDelta(string chunk_index_name) {
+    if (!is_group_commit_) {
+        return;
+    }
+
+    // the dump replaces the delta only once it is durable
+    int index_fd = open(chunk_index_name.c_str(), O_RDONLY);
+    if (index_fd < 0 || fsync(index_fd) != 0) {
+        tool::Logging(my_name_.c_str(), "cannot persist the dumped index, keep the index delta.\n");
+        if (index_fd >= 0) {
+            close(index_fd);
+        }
+        return;
+    }
+    close(index_fd);
+
+    // a crash in between is fine: an empty log or a zero commit point replays nothing
+    WriteManifest(0);
+    if (truncate(sync_config.GetIndexDeltaLogName().c_str(), 0) != 0) {
+        tool::Logging(my_name_.c_str(), "cannot truncate index delta log.\n");
+        exit(EXIT_FAILURE);
+    }
+    committed_delta_size_ = 0;
+    index_delta_size_ = 0;
+
+    return;
+}
+
 /**
  * @brief exit the enclave with error message
  *
@@ -556,12 +807,12 @@ void Ocall_WriteChunkBatch(uint8_t* chunk_data, uint32_t chunk_num) {
 void Ocall_WriteSyncContainer(Container_t* newContainer) {
     pthread_mutex_lock(&sync_storage_lck_);
 
-    FILE* containerFile = NULL;
+    int containerFd = -1;
     string fileName((char*)newContainer->containerID, CONTAINER_ID_LENGTH);
     string fileFullName = config.GetContainerRootPath() + fileName
         + config.GetContainerSuffix();
-    containerFile = fopen(fileFullName.c_str(), "wb");
-    if (!containerFile) {
+    containerFd = open(fileFullName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (containerFd < 0) {
         tool::Logging(my_name_.c_str(), "cannot open container file: %s\n", fileFullName.c_str());
         exit(EXIT_FAILURE);
     }
@@ -584,13 +835,31 @@ void Ocall_WriteSyncContainer(Container_t* newContainer) {
     //     cout<<endl;
     // }
 #endif
-    fwrite((char*)&newContainer->currentMetaSize, sizeof(uint32_t), 1, containerFile);
-    fwrite((char*)newContainer->metadata, newContainer->currentMetaSize, 1,
-        containerFile);
+    bool ret = tool::WriteAll(containerFd, (uint8_t*)&newContainer->currentMetaSize,
+        sizeof(uint32_t));
+    ret = ret && tool::WriteAll(containerFd, newContainer->metadata,
+        newContainer->currentMetaSize);
     // write the data
-    fwrite((char*)newContainer->body, newContainer->currentSize, 1,
-        containerFile);
-    fclose(containerFile);
+    ret = ret && tool::WriteAll(containerFd, newContainer->body,
+        newContainer->currentSize);
+    if (!ret) {
+        tool::Logging(my_name_.c_str(), "cannot write container file: %s\n", fileFullName.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    if (is_group_commit_) {
+        // defer the fdatasync to the group commit
+        pending_container_fds_.push_back(containerFd);
+        struct timeval current_time;
+        gettimeofday(&current_time, NULL);
+        double elapsed_ms = tool::GetTimeDiff(last_commit_time_, current_time) * 1000;
+        if (pending_container_fds_.size() >= group_commit_container_num_ ||
+            (group_commit_interval_ms_ != 0 && elapsed_ms >= group_commit_interval_ms_)) {
+            GroupCommit();
+        }
+    } else {
+        close(containerFd);
+    }
 
     // reset the current container
     tool::CreateUUID(newContainer->containerID, CONTAINER_ID_LENGTH);
@@ -615,6 +884,15 @@ void Ocall_UpdateOutFPIndex(void* update_index)
     string value;
     value.resize(sizeof(RecipeEntry_t), 0);
     bool res = false;
+
+    // for index delta log
+    const size_t record_size = CHUNK_HASH_SIZE + sizeof(RecipeEntry_t);
+    string delta_buf;
+    size_t delta_num = 0;
+    if (is_group_commit_) {
+        delta_buf.resize(update_index_ptr->queryNum * record_size, 0);
+    }
+
     for (size_t i = 0; i < update_index_ptr->queryNum; i++) {
         res = out_chunk_index_->QueryBuffer((char*)tmp_entry->chunkHash,
             CHUNK_HASH_SIZE, value);
@@ -643,6 +921,15 @@ void Ocall_UpdateOutFPIndex(void* update_index)
             out_chunk_index_->InsertBothBuffer((char*)tmp_entry->chunkHash,
                 CHUNK_HASH_SIZE, (char*)&tmp_entry->value, sizeof(RecipeEntry_t));
 
+            if (is_group_commit_) {
+                // log the index delta (persisted at the next group commit)
+                memcpy(&delta_buf[delta_num * record_size], tmp_entry->chunkHash,
+                    CHUNK_HASH_SIZE);
+                memcpy(&delta_buf[delta_num * record_size + CHUNK_HASH_SIZE],
+                    &tmp_entry->value, sizeof(RecipeEntry_t));
+                delta_num++;
+            }
+
 #if (DEBUG_FLAG == 1)
             // // debug
             // string check_value;
@@ -666,6 +953,58 @@ void Ocall_UpdateOutFPIndex(void* update_index)
 
     pthread_rwlock_unlock(&chunk_index_lck_);
 
+    if (delta_num != 0) {
+        AppendIndexDelta(delta_buf, delta_num * record_size);
+    }
+
+    // reset the update index
+    update_index_ptr->queryNum = 0;
+
+    return;
+}
+
+/**
+ * @brief insert a batch of unique fps to the outside fp index (insert-only)
+ *
+ * @param update_index
+ */
+void Ocall_InsertOutFPIndex(void* update_index)
+{
+    OutChunkQuery_t* update_index_ptr = (OutChunkQuery_t*)update_index;
+    OutChunkQueryEntry_t* tmp_entry = update_index_ptr->OutChunkQueryBase;
+
+    // for index delta log
+    const size_t record_size = CHUNK_HASH_SIZE + sizeof(RecipeEntry_t);
+    string delta_buf;
+    size_t delta_num = 0;
+    if (is_group_commit_) {
+        delta_buf.resize(update_index_ptr->queryNum * record_size, 0);
+    }
+
+    // entries from phase-6 are unique (filtered in phase-2), skip the query
+    pthread_rwlock_wrlock(&chunk_index_lck_);
+    out_chunk_index_->Reserve(update_index_ptr->queryNum);
+    for (size_t i = 0; i < update_index_ptr->queryNum; i++) {
+        bool res = out_chunk_index_->InsertOnlyBuffer((char*)tmp_entry->chunkHash,
+            CHUNK_HASH_SIZE, (char*)&tmp_entry->value, sizeof(RecipeEntry_t));
+
+        if (res && is_group_commit_) {
+            // log the index delta (persisted at the next group commit)
+            memcpy(&delta_buf[delta_num * record_size], tmp_entry->chunkHash,
+                CHUNK_HASH_SIZE);
+            memcpy(&delta_buf[delta_num * record_size + CHUNK_HASH_SIZE],
+                &tmp_entry->value, sizeof(RecipeEntry_t));
+            delta_num++;
+        }
+
+        tmp_entry++;
+    }
+    pthread_rwlock_unlock(&chunk_index_lck_);
+
+    if (delta_num != 0) {
+        AppendIndexDelta(delta_buf, delta_num * record_size);
+    }
+
     // reset the update index
     update_index_ptr->queryNum = 0;
 
@@ -0,0 +1,90 @@
+/**
+ * @file flow_credit.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in flow_credit.h
+ * @version 0.1
+ * @date 2024-08-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/flow_credit.h"
+
+/**
+ * @brief Construct a new Flow Credit object
+ *
+ * @param window
+ */
+FlowCredit::FlowCredit(uint64_t window) {
+    window_ = window;
+    credit_num_ = window;
+}
+
+/**
+ * @brief Destroy the Flow Credit object
+ *
+ */
+FlowCredit::~FlowCredit() {
+    ;
+}
+
+/**
+ * @brief take a credit, wait until the receiver returns one if none left
+ *
+ */
+void FlowCredit::Acquire() {
+    std::unique_lock<std::mutex> lck(credit_mutex_);
+    credit_cond_.wait(lck, [this] {
+        return credit_num_ != 0;
+    });
+    credit_num_ --;
+
+    return ;
+}
+
+/**
+ * @brief take a credit without waiting
+ *
+ * @return true success
+ * @return false no credit left
+ */
+bool FlowCredit::TryAcquire() {
+    std::lock_guard<std::mutex> lck(credit_mutex_);
+    if (credit_num_ == 0) {
+        return false;
+    }
+    credit_num_ --;
+
+    return true;
+}
+
+/**
+ * @brief return the credits (the batches consumed by the receiver)
+ *
+ * @param credit_num
+ */
+void FlowCredit::Grant(uint64_t credit_num) {
+    {
+        std::lock_guard<std::mutex> lck(credit_mutex_);
+        // the credits of the previous connection may come late
+        credit_num_ = min(credit_num_ + credit_num, window_);
+    }
+    credit_cond_.notify_all();
+
+    return ;
+}
+
+/**
+ * @brief reset the credits to the whole window (for a new connection)
+ *
+ */
+void FlowCredit::Reset() {
+    {
+        std::lock_guard<std::mutex> lck(credit_mutex_);
+        credit_num_ = window_;
+    }
+    credit_cond_.notify_all();
+
+    return ;
+}
@@ -15,85 +15,67 @@ struct timeval recv_stime;
 struct timeval recv_etime;
 struct timeval recv_etime2;
 
+// the start time of the files in the pipeline (phase-2 -> phase-6 of dest)
+std::unordered_map<uint32_t, struct timeval> file_stime_list;
+std::mutex file_stime_mutex;
+
 /**
- * @brief Construct a new Phase Recv object
+ * @brief Construct a new Phase Recv object (phase 2-5)
  * 
  * @param recv_channel 
  * @param recv_conn_record 
- * @param p1_mq 
+ * @param mq 
+ * @param phase_id 
  */
 PhaseRecv::PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_record, 
-    MessageQueue<StreamPhase1MQ_t>* mq, uint8_t phase_id) {
+    MessageQueue<StreamBatchMQ_t>* mq, uint8_t phase_id) {
     
     recv_channel_ = recv_channel;
     recv_conn_record_ = recv_conn_record;
-
-    recv_buf_.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + 
-        sizeof(StreamPhase1MQ_t) * sync_config.GetMetaBatchSize());
-    recv_buf_.dataBuffer = recv_buf_.sendBuffer + sizeof(NetworkHead_t);
-    recv_buf_.header = (NetworkHead_t*) recv_buf_.sendBuffer;
-    recv_buf_.header->currentItemNum = 0;
-    recv_buf_.header->dataSize = 0;
-
+    stream_batch_MQ_ = mq;
     phase_id_ = phase_id;
-    if (phase_id_ == 2) {
-        stream_p1_MQ_ = mq;
-        // tool::Logging(my_name_.c_str(), "init the PhaseRecv for Phase2.\n");
+
+    // the recv buffer size of each phase
+    uint64_t max_item_num = max(sync_config.GetMetaBatchSize(), sync_config.GetDataBatchSize());
+    uint64_t buf_size = sizeof(NetworkHead_t);
+    switch (phase_id_) {
+        case 2:
+        case 3: {
+            buf_size += sizeof(StreamPhase1MQ_t) * sync_config.GetMetaBatchSize();
+            break;
+        }
+        case 4: {
+            buf_size += sizeof(StreamPhase3MQ_t) * max_item_num;
+            break;
+        }
+        case 5: {
+            // also holds the nack fp list (converted into phase-4 entries)
+            buf_size += sizeof(StreamPhase4MQ_t) * max_item_num;
+            break;
+        }
+        default: {
+            tool::Logging(my_name_.c_str(), "wrong phase id %u for batch MQ.\n", phase_id_);
+            exit(EXIT_FAILURE);
+        }
     }
-    else if (phase_id_ == 3) {
-        stream_p2_MQ_ = mq;
-        // tool::Logging(my_name_.c_str(), "init the PhaseRecv for Phase3.\n");
+    batch_pool_ = new SyncBufferPool(buf_size, SYNC_BATCH_POOL_SIZE);
+
+    if (sync_config.GetFlowWindow() != 0) {
+        // the recv thread also holds a buffer
+        if (sync_config.GetFlowWindow() >= SYNC_BATCH_POOL_SIZE) {
+            tool::Logging(my_name_.c_str(), "the flow window should be smaller than %u.\n",
+                SYNC_BATCH_POOL_SIZE);
+            exit(EXIT_FAILURE);
+        }
+        // a recycled buffer is a consumed batch
+        batch_pool_->SetReleaseCallback([this]() {
+            this->ReturnCredit(1);
+        });
     }
 
-    gettimeofday(&recv_stime, NULL);
-}
-
-/**
- * @brief Construct a new Phase Recv object
- * 
- * @param recv_channel 
- * @param recv_conn_record 
- * @param p3_mq 
- */
-PhaseRecv::PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_record, 
-    MessageQueue<StreamPhase3MQ_t>* p3_mq, uint8_t phase_id) {
-    recv_channel_ = recv_channel;
-    recv_conn_record_ = recv_conn_record;
-    stream_p3_MQ_ = p3_mq;
-    phase_id_ = phase_id;
-
-    recv_buf_.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + 
-        sizeof(StreamPhase3MQ_t) * sync_config.GetMetaBatchSize());
-    recv_buf_.dataBuffer = recv_buf_.sendBuffer + sizeof(NetworkHead_t);
-    recv_buf_.header = (NetworkHead_t*) recv_buf_.sendBuffer;
-    recv_buf_.header->currentItemNum = 0;
-    recv_buf_.header->dataSize = 0;
-
-    // tool::Logging(my_name_.c_str(), "init the PhaseRecv for Phase4.\n");
-}
-
-/**
- * @brief Construct a new Phase Recv object
- * 
- * @param recv_channel 
- * @param recv_conn_record 
- * @param p4_mq 
- */
-PhaseRecv::PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_record, 
-    MessageQueue<StreamPhase4MQ_t>* p4_mq, uint8_t phase_id) {
-    recv_channel_ = recv_channel;
-    recv_conn_record_ = recv_conn_record;
-    stream_p4_MQ_ = p4_mq;
-    phase_id_ = phase_id;
-
-    recv_buf_.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + 
-        sizeof(StreamPhase4MQ_t) * sync_config.GetDataBatchSize());
-    recv_buf_.dataBuffer = recv_buf_.sendBuffer + sizeof(NetworkHead_t);
-    recv_buf_.header = (NetworkHead_t*) recv_buf_.sendBuffer;
-    recv_buf_.header->currentItemNum = 0;
-    recv_buf_.header->dataSize = 0;
-
-    // tool::Logging(my_name_.c_str(), "init the PhaseRecv for Phase5.\n");
+    if (phase_id_ == 2) {
+        gettimeofday(&recv_stime, NULL);
+    }
 }
 
 /**
@@ -126,7 +108,15 @@ PhaseRecv::PhaseRecv(SSLConnection* recv_channel, pair<int, SSL*> recv_conn_reco
  */
 PhaseRecv::~PhaseRecv() {
     // tool::Logging(my_name_.c_str(), "Phase ID: %ld exit (start clean).\n", phase_id_);
-    free(recv_buf_.sendBuffer);
+    if (batch_pool_ != nullptr) {
+        if (cur_batch_ != nullptr) {
+            batch_pool_->Release(cur_batch_);
+        }
+        delete batch_pool_;
+    }
+    else {
+        free(recv_buf_.sendBuffer);
+    }
     // // tool::Logging(my_name_.c_str(), "Phase ID: %ld exit (free recv buf).\n", phase_id_);
     // tool::Logging(my_name_.c_str(), "Phase ID: %ld exit (clean done).\n", phase_id_);
 }
@@ -137,7 +127,6 @@ PhaseRecv::~PhaseRecv() {
  */
 void PhaseRecv::Run() {
     uint32_t recv_size = 0;
-    string client_ip;
     SSL* client_ssl = recv_conn_record_.second;
 
     // tool::Logging(my_name_.c_str(), "the main thread is running.\n");
@@ -145,42 +134,91 @@ void PhaseRecv::Run() {
     if (phase_id_ == 2) {
         // tool::Logging(my_name_.c_str(), "for Phase-2 (%d).\n", phase_id_);
         while (true) {
+            if (end_flag_) {
+                break;
+            }
             // recv data
             // cout<<"in while "<<recv_conn_record_.first<<endl;
-            if (!recv_channel_->ReceiveData(client_ssl, recv_buf_.sendBuffer, 
-                recv_size)) {
+            if (!this->RecvMsg(client_ssl, recv_size)) {
                 // tool::Logging(my_name_.c_str(), "the other cloud closed socket connect, thread exit now.\n");
-                recv_channel_->GetClientIp(client_ip, client_ssl);
-                recv_channel_->ClearAcceptedClientSd(client_ssl);
+                this->CloseConn(client_ssl);
+                this->LeaveSession();
+                if (this->ResetSession()) {
+                    continue;
+                }
+                break;
+            }
+            if (!this->EnterSession()) {
+                // draining: refuse the next session
                 break;
             }
             switch (recv_buf_.header->messageType) {
                 case SYNC_CHUNK_FP: {
                     // cout<<"sync chunk fp"<<endl;
-                    StreamPhase1MQ_t tmp_entry;
-                    int offset = 0;
-                    for (int i = 0; i < recv_buf_.header->currentItemNum; i++) {
-                        memcpy(tmp_entry.chunkHash, recv_buf_.dataBuffer + offset,
-                            CHUNK_HASH_SIZE);
-                        offset += CHUNK_HASH_SIZE;
-                        tmp_entry.is_file_end = NOT_FILE_END;
-                        stream_p1_MQ_->Push(tmp_entry);
-                        // cout<<"p1 MQ ++"<<endl;
-                    }
+                    this->PushBatch();
+
+                    break;
+                }
+                case SYNC_CHECKPOINT: {
+                    // passed along with the batches of the file
+                    this->PushBatch();
 
                     break;
                 }
                 case FILE_END_CHUNK_FP: {
-                    StreamPhase1MQ_t tmp_entry;
-                    tmp_entry.is_file_end = FILE_END;
-                    stream_p1_MQ_->Push(tmp_entry);
+                    this->PushFileEnd();
                     // tool::Logging(my_name_.c_str(), "phase-%d recv file end chunk fp.\n", phase_id_);
 
+                    // the next file comes in current connection
+                    break;
+                }
+                case SYNC_FILE_START: {
+                    string file_name((char*)recv_buf_.dataBuffer, recv_buf_.header->dataSize);
+                    tool::Logging(my_name_.c_str(), "phase-%d start to sync file %s (id %u).\n", 
+                        phase_id_, file_name.c_str(), recv_buf_.header->clientID);
+
+                    gettimeofday(&recv_stime, NULL);
+                    {
+                        std::lock_guard<std::mutex> lck(file_stime_mutex);
+                        file_stime_list[recv_buf_.header->clientID] = recv_stime;
+                    }
+
+                    break;
+                }
+                case SYNC_FILE_END: {
+                    // no more files in this session, close the phase-2 -> phase-3 
+                    // connection as well
+                    phase_sender_obj_->FileEnd();
                     is_first_file = false;
+                    this->LeaveSession();
+                    if (is_one_session_) {
+                        end_flag_ = true;
+                        break;
+                    }
+
+                    // listen for the next session
+                    this->CloseConn(client_ssl);
+                    this->NextConn(client_ssl);
+
+                    break;
+                }
+                case SYNC_RECIPE_LIST: {
+                    // the recipes of the other cloud, the buffer is reused
+                    const uint32_t name_size = CHUNK_HASH_SIZE * 2;
+                    std::lock_guard<std::mutex> lck(file_done_mutex_);
+                    for (uint32_t i = 0; i < recv_buf_.header->currentItemNum; i++) {
+                        peer_recipe_list_.push_back(string((char*)recv_buf_.dataBuffer + 
+                            i * name_size, name_size));
+                    }
 
-                    // listen for the next connection
-                    recv_conn_record_ = recv_channel_->ListenSSL();
-                    client_ssl = recv_conn_record_.second;
+                    break;
+                }
+                case SYNC_RECIPE_LIST_END: {
+                    {
+                        std::lock_guard<std::mutex> lck(file_done_mutex_);
+                        is_peer_list_done_ = true;
+                    }
+                    file_done_cond_.notify_all();
 
                     break;
                 }
@@ -190,8 +228,6 @@ void PhaseRecv::Run() {
                     // instead, send login msg from outside
                     tool::Logging(my_name_.c_str(), "phase-%d recv login msg.\n", phase_id_);
 
-                    gettimeofday(&recv_stime, NULL);
-
                     // cout<<"bool "<<is_first_file<<endl;
                     if (!is_first_file) {
                         // cout<<"before phase2 sender conn"<<endl;
@@ -218,39 +254,47 @@ void PhaseRecv::Run() {
                 break;
             }
             // recv data
-            if (!recv_channel_->ReceiveData(client_ssl, recv_buf_.sendBuffer, 
-                recv_size)) {
+            if (!this->RecvMsg(client_ssl, recv_size)) {
                 // tool::Logging(my_name_.c_str(), "the other cloud closed socket connect, thread exit now.\n");
-                recv_channel_->GetClientIp(client_ip, client_ssl);
-                recv_channel_->ClearAcceptedClientSd(client_ssl);
+                this->CloseConn(client_ssl);
                 break;
             }
             switch (recv_buf_.header->messageType) {
                 case SYNC_UNI_CHUNK_FP: {
                     // cout<<"sync uni chunk fp"<<endl;
                     // tool::Logging(my_name_.c_str(), "phase-%d recv uni chunk fp.\n", phase_id_);
-                    StreamPhase2MQ_t tmp_entry;
-                    int offset = 0;
-                    for (int i = 0; i < recv_buf_.header->currentItemNum; i++) {
-                        memcpy(tmp_entry.chunkHash, recv_buf_.dataBuffer + offset,
-                            CHUNK_HASH_SIZE);
-                        offset += CHUNK_HASH_SIZE;
-                        tmp_entry.is_file_end = NOT_FILE_END;
-                        stream_p2_MQ_->Push(tmp_entry);
-                        // cout<<"p2 MQ ++"<<endl;
-                    }
+                    this->PushBatch();
+
+                    break;
+                }
+                case SYNC_CHECKPOINT: {
+                    this->PushBatch();
 
                     break;
                 }
                 case FILE_END_UNI_CHUNK_FP: {
-                    StreamPhase2MQ_t tmp_entry;
-                    tmp_entry.is_file_end = FILE_END;
-                    stream_p2_MQ_->Push(tmp_entry);
+                    this->PushFileEnd();
                     // tool::Logging(my_name_.c_str(), "phase-%d recv file end uni chunk fp.\n", phase_id_);
+
+                    break;
+                }
+                case SYNC_FILE_END: {
+                    // dest has closed the session
                     end_flag_ = true;
 
                     break;
                 }
+                case SYNC_STOP: {
+                    // dest is draining: stop issuing files, the files in the 
+                    // pipeline go on
+                    tool::Logging(my_name_.c_str(), "phase-%d recv the stop request of dest.\n", 
+                        phase_id_);
+                    if (stop_flag_ != nullptr) {
+                        *stop_flag_ = 1;
+                    }
+
+                    break;
+                }
                 case SYNC_LOGIN: {
                     // let the sender sends the login msg
                     // but this requires the send socket being used in two threads, not allowed.
@@ -271,50 +315,57 @@ void PhaseRecv::Run() {
     if (phase_id_ == 4) {
         // tool::Logging(my_name_.c_str(), "for Phase-4 (%d).\n", phase_id_);
         while (true) {
+            if (end_flag_) {
+                break;
+            }
             // recv data
-            if (!recv_channel_->ReceiveData(client_ssl, recv_buf_.sendBuffer, 
-                recv_size)) {
+            if (!this->RecvMsg(client_ssl, recv_size)) {
                 // tool::Logging(my_name_.c_str(), "the other cloud closed socket connect, thread exit now.\n");
-                recv_channel_->GetClientIp(client_ip, client_ssl);
-                recv_channel_->ClearAcceptedClientSd(client_ssl);
+                this->CloseConn(client_ssl);
+                this->LeaveSession();
+                if (this->ResetSession()) {
+                    continue;
+                }
+                break;
+            }
+            if (!this->EnterSession()) {
+                // draining: refuse the next session
                 break;
             }
             switch (recv_buf_.header->messageType) {
                 case SYNC_FEATURE: {
                     // cout<<"sync feature"<<endl;
-                    StreamPhase3MQ_t tmp_entry;
-                    int offset = 0;
-                    for (int i = 0; i < recv_buf_.header->currentItemNum; i++) {
-                        memcpy((char*)tmp_entry.features, (char*)recv_buf_.dataBuffer + offset,
-                            sizeof(uint64_t) * SUPER_FEATURE_PER_CHUNK);
-                        offset += (sizeof(uint64_t) * SUPER_FEATURE_PER_CHUNK);
-                        memcpy((char*)tmp_entry.chunkHash, (char*)recv_buf_.dataBuffer + offset,
-                            CHUNK_HASH_SIZE);
-                        offset += CHUNK_HASH_SIZE;
-                        tmp_entry.is_file_end = NOT_FILE_END;
-                        stream_p3_MQ_->Push(tmp_entry);
-                        // cout<<"p3 MQ ++"<<endl;
-
-                        // for (size_t j = 0; j < SUPER_FEATURE_PER_CHUNK; j++) {
-                        //     // tool::Logging("check recv feature ", "%d\t", tmp_entry.features[j]);
-                        // }
-                        // tool::PrintBinaryArray(tmp_entry.chunkHash, CHUNK_HASH_SIZE);
-                    }
+                    this->PushBatch();
                     
                     break;
                 }
+                case SYNC_CHECKPOINT: {
+                    this->PushBatch();
+
+                    break;
+                }
                 case FILE_END_FEATURE: {
                     // p7_MQ_->file_done_ = true;
-                    StreamPhase3MQ_t tmp_entry;
-                    tmp_entry.is_file_end = FILE_END;
-                    stream_p3_MQ_->Push(tmp_entry);
+                    this->PushFileEnd();
                     // cout<<"file end feature"<<endl;
 
+                    // the next file comes in current connection
+                    break;
+                }
+                case SYNC_FILE_END: {
+                    // no more files in this session, close the phase-4 -> phase-5
+                    // connection as well
+                    phase_sender_obj_->FileEnd();
                     is_first_file = false;
+                    this->LeaveSession();
+                    if (is_one_session_) {
+                        end_flag_ = true;
+                        break;
+                    }
 
-                    // listen for the next connection
-                    recv_conn_record_ = recv_channel_->ListenSSL();
-                    client_ssl = recv_conn_record_.second;
+                    // listen for the next session
+                    this->CloseConn(client_ssl);
+                    this->NextConn(client_ssl);
 
                     break;
                 }
@@ -348,38 +399,93 @@ void PhaseRecv::Run() {
             }
 
             // recv data
-            if (!recv_channel_->ReceiveData(client_ssl, recv_buf_.sendBuffer, 
-                recv_size)) {
+            if (!this->RecvMsg(client_ssl, recv_size)) {
                 // tool::Logging(my_name_.c_str(), "the other cloud closed socket connect, thread exit now.\n");
-                recv_channel_->GetClientIp(client_ip, client_ssl);
-                recv_channel_->ClearAcceptedClientSd(client_ssl);
+                this->CloseConn(client_ssl);
                 break;
             }
             switch (recv_buf_.header->messageType) {
                 case SYNC_BASE_HASH: {
                     // cout<<"sync basehash"<<endl;
-                    StreamPhase4MQ_t tmp_entry;
-                    int offset = 0;
-                    for (int i = 0; i < recv_buf_.header->currentItemNum; i++) {
-                        // memcpy(tmp_entry.baseHash, recv_buf_.dataBuffer + offset,
-                        //     CHUNK_HASH_SIZE);
-                        // offset += CHUNK_HASH_SIZE;
-                        memcpy(&tmp_entry, recv_buf_.dataBuffer + offset, sizeof(StreamPhase4MQ_t));
-                        offset += sizeof(StreamPhase4MQ_t);
-                        tmp_entry.is_file_end = NOT_FILE_END;
-                        stream_p4_MQ_->Push(tmp_entry);
-                        // cout<<"p4 MQ ++"<<endl;
+                    this->PushBatch();
+
+                    break;
+                }
+                case SYNC_CHECKPOINT: {
+                    this->PushBatch();
+
+                    break;
+                }
+                case SYNC_CHECKPOINT_ACK: {
+                    // dest has made the chunks before the marker durable
+                    if (checkpoint_ != nullptr) {
+                        checkpoint_->Ack(recv_buf_.header->clientID, 
+                            recv_buf_.header->currentItemNum, dest_idx_);
                     }
 
                     break;
                 }
                 case FILE_END_BASE_HASH: {
                     // p8_MQ_->file_done_ = true;
-                    StreamPhase4MQ_t tmp_entry;
-                    tmp_entry.is_file_end = FILE_END;
-                    stream_p4_MQ_->Push(tmp_entry);
+                    this->PushFileEnd();
                     // cout<<"file end base hash"<<endl;
 
+                    // wait for the integrity check result of dest
+
+                    break;
+                }
+                case SYNC_NACK_FP: {
+                    // the chunks fail the integrity check in dest, resend them 
+                    // as non-similar chunks
+                    SyncBatch_t* nack_batch = batch_pool_->Get();
+                    StreamPhase4MQ_t* entry_list = (StreamPhase4MQ_t*)nack_batch->msg_buf.dataBuffer;
+                    uint32_t offset = 0;
+                    for (uint32_t i = 0; i < recv_buf_.header->currentItemNum; i++) {
+                        entry_list[i].sim_tag = NON_SIMILAR_CHUNK;
+                        memcpy(entry_list[i].chunkHash, recv_buf_.dataBuffer + offset,
+                            CHUNK_HASH_SIZE);
+                        offset += CHUNK_HASH_SIZE;
+                        entry_list[i].is_file_end = NOT_FILE_END;
+                    }
+                    nack_batch->msg_buf.header->messageType = SYNC_BASE_HASH;
+                    nack_batch->msg_buf.header->clientID = recv_buf_.header->clientID;
+                    nack_batch->msg_buf.header->currentItemNum = recv_buf_.header->currentItemNum;
+                    nack_batch->msg_buf.header->dataSize = recv_buf_.header->currentItemNum * 
+                        sizeof(StreamPhase4MQ_t);
+
+                    StreamBatchMQ_t tmp_entry;
+                    tmp_entry.batch = nack_batch;
+                    tmp_entry.is_file_end = NOT_FILE_END;
+                    tmp_entry.file_id = recv_buf_.header->clientID;
+                    stream_batch_MQ_->Push(tmp_entry);
+                    resend_chunk_num_[recv_buf_.header->clientID] += recv_buf_.header->currentItemNum;
+
+                    break;
+                }
+                case FILE_END_NACK_FP: {
+                    tool::Logging(my_name_.c_str(), "resend %lu chunks of file %u failing the integrity check.\n",
+                        resend_chunk_num_[recv_buf_.header->clientID], recv_buf_.header->clientID);
+                    resend_chunk_num_.erase(recv_buf_.header->clientID);
+
+                    this->PushFileEnd();
+
+                    break;
+                }
+                case SYNC_NACK_END: {
+                    // dest has checked all the chunks of this file
+                    if (checkpoint_ != nullptr) {
+                        checkpoint_->FileDone(recv_buf_.header->clientID, dest_idx_);
+                    }
+                    {
+                        std::lock_guard<std::mutex> lck(file_done_mutex_);
+                        done_file_num_ ++;
+                    }
+                    file_done_cond_.notify_all();
+
+                    break;
+                }
+                case SYNC_FILE_END: {
+                    // dest has closed the session
                     end_flag_ = true;
 
                     break;
@@ -405,18 +511,34 @@ void PhaseRecv::Run() {
                 }
             }
         }
+
+        // wake up the wait of file done (also when dest closes the connection)
+        {
+            std::lock_guard<std::mutex> lck(file_done_mutex_);
+            end_flag_ = true;
+        }
+        file_done_cond_.notify_all();
     }
 
 
     if (phase_id_ == 6) {
         // tool::Logging(my_name_.c_str(), "for Phase-6 (%d).\n", phase_id_);
         while (true) {
+            if (end_flag_) {
+                break;
+            }
             // recv data
-            if (!recv_channel_->ReceiveData(client_ssl, recv_buf_.sendBuffer, 
-                recv_size)) {
+            if (!this->RecvMsg(client_ssl, recv_size)) {
                 // tool::Logging(my_name_.c_str(), "the other cloud closed socket connect, thread exit now.\n");
-                recv_channel_->GetClientIp(client_ip, client_ssl);
-                recv_channel_->ClearAcceptedClientSd(client_ssl);
+                this->CloseConn(client_ssl);
+                this->LeaveSession();
+                if (this->ResetSession()) {
+                    continue;
+                }
+                break;
+            }
+            if (!this->EnterSession()) {
+                // draining: refuse the next session
                 break;
             }
             switch (recv_buf_.header->messageType) {
@@ -436,11 +558,24 @@ void PhaseRecv::Run() {
                     // sync_data_writer_obj_->ProcessBatch(recv_buf_.dataBuffer, recv_buf_.header->dataSize);
 
                     sync_data_writer_obj_->ProcessOneBatch(recv_buf_.dataBuffer, recv_buf_.header->dataSize);
+                    this->ReturnCredit(1);
 
                     // cout<<"after recv & write"<<endl;
 
                     break;
                 }
+                case SYNC_CHECKPOINT: {
+                    // persist the chunks before the marker, confirm the marker to the 
+                    // source if all of them are written (via the phase-4 channel)
+                    sync_data_writer_obj_->ProcessTailBatch();
+                    if (sync_data_writer_obj_->CheckCheckpoint(recv_buf_.header->clientID)) {
+                        phase_sender_obj_->Checkpoint(SYNC_CHECKPOINT_ACK, 
+                            recv_buf_.header->clientID, recv_buf_.header->currentItemNum);
+                    }
+                    this->ReturnCredit(1);
+
+                    break;
+                }
                 case FILE_END_SYNC_DATA: {
                     // StreamPhase5MQ_t tmp_entry;
                     // tmp_entry.is_file_end = FILE_END;
@@ -451,10 +586,26 @@ void PhaseRecv::Run() {
                     // TODO: deal with the tail of container & update index here
                     sync_data_writer_obj_->ProcessTailBatch();
 
+                    // check the written chunks, ask the source to resend the failed ones
+                    // (the files in the pipeline are checked independently)
+                    uint32_t file_id = recv_buf_.header->clientID;
+                    if (this->SendNack(file_id)) {
+                        // the resent chunks come in current connection
+                        break;
+                    }
+
                     // TODO: print the (per-file) log info here
 
 
                     gettimeofday(&recv_etime, NULL);
+                    {
+                        std::lock_guard<std::mutex> lck(file_stime_mutex);
+                        auto find_it = file_stime_list.find(file_id);
+                        if (find_it != file_stime_list.end()) {
+                            recv_stime = find_it->second;
+                            file_stime_list.erase(find_it);
+                        }
+                    }
 
                     double total_time = tool::GetTimeDiff(recv_stime, recv_etime);
                     cout<<"total time (dest)"<<total_time<<endl;
@@ -500,14 +651,25 @@ void PhaseRecv::Run() {
                     // is_first_file = false;
                     // cout<<"set bool as 0 "<<is_first_file<<endl;
 
-                    // listen for the next connection
-                    recv_conn_record_ = recv_channel_->ListenSSL();
-                    client_ssl = recv_conn_record_.second;
+                    // the next file comes in current connection
 
                     // end_flag_ = true;
 
                     break;
                 }
+                case SYNC_FILE_END: {
+                    this->LeaveSession();
+                    if (is_one_session_) {
+                        end_flag_ = true;
+                        break;
+                    }
+
+                    // no more files in this session, listen for the next session
+                    this->CloseConn(client_ssl);
+                    this->NextConn(client_ssl);
+
+                    break;
+                }
                 case SYNC_LOGIN: {
                     // let the sender sends the login msg
                     // but this requires the send socket being used in two threads, not allowed.
@@ -530,6 +692,348 @@ void PhaseRecv::Run() {
 }
 
 
+/**
+ * @brief check the written chunks of a file, ask the source to resend 
+ * the failed ones (via the phase-4 channel)
+ * 
+ * @param file_id 
+ * @return true if some chunks need to be resent
+ * @return false 
+ */
+bool PhaseRecv::SendNack(uint32_t file_id) {
+    vector<string> fail_fp_list;
+    sync_data_writer_obj_->CheckIntegrity(file_id, fail_fp_list);
+
+    SendMsgBuffer_t nack_buf;
+    nack_buf.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + 
+        CHUNK_HASH_SIZE * sync_config.GetMetaBatchSize());
+    nack_buf.dataBuffer = nack_buf.sendBuffer + sizeof(NetworkHead_t);
+    nack_buf.header = (NetworkHead_t*) nack_buf.sendBuffer;
+    nack_buf.header->currentItemNum = 0;
+    nack_buf.header->dataSize = 0;
+    nack_buf.header->clientID = file_id;
+
+    uint64_t& resend_round = resend_round_[file_id];
+    bool is_resend = false;
+    if (fail_fp_list.size() != 0 && resend_round < sync_config.GetMaxResendRound()) {
+        tool::Logging(my_name_.c_str(), "%lu chunks of file %u fail the integrity check, request to resend (round %lu).\n",
+            fail_fp_list.size(), file_id, resend_round + 1);
+
+        nack_buf.header->messageType = SYNC_NACK_FP;
+        for (auto& fail_fp : fail_fp_list) {
+            memcpy(nack_buf.dataBuffer + nack_buf.header->dataSize, fail_fp.c_str(),
+                CHUNK_HASH_SIZE);
+            nack_buf.header->dataSize += CHUNK_HASH_SIZE;
+            nack_buf.header->currentItemNum ++;
+
+            if (nack_buf.header->currentItemNum == sync_config.GetMetaBatchSize()) {
+                phase_sender_obj_->SendBatch(&nack_buf);
+                nack_buf.header->dataSize = 0;
+                nack_buf.header->currentItemNum = 0;
+            }
+        }
+        if (nack_buf.header->currentItemNum != 0) {
+            phase_sender_obj_->SendBatch(&nack_buf);
+            nack_buf.header->dataSize = 0;
+            nack_buf.header->currentItemNum = 0;
+        }
+
+        // send the end flag of this round
+        nack_buf.header->messageType = FILE_END_NACK_FP;
+        phase_sender_obj_->SendBatch(&nack_buf);
+
+        resend_round ++;
+        is_resend = true;
+    }
+    else {
+        if (fail_fp_list.size() != 0) {
+            tool::Logging(my_name_.c_str(), "%lu chunks of file %u still fail the integrity check after %lu rounds.\n",
+                fail_fp_list.size(), file_id, resend_round);
+            sync_data_writer_obj_->ClearExpectedChunk(file_id);
+        }
+
+        // notify the source that this file is done
+        nack_buf.header->messageType = SYNC_NACK_END;
+        phase_sender_obj_->SendBatch(&nack_buf);
+
+        resend_round_.erase(file_id);
+    }
+
+    free(nack_buf.sendBuffer);
+
+    return is_resend;
+}
+
+/**
+ * @brief wait until the given number of files are done in dest
+ * 
+ * @param file_num 
+ */
+void PhaseRecv::WaitFileDone(uint64_t file_num) {
+    std::unique_lock<std::mutex> lck(file_done_mutex_);
+    file_done_cond_.wait(lck, [this, file_num] {
+        return done_file_num_ >= file_num || end_flag_;
+    });
+
+    return ;
+}
+
+/**
+ * @brief wait for the recipe list of the other cloud (bidirectional sync)
+ * 
+ * @param recipe_list 
+ */
+void PhaseRecv::WaitPeerRecipeList(vector<string>& recipe_list) {
+    std::unique_lock<std::mutex> lck(file_done_mutex_);
+    file_done_cond_.wait(lck, [this] {
+        return is_peer_list_done_ || end_flag_;
+    });
+    recipe_list = peer_recipe_list_;
+
+    return ;
+}
+
+/**
+ * @brief exit at the end of the current session (bidirectional sync)
+ * 
+ */
+void PhaseRecv::SetOneSession() {
+    is_one_session_ = true;
+
+    return ;
+}
+
+/**
+ * @brief refuse the next session (dest side, the first phase of a session)
+ * 
+ */
+void PhaseRecv::Drain() {
+    std::lock_guard<std::mutex> lck(file_done_mutex_);
+    is_draining_ = true;
+
+    return ;
+}
+
+/**
+ * @brief check whether a session is in progress (dest side)
+ * 
+ * @return true 
+ * @return false 
+ */
+bool PhaseRecv::IsInSession() {
+    std::lock_guard<std::mutex> lck(file_done_mutex_);
+    return is_in_session_;
+}
+
+/**
+ * @brief a message of a session arrives (dest side)
+ * 
+ * @return true 
+ * @return false draining, refuse a new session
+ */
+bool PhaseRecv::EnterSession() {
+    std::lock_guard<std::mutex> lck(file_done_mutex_);
+    if (is_draining_ && !is_in_session_) {
+        return false;
+    }
+    is_in_session_ = true;
+
+    return true;
+}
+
+/**
+ * @brief the session ends (dest side)
+ * 
+ */
+void PhaseRecv::LeaveSession() {
+    std::lock_guard<std::mutex> lck(file_done_mutex_);
+    is_in_session_ = false;
+
+    return ;
+}
+
+/**
+ * @brief check whether a failed recv is the end of a broken session 
+ * on the shared transport (dest side), then drop its state
+ * 
+ * @return true wait for the next session
+ * @return false the transport is closed
+ */
+bool PhaseRecv::ResetSession() {
+    if (transport_ == nullptr || transport_->IsClosed()) {
+        return false;
+    }
+
+    // the source restarts the unfinished files from the checkpoint
+    resend_round_.clear();
+    resend_chunk_num_.clear();
+
+    return true;
+}
+
+/**
+ * @brief Get the number of files done in dest
+ * 
+ * @return uint64_t 
+ */
+uint64_t PhaseRecv::GetDoneFileNum() {
+    std::lock_guard<std::mutex> lck(file_done_mutex_);
+    return done_file_num_;
+}
+
+/**
+ * @brief recv a message of this phase
+ * 
+ * @param client_ssl 
+ * @param recv_size 
+ * @return true 
+ * @return false the connection is closed
+ */
+bool PhaseRecv::RecvMsg(SSL* client_ssl, uint32_t& recv_size) {
+    if (batch_pool_ != nullptr && cur_batch_ == nullptr) {
+        // recv into a new buffer of the pool
+        cur_batch_ = batch_pool_->Get();
+        recv_buf_ = cur_batch_->msg_buf;
+    }
+
+    if (transport_ != nullptr) {
+        return transport_->RecvFrame(phase_id_, recv_buf_.sendBuffer, recv_size);
+    }
+
+    if (sync_config.GetFlowWindow() != 0) {
+        // return the credits while waiting, the sender may be waiting for them
+        while (true) {
+            this->SendPendingCredit(client_ssl);
+            if (SSL_pending(client_ssl) != 0) {
+                break;
+            }
+
+            struct pollfd poll_fd;
+            poll_fd.fd = SSL_get_fd(client_ssl);
+            poll_fd.events = POLLIN;
+            poll_fd.revents = 0;
+            if (poll(&poll_fd, 1, FLOW_CREDIT_POLL_MS) != 0) {
+                break;
+            }
+        }
+    }
+
+    return recv_channel_->ReceiveData(client_ssl, recv_buf_.sendBuffer, recv_size);
+}
+
+/**
+ * @brief return the credits of the consumed batches to the sender
+ * 
+ * @param credit_num 
+ */
+void PhaseRecv::ReturnCredit(uint32_t credit_num) {
+    if (sync_config.GetFlowWindow() == 0) {
+        return ;
+    }
+
+    if (transport_ != nullptr) {
+        // the messages of phase-i come from phase-(i-1) of the other cloud
+        transport_->SendCredit(phase_id_ - 1, credit_num);
+        return ;
+    }
+
+    // only the recv thread writes to the dedicated connection
+    pending_credit_num_ += credit_num;
+
+    return ;
+}
+
+/**
+ * @brief send the pending credits over the dedicated connection
+ * 
+ * @param client_ssl 
+ */
+void PhaseRecv::SendPendingCredit(SSL* client_ssl) {
+    uint64_t credit_num = pending_credit_num_.exchange(0);
+    if (credit_num == 0) {
+        return ;
+    }
+
+    NetworkHead_t credit_msg;
+    credit_msg.messageType = SYNC_CREDIT;
+    credit_msg.dataSize = 0;
+    credit_msg.currentItemNum = credit_num;
+    if (!recv_channel_->SendData(client_ssl, (uint8_t*)&credit_msg, sizeof(NetworkHead_t))) {
+        // the sender has closed the connection, the recv fails as well
+        tool::Logging(my_name_.c_str(), "phase-%d send the credits error.\n", phase_id_);
+    }
+
+    return ;
+}
+
+/**
+ * @brief clear the closed connection
+ * 
+ * @param client_ssl 
+ */
+void PhaseRecv::CloseConn(SSL* client_ssl) {
+    if (transport_ != nullptr) {
+        // the shared connection is cleared by the transport
+        return ;
+    }
+
+    string client_ip;
+    recv_channel_->GetClientIp(client_ip, client_ssl);
+    recv_channel_->ClearAcceptedClientSd(client_ssl);
+
+    return ;
+}
+
+/**
+ * @brief wait for the connection of the next file
+ * 
+ * @param client_ssl 
+ */
+void PhaseRecv::NextConn(SSL*& client_ssl) {
+    if (transport_ != nullptr) {
+        // the transport accepts the next sync session by itself
+        return ;
+    }
+
+    recv_conn_record_ = recv_channel_->ListenSSL();
+    client_ssl = recv_conn_record_.second;
+    // the sender resets its credits in the new session
+    pending_credit_num_ = 0;
+
+    return ;
+}
+
+/**
+ * @brief hand over the current recv buffer to the phase thread
+ * 
+ */
+void PhaseRecv::PushBatch() {
+    StreamBatchMQ_t tmp_entry;
+    tmp_entry.batch = cur_batch_;
+    tmp_entry.is_file_end = NOT_FILE_END;
+    tmp_entry.file_id = recv_buf_.header->clientID;
+    stream_batch_MQ_->Push(tmp_entry);
+
+    // the phase thread releases it after processing
+    cur_batch_ = nullptr;
+
+    return ;
+}
+
+/**
+ * @brief notify the phase thread of the file end
+ * 
+ */
+void PhaseRecv::PushFileEnd() {
+    StreamBatchMQ_t tmp_entry;
+    tmp_entry.batch = nullptr;
+    tmp_entry.is_file_end = FILE_END;
+    tmp_entry.file_id = recv_buf_.header->clientID;
+    stream_batch_MQ_->Push(tmp_entry);
+
+    return ;
+}
+
 /**
  * @brief Set the Sync Data Writer object
  * 
@@ -23,15 +23,48 @@ PhaseSender::PhaseSender(SSLConnection* send_channel, pair<int, SSL*> send_conn_
     send_conn_record_ = send_conn_record;
     phase_id_ = phase_id;
 
+    // for batching the small messages
+    send_buf_size_ = sync_config.GetSendBufSize();
+    if (send_buf_size_ != 0) {
+        send_buf_ = (uint8_t*) malloc(send_buf_size_);
+    }
+
+    if (sync_config.GetFlowWindow() != 0) {
+        flow_credit_ = new FlowCredit(sync_config.GetFlowWindow());
+    }
+
     // tool::Logging(my_name_.c_str(), "init the PhaseSender for Phase%d.\n", phase_id_);
 }
 
+/**
+ * @brief Construct a new Phase Sender object over the shared transport
+ * 
+ * @param transport 
+ * @param phase_id 
+ */
+PhaseSender::PhaseSender(SyncTransport* transport, uint8_t phase_id) {
+    send_channel_ = nullptr;
+    transport_ = transport;
+    phase_id_ = phase_id;
+
+    if (sync_config.GetFlowWindow() != 0) {
+        // the credits come back via the transport
+        flow_credit_ = new FlowCredit(sync_config.GetFlowWindow());
+        transport_->SetFlowCredit(phase_id_, flow_credit_);
+    }
+}
+
 /**
  * @brief Destroy the Phase Sender object
  * 
  */
 PhaseSender::~PhaseSender() {
-    ;
+    if (send_buf_ != nullptr) {
+        free(send_buf_);
+    }
+    if (flow_credit_ != nullptr) {
+        delete flow_credit_;
+    }
 }
 
 /**
@@ -50,8 +83,8 @@ void PhaseSender::SyncLogin() {
     login_msg.header->currentItemNum = 0;
 
     // send the login header
-    if (!send_channel_->SendData(send_conn_record_.second,
-        login_msg.sendBuffer, sizeof(NetworkHead_t) + login_msg.header->dataSize)) {
+    if (!this->SendMsg(login_msg.sendBuffer, 
+        sizeof(NetworkHead_t) + login_msg.header->dataSize)) {
         // tool::Logging(my_name_.c_str(), "send the sync login error.\n");
         exit(EXIT_FAILURE);
     }
@@ -74,8 +107,8 @@ void PhaseSender::LoginResponse() {
     login_msg.header->currentItemNum = 0;
 
     // send the login header
-    if (!send_channel_->SendData(send_conn_record_.second,
-        login_msg.sendBuffer, sizeof(NetworkHead_t) + login_msg.header->dataSize)) {
+    if (!this->SendMsg(login_msg.sendBuffer, 
+        sizeof(NetworkHead_t) + login_msg.header->dataSize)) {
         // tool::Logging(my_name_.c_str(), "send the sync login error.\n");
         exit(EXIT_FAILURE);
     }
@@ -94,7 +127,7 @@ void PhaseSender::SendBatch(SendMsgBuffer_t* send_msg_buf) {
     // if(phase_id_ == 5)
         // cout<<"before sent "<<send_msg_buf->header->dataSize<<endl;
 
-    if (!send_channel_->SendData(send_conn_record_.second, send_msg_buf->sendBuffer,
+    if (!this->SendMsg(send_msg_buf->sendBuffer,
         sizeof(NetworkHead_t) + send_msg_buf->header->dataSize)) {
         // tool::Logging(my_name_.c_str(), "send batch error.\n");
         exit(EXIT_FAILURE);
@@ -111,7 +144,290 @@ void PhaseSender::SendBatch(SendMsgBuffer_t* send_msg_buf) {
  * 
  */
 void PhaseSender::LoginConnect() {
+    // a new session: the recv phase holds no batch of this sender
+    if (flow_credit_ != nullptr) {
+        flow_credit_->Reset();
+    }
+
+    if (transport_ != nullptr) {
+        // the shared transport is kept by the source across files
+        return ;
+    }
+
     send_conn_record_ = send_channel_->ConnectSSL();
+    send_buf_offset_ = 0;
+
+    return ;
+}
+
+/**
+ * @brief notify the start of a file on the (persistent) connection
+ * 
+ * @param file_name 
+ * @param file_id the id carried by all the batches of the file
+ */
+void PhaseSender::FileStart(string& file_name, uint32_t file_id) {
+    SendMsgBuffer_t start_msg;
+    start_msg.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + file_name.size());
+    start_msg.header = (NetworkHead_t*) start_msg.sendBuffer;
+    start_msg.dataBuffer = start_msg.sendBuffer + sizeof(NetworkHead_t);
+    start_msg.header->messageType = SYNC_FILE_START;
+    start_msg.header->clientID = file_id;
+    start_msg.header->dataSize = file_name.size();
+    start_msg.header->currentItemNum = 0;
+    memcpy(start_msg.dataBuffer, file_name.c_str(), file_name.size());
+
+    if (!this->SendMsg(start_msg.sendBuffer, 
+        sizeof(NetworkHead_t) + start_msg.header->dataSize)) {
+        tool::Logging(my_name_.c_str(), "send the file start error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    free(start_msg.sendBuffer);
+    return ;
+}
+
+/**
+ * @brief send a checkpoint marker of a file (or its ack from dest)
+ * 
+ * @param message_type SYNC_CHECKPOINT / SYNC_CHECKPOINT_ACK
+ * @param file_id 
+ * @param entry_offset the recipe entries before the marker
+ */
+void PhaseSender::Checkpoint(int message_type, uint32_t file_id, uint32_t entry_offset) {
+    NetworkHead_t checkpoint_msg;
+    checkpoint_msg.messageType = message_type;
+    checkpoint_msg.clientID = file_id;
+    checkpoint_msg.dataSize = 0;
+    checkpoint_msg.currentItemNum = entry_offset;
+
+    if (!this->SendMsg((uint8_t*)&checkpoint_msg, sizeof(NetworkHead_t))) {
+        tool::Logging(my_name_.c_str(), "send the checkpoint error.\n");
+        exit(EXIT_FAILURE);
+    }
 
     return ;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief send the local recipe names to the other cloud (bidirectional sync)
+ * 
+ * @param recipe_list 
+ */
+void PhaseSender::RecipeList(vector<string>& recipe_list) {
+    // in the batches of the chunk fps (a recipe name is the hex of its hash)
+    const uint32_t name_size = CHUNK_HASH_SIZE * 2;
+    uint64_t batch_num = sync_config.GetMetaBatchSize() * CHUNK_HASH_SIZE / name_size;
+    SendMsgBuffer_t list_msg;
+    list_msg.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + batch_num * name_size);
+    list_msg.header = (NetworkHead_t*) list_msg.sendBuffer;
+    list_msg.dataBuffer = list_msg.sendBuffer + sizeof(NetworkHead_t);
+    list_msg.header->clientID = 0;
+
+    for (size_t i = 0; i < recipe_list.size(); i += batch_num) {
+        uint32_t cur_num = min((uint64_t)(recipe_list.size() - i), batch_num);
+        for (uint32_t j = 0; j < cur_num; j++) {
+            memcpy(list_msg.dataBuffer + j * name_size, recipe_list[i + j].c_str(), name_size);
+        }
+        list_msg.header->messageType = SYNC_RECIPE_LIST;
+        list_msg.header->currentItemNum = cur_num;
+        list_msg.header->dataSize = cur_num * name_size;
+        this->SendBatch(&list_msg);
+    }
+
+    list_msg.header->messageType = SYNC_RECIPE_LIST_END;
+    list_msg.header->currentItemNum = 0;
+    list_msg.header->dataSize = 0;
+    this->SendBatch(&list_msg);
+
+    free(list_msg.sendBuffer);
+    return ;
+}
+
+/**
+ * @brief notify no more files on the connection (end of the sync session)
+ * 
+ */
+void PhaseSender::FileEnd() {
+    NetworkHead_t end_msg;
+    end_msg.messageType = SYNC_FILE_END;
+    end_msg.dataSize = 0;
+    end_msg.currentItemNum = 0;
+
+    if (!this->SendMsg((uint8_t*)&end_msg, sizeof(NetworkHead_t))) {
+        tool::Logging(my_name_.c_str(), "send the file end error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return ;
+}
+
+/**
+ * @brief ask the source to stop issuing files (graceful stop of the dest)
+ * 
+ * @return true 
+ * @return false the session has ended
+ */
+bool PhaseSender::StopRequest() {
+    NetworkHead_t stop_msg;
+    stop_msg.messageType = SYNC_STOP;
+    stop_msg.dataSize = 0;
+    stop_msg.currentItemNum = 0;
+
+    return this->SendMsg((uint8_t*)&stop_msg, sizeof(NetworkHead_t));
+}
+
+/**
+ * @brief send a message to the recv phase of the other cloud
+ * 
+ * @param data 
+ * @param size 
+ * @return true 
+ * @return false 
+ */
+bool PhaseSender::SendMsg(uint8_t* data, uint32_t size) {
+    NetworkHead_t* msg_header = (NetworkHead_t*) data;
+    if (flow_credit_ != nullptr) {
+        switch (msg_header->messageType) {
+            case SYNC_CHUNK_FP:
+            case SYNC_UNI_CHUNK_FP:
+            case SYNC_FEATURE:
+            case SYNC_BASE_HASH:
+            case SYNC_DATA:
+            case SYNC_CHECKPOINT: {
+                // the batch occupies a recv buffer of the recv phase
+                this->AcquireCredit();
+                break;
+            }
+            case SYNC_NACK_FP: {
+                // not gated: the phase-6 thread must keep reading while phase-5 
+                // sends the next files to it, the nack batches take the spare 
+                // buffers of the phase-5 pool (the extra credits are clamped)
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    if (rate_limiter_ != nullptr) {
+        rate_limiter_->Acquire(phase_id_, sizeof(uint32_t) + size);
+    }
+
+    std::lock_guard<std::mutex> lck(send_mutex_);
+    if (transport_ != nullptr) {
+        // the messages of phase-i are handled by phase-(i+1) of the other cloud
+        transport_->SendFrame(phase_id_ + 1, data, size);
+        return true;
+    }
+
+    uint32_t msg_size = sizeof(uint32_t) + size;
+    if (msg_header->dataSize != 0 && send_buf_offset_ + msg_size <= send_buf_size_) {
+        // a small batch: wait for the following messages (same wire format as SendData)
+        memcpy(send_buf_ + send_buf_offset_, &size, sizeof(uint32_t));
+        memcpy(send_buf_ + send_buf_offset_ + sizeof(uint32_t), data, size);
+        send_buf_offset_ += msg_size;
+        return true;
+    }
+
+    // a large batch or a control message (the other cloud may wait for it): send 
+    // it together with the buffered messages
+    struct iovec iov[3];
+    iov[0].iov_base = send_buf_;
+    iov[0].iov_len = send_buf_offset_;
+    iov[1].iov_base = &size;
+    iov[1].iov_len = sizeof(uint32_t);
+    iov[2].iov_base = data;
+    iov[2].iov_len = size;
+    send_buf_offset_ = 0;
+
+    return send_channel_->WriteDataV(send_conn_record_.second, iov, 3);
+}
+/**
+ * @brief take a credit before sending a batch, wait for the recv phase 
+ * if none left
+ * 
+ */
+void PhaseSender::AcquireCredit() {
+    if (transport_ != nullptr) {
+        // the transport grants the credits
+        flow_credit_->Acquire();
+        return ;
+    }
+
+    while (!flow_credit_->TryAcquire()) {
+        std::lock_guard<std::mutex> credit_lck(credit_mutex_);
+        if (flow_credit_->TryAcquire()) {
+            // granted while waiting for the lock
+            break;
+        }
+
+        {
+            // the recv phase may wait for the buffered batches
+            std::lock_guard<std::mutex> lck(send_mutex_);
+            this->FlushSendBuf();
+        }
+
+        // wait for the credits without blocking the other writers, the SSL 
+        // object is only touched under the send lock
+        SSL* send_ssl = send_conn_record_.second;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lck(send_mutex_);
+                if (SSL_pending(send_ssl) != 0) {
+                    break;
+                }
+            }
+            struct pollfd poll_fd;
+            poll_fd.fd = SSL_get_fd(send_ssl);
+            poll_fd.events = POLLIN;
+            poll_fd.revents = 0;
+            if (poll(&poll_fd, 1, FLOW_CREDIT_POLL_MS) > 0) {
+                break;
+            }
+        }
+
+        // the credits come back in the reverse direction of the connection
+        NetworkHead_t credit_msg;
+        uint32_t recv_size = 0;
+        bool is_recv = false;
+        {
+            std::lock_guard<std::mutex> lck(send_mutex_);
+            is_recv = send_channel_->ReceiveData(send_ssl, (uint8_t*)&credit_msg, recv_size);
+        }
+        if (!is_recv) {
+            tool::Logging(my_name_.c_str(), "recv the credits error.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (credit_msg.messageType != SYNC_CREDIT) {
+            tool::Logging(my_name_.c_str(), "unknown message type %d in Phase-%d sender.\n",
+                credit_msg.messageType, phase_id_);
+            exit(EXIT_FAILURE);
+        }
+        flow_credit_->Grant(credit_msg.currentItemNum);
+    }
+
+    return ;
+}
+
+/**
+ * @brief send out the buffered small messages
+ * 
+ */
+void PhaseSender::FlushSendBuf() {
+    if (send_buf_offset_ == 0) {
+        return ;
+    }
+
+    struct iovec iov;
+    iov.iov_base = send_buf_;
+    iov.iov_len = send_buf_offset_;
+    send_buf_offset_ = 0;
+    if (!send_channel_->WriteDataV(send_conn_record_.second, &iov, 1)) {
+        tool::Logging(my_name_.c_str(), "flush the send buffer error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return ;
+}
@@ -0,0 +1,293 @@
+/**
+ * @file recipe_reader.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in recipe_reader.h
+ * @version 0.1
+ * @date 2024-09-11
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/recipe_reader.h"
+
+/**
+ * @brief Construct a new Recipe Reader object
+ *
+ */
+RecipeReader::RecipeReader() {
+    block_size_ = sync_config.GetRecipeReadSize();
+    is_direct_io_ = sync_config.IsRecipeDirectIO();
+
+    for (uint32_t i = 0; i < 3; i++) {
+        // aligned for O_DIRECT
+        if (posix_memalign((void**)&block_buf_[i], RECIPE_IO_ALIGN, block_size_) != 0) {
+            tool::Logging(my_name_.c_str(), "fail to allocate the block buffer.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * @brief Destroy the Recipe Reader object
+ *
+ */
+RecipeReader::~RecipeReader() {
+    this->Close();
+    this->DropPrefetch();
+
+    for (uint32_t i = 0; i < 3; i++) {
+        free(block_buf_[i]);
+    }
+}
+
+/**
+ * @brief open a recipe file (fall back to the buffered I/O if O_DIRECT
+ * is not supported)
+ *
+ * @param recipe_path
+ * @return int the fd (-1: fail)
+ */
+int RecipeReader::OpenFile(string& recipe_path) {
+    int flags = O_RDONLY;
+    if (is_direct_io_) {
+        flags |= O_DIRECT;
+    }
+
+    int fd = open(recipe_path.c_str(), flags);
+    if (fd < 0 && is_direct_io_ && errno == EINVAL) {
+        // e.g., tmpfs
+        tool::Logging(my_name_.c_str(), "O_DIRECT is not supported for %s, use the buffered read.\n",
+            recipe_path.c_str());
+        is_direct_io_ = false;
+        fd = open(recipe_path.c_str(), O_RDONLY);
+    }
+    if (fd >= 0 && !is_direct_io_) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief read a block in the background
+ *
+ * @param fd
+ * @param buf
+ * @param offset
+ * @return std::future<ssize_t>
+ */
+std::future<ssize_t> RecipeReader::ReadBlockAsync(int fd, uint8_t* buf, uint64_t offset) {
+    uint64_t block_size = block_size_;
+    bool is_direct_io = is_direct_io_;
+
+    return std::async(std::launch::async, [fd, buf, offset, block_size, is_direct_io]() -> ssize_t {
+        size_t total_len = 0;
+        while (total_len < block_size) {
+            ssize_t ret = pread(fd, buf + total_len, block_size - total_len, offset + total_len);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            if (ret == 0) {
+                break;
+            }
+            total_len += ret;
+            if (is_direct_io && total_len % RECIPE_IO_ALIGN != 0) {
+                // the unaligned tail of the file
+                break;
+            }
+        }
+        return total_len;
+    });
+}
+
+/**
+ * @brief wait for a background read
+ *
+ * @param block_read
+ * @return size_t the read size
+ */
+size_t RecipeReader::WaitBlock(std::future<ssize_t>& block_read) {
+    ssize_t ret = block_read.get();
+    if (ret < 0) {
+        tool::Logging(my_name_.c_str(), "read recipe error: %s.\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief drop the prefetched recipe
+ *
+ */
+void RecipeReader::DropPrefetch() {
+    if (prefetch_fd_ < 0) {
+        return ;
+    }
+
+    if (prefetch_read_.valid()) {
+        prefetch_read_.get();
+    }
+    if (!is_direct_io_) {
+        posix_fadvise(prefetch_fd_, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    close(prefetch_fd_);
+    prefetch_fd_ = -1;
+    prefetch_path_.clear();
+
+    return ;
+}
+
+/**
+ * @brief start to read the first block of the next recipe
+ *
+ * @param recipe_path
+ */
+void RecipeReader::Prefetch(string& recipe_path) {
+    if (prefetch_fd_ >= 0) {
+        if (prefetch_path_ == recipe_path) {
+            return ;
+        }
+        this->DropPrefetch();
+    }
+
+    prefetch_fd_ = this->OpenFile(recipe_path);
+    if (prefetch_fd_ < 0) {
+        // reported when it is opened
+        return ;
+    }
+    prefetch_path_ = recipe_path;
+    prefetch_read_ = this->ReadBlockAsync(prefetch_fd_, block_buf_[prefetch_idx_], 0);
+
+    return ;
+}
+
+/**
+ * @brief open a recipe (use the prefetched block if any)
+ *
+ * @param recipe_path
+ * @return true
+ * @return false fail to open
+ */
+bool RecipeReader::Open(string& recipe_path) {
+    this->Close();
+
+    if (prefetch_fd_ >= 0 && prefetch_path_ == recipe_path) {
+        // the first block has been read (or is being read)
+        fd_ = prefetch_fd_;
+        prefetch_fd_ = -1;
+        prefetch_path_.clear();
+        cur_block_len_ = this->WaitBlock(prefetch_read_);
+        std::swap(cur_idx_, prefetch_idx_);
+    }
+    else {
+        this->DropPrefetch();
+        fd_ = this->OpenFile(recipe_path);
+        if (fd_ < 0) {
+            return false;
+        }
+        std::future<ssize_t> first_read = this->ReadBlockAsync(fd_, block_buf_[cur_idx_], 0);
+        cur_block_len_ = this->WaitBlock(first_read);
+    }
+    cur_block_off_ = 0;
+    cur_pos_ = 0;
+
+    if (cur_block_len_ == block_size_) {
+        ahead_read_ = this->ReadBlockAsync(fd_, block_buf_[ahead_idx_], block_size_);
+    }
+
+    return true;
+}
+
+/**
+ * @brief move to the given offset of the recipe
+ *
+ * @param offset
+ */
+void RecipeReader::Seek(uint64_t offset) {
+    if (offset >= cur_block_off_ && offset <= cur_block_off_ + cur_block_len_) {
+        cur_pos_ = offset - cur_block_off_;
+        return ;
+    }
+
+    // re-read from the block of the offset
+    if (ahead_read_.valid()) {
+        this->WaitBlock(ahead_read_);
+    }
+    cur_block_off_ = offset / block_size_ * block_size_;
+    std::future<ssize_t> block_read = this->ReadBlockAsync(fd_, block_buf_[cur_idx_], cur_block_off_);
+    cur_block_len_ = this->WaitBlock(block_read);
+    cur_pos_ = min(offset - cur_block_off_, (uint64_t)cur_block_len_);
+
+    if (cur_block_len_ == block_size_) {
+        ahead_read_ = this->ReadBlockAsync(fd_, block_buf_[ahead_idx_], cur_block_off_ + block_size_);
+    }
+
+    return ;
+}
+
+/**
+ * @brief read the recipe into the buffer
+ *
+ * @param buf
+ * @param len
+ * @return size_t the read size (less than len at the recipe end)
+ */
+size_t RecipeReader::Read(uint8_t* buf, size_t len) {
+    size_t read_len = 0;
+    while (read_len < len) {
+        if (cur_pos_ == cur_block_len_) {
+            if (!ahead_read_.valid()) {
+                // the last block has been consumed
+                break;
+            }
+
+            // move to the next block, and read the one after it
+            cur_block_len_ = this->WaitBlock(ahead_read_);
+            std::swap(cur_idx_, ahead_idx_);
+            cur_block_off_ += block_size_;
+            cur_pos_ = 0;
+            if (cur_block_len_ == block_size_) {
+                ahead_read_ = this->ReadBlockAsync(fd_, block_buf_[ahead_idx_],
+                    cur_block_off_ + block_size_);
+            }
+            continue;
+        }
+
+        size_t copy_len = min(len - read_len, cur_block_len_ - cur_pos_);
+        memcpy(buf + read_len, block_buf_[cur_idx_] + cur_pos_, copy_len);
+        read_len += copy_len;
+        cur_pos_ += copy_len;
+    }
+
+    return read_len;
+}
+
+/**
+ * @brief close the current recipe
+ *
+ */
+void RecipeReader::Close() {
+    if (fd_ < 0) {
+        return ;
+    }
+
+    if (ahead_read_.valid()) {
+        ahead_read_.get();
+    }
+    if (!is_direct_io_) {
+        // the recipe is read once, do not keep it in the page cache
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    close(fd_);
+    fd_ = -1;
+    cur_block_off_ = 0;
+    cur_block_len_ = 0;
+    cur_pos_ = 0;
+
+    return ;
+}
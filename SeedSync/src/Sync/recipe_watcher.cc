@@ -0,0 +1,191 @@
+/**
+ * @file recipe_watcher.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in recipe_watcher.h
+ * @version 0.1
+ * @date 2024-09-16
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/recipe_watcher.h"
+
+extern Configure config;
+
+/**
+ * @brief Construct a new Recipe Watcher object
+ *
+ * @param recipe_root_path
+ */
+RecipeWatcher::RecipeWatcher(string recipe_root_path) {
+    recipe_root_path_ = recipe_root_path;
+    recipe_suffix_ = config.GetRecipeSuffix();
+    settle_ms_ = sync_config.GetDaemonSettleTime();
+    event_buf_ = (uint8_t*) malloc(DAEMON_EVENT_BUF_SIZE);
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        tool::Logging(my_name_.c_str(), "fail to init inotify: %s.\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (inotify_add_watch(inotify_fd_, recipe_root_path_.c_str(), 
+        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        tool::Logging(my_name_.c_str(), "fail to watch %s: %s.\n", recipe_root_path_.c_str(),
+            strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Destroy the Recipe Watcher object
+ *
+ */
+RecipeWatcher::~RecipeWatcher() {
+    close(inotify_fd_);
+    free(event_buf_);
+}
+
+/**
+ * @brief Set the Stop Flag object
+ *
+ * @param stop_flag
+ */
+void RecipeWatcher::SetStopFlag(volatile sig_atomic_t* stop_flag) {
+    stop_flag_ = stop_flag;
+
+    return ;
+}
+
+/**
+ * @brief wait for the events, and check the stop flag meanwhile
+ *
+ * @param timeout_ms -1: until an event or the stop
+ * @return int the poll result (-1: error or stop)
+ */
+int RecipeWatcher::PollEvents(int timeout_ms) {
+    struct pollfd poll_fd;
+    poll_fd.fd = inotify_fd_;
+    poll_fd.events = POLLIN;
+
+    int wait_ms = 0;
+    while (true) {
+        if (stop_flag_ != nullptr && *stop_flag_) {
+            return -1;
+        }
+
+        int slice_ms = DAEMON_POLL_MS;
+        if (timeout_ms >= 0) {
+            slice_ms = min(slice_ms, timeout_ms - wait_ms);
+        }
+        poll_fd.revents = 0;
+        int ret = poll(&poll_fd, 1, slice_ms);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            tool::Logging(my_name_.c_str(), "poll the events error: %s.\n", strerror(errno));
+            return -1;
+        }
+        if (ret > 0) {
+            return ret;
+        }
+
+        wait_ms += slice_ms;
+        if (timeout_ms >= 0 && wait_ms >= timeout_ms) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief read the pending events, and collect the completed recipes
+ *
+ * @return int the num of the events of the recipes (-1: error)
+ */
+int RecipeWatcher::ReadEvents() {
+    int recipe_num = 0;
+    while (true) {
+        ssize_t read_len = read(inotify_fd_, event_buf_, DAEMON_EVENT_BUF_SIZE);
+        if (read_len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                break;
+            }
+            tool::Logging(my_name_.c_str(), "read the events error: %s.\n", strerror(errno));
+            return -1;
+        }
+
+        for (ssize_t offset = 0; offset < read_len; ) {
+            struct inotify_event* event = (struct inotify_event*)(event_buf_ + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // some events are dropped, the scan finds the recipes anyway
+                is_lost_ = true;
+                recipe_num ++;
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+            string file_name(event->name);
+            if (file_name.size() == CHUNK_HASH_SIZE * 2 + recipe_suffix_.size() &&
+                file_name.compare(CHUNK_HASH_SIZE * 2, string::npos, recipe_suffix_) == 0) {
+                recipe_name_set_.insert(file_name.substr(0, CHUNK_HASH_SIZE * 2));
+                recipe_num ++;
+            }
+        }
+    }
+
+    return recipe_num;
+}
+
+/**
+ * @brief wait until some recipes are completed and the dir settles
+ *
+ * @param recipe_name_list the completed recipes
+ * @param is_lost some events are lost, scan the whole dir
+ * @return true
+ * @return false the watch fails or is stopped
+ */
+bool RecipeWatcher::WaitRecipes(vector<string>& recipe_name_list, bool& is_lost) {
+    uint64_t recipe_num = 0;
+    recipe_name_set_.clear();
+    is_lost_ = false;
+    while (recipe_num == 0) {
+        if (this->PollEvents(-1) < 0) {
+            return false;
+        }
+        int ret = this->ReadEvents();
+        if (ret < 0) {
+            return false;
+        }
+        recipe_num += ret;
+    }
+
+    // gather the burst
+    while (true) {
+        int ret = this->PollEvents(settle_ms_);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0) {
+            return false;
+        }
+        ret = this->ReadEvents();
+        if (ret < 0) {
+            return false;
+        }
+        recipe_num += ret;
+    }
+
+    recipe_name_list.assign(recipe_name_set_.begin(), recipe_name_set_.end());
+    is_lost = is_lost_;
+    tool::Logging(my_name_.c_str(), "%lu recipes are completed%s.\n", recipe_name_list.size(),
+        is_lost ? " (some events are lost)" : "");
+
+    return true;
+}
@@ -31,6 +31,13 @@
 #include "../../include/stream_phase_4_thd.h"
 #include "../../include/stream_phase_5_thd.h"
 #include "../../include/sync_data_writer.h"
+#include "../../include/sync_mux.h"
+#include "../../include/sync_local_transport.h"
+#include "../../include/sync_rate_limiter.h"
+#include "../../include/sync_checkpoint.h"
+#include "../../include/sync_watermark.h"
+#include "../../include/recipe_watcher.h"
+#include "../../include/sync_scheduler.h"
 
 #include "../src/Enclave/include/syncOcall.h"
 
@@ -55,15 +62,15 @@ Configure config("config.json");
 SyncConfigure sync_config("sync_config.json");
 string my_name = "SeedSyncMain";
 
-// for input MQs
+// for input MQs (each entry is a whole received batch from the buffer pool)
 // stream-phase-1: input = chunkHash list; output = uni chunkHash list
-MessageQueue<StreamPhase1MQ_t>* p1_MQ;
+MessageQueue<StreamBatchMQ_t>* p1_MQ;
 // stream-phase-2: input = uni chunkHash list; output = feature list
-MessageQueue<StreamPhase2MQ_t>* p2_MQ;
+MessageQueue<StreamBatchMQ_t>* p2_MQ;
 // stream-phase-3: input = feature list; output = base hash list
-MessageQueue<StreamPhase3MQ_t>* p3_MQ;
+MessageQueue<StreamBatchMQ_t>* p3_MQ;
 // stream-phase-4: input = base hash list; output = chunk data (delta/uni)
-MessageQueue<StreamPhase4MQ_t>* p4_MQ;
+MessageQueue<StreamBatchMQ_t>* p4_MQ;
 // stream-phase-5: input = chunk data (delta/uni); output = storage pool
 MessageQueue<StreamPhase5MQ_t>* p5_MQ;
 
@@ -75,10 +82,14 @@ DatabaseFactory db_factory;
 // AbsDatabase* out_seg_db;
 AbsDatabase* out_chunk_db;
 AbsDatabase* out_feature_db;
+// the dest side in the single-process mode
+AbsDatabase* dest_chunk_db = nullptr;
+AbsDatabase* dest_feature_db = nullptr;
 
 // // for storage
 SyncStorage* sync_storage_obj = nullptr;
 SyncDataWriter* sync_data_writer_obj = nullptr;
+SyncStorage* dest_storage_obj = nullptr;
 
 // thread objects
 // SendThd* send_thd_obj = nullptr;
@@ -93,6 +104,11 @@ PhaseRecv* phase3_recv_thd = nullptr;
 PhaseRecv* phase4_recv_thd = nullptr;
 PhaseRecv* phase5_recv_thd = nullptr;
 PhaseRecv* phase6_recv_thd = nullptr;
+SyncMux* sync_mux_obj = nullptr;
+SyncLocalTransport* sync_local_obj = nullptr;
+SyncRateLimiter* sync_rate_limiter_obj = nullptr;
+SyncCheckpoint* sync_checkpoint_obj = nullptr;
+SyncWatermark* sync_watermark_obj = nullptr;
 
 StreamPhase1Thd* stream_phase_1_thd = nullptr;
 StreamPhase2Thd* stream_phase_2_thd = nullptr;
@@ -100,6 +116,28 @@ StreamPhase3Thd* stream_phase_3_thd = nullptr;
 StreamPhase4Thd* stream_phase_4_thd = nullptr;
 StreamPhase5Thd* stream_phase_5_thd = nullptr;
 
+// the source objects per dest (fan-out), the globals above refer to cloud-2's
+typedef struct {
+    MessageQueue<StreamBatchMQ_t>* p2_MQ;
+    MessageQueue<StreamBatchMQ_t>* p4_MQ;
+    SyncMux* sync_mux;
+    PhaseSender* phase1_sender;
+    PhaseSender* phase3_sender;
+    PhaseSender* phase5_sender;
+    PhaseRecv* phase3_recv;
+    PhaseRecv* phase5_recv;
+    StreamPhase3Thd* stream_phase_3;
+    StreamPhase5Thd* stream_phase_5;
+} SyncDestPipeline_t;
+vector<SyncDestPipeline_t> dest_pipeline_list;
+
+// for the graceful stop (SIGTERM)
+volatile sig_atomic_t is_draining = 0;
+std::atomic<bool> is_drain_done(false);
+// the dest phase threads stopped before persisting
+boost::thread* stream_phase_2_hdl = nullptr;
+boost::thread* stream_phase_4_hdl = nullptr;
+
 // recv buf
 SendMsgBuffer_t recv_buf;
 
@@ -108,16 +146,359 @@ SendMsgBuffer_t recv_buf;
 vector<boost::thread*> thd_list;
 
 void Usage() {
-    fprintf(stderr, "%s -t [s/w] -i [sync file path]. \n"
-        "-t: operation ([s/w]:)\n"
+    fprintf(stderr, "%s -t [s/w/l/b/r/d] -i [sync file path]. \n"
+        "-t: operation ([s/w/l/b/r/d]:)\n"
         "\ts: sync request\n"
-        "\tw: waiting\n",
+        "\tw: waiting\n"
+        "\tl: local sync (source and dest in one process, without network)\n"
+        "\tb: bidirectional sync, connect to cloud-2 (both clouds send the files \n"
+        "\t   the other one misses over one connection, requires the mux)\n"
+        "\tr: bidirectional sync, wait for cloud-1\n"
+        "\td: daemon, keep the session and sync the recipes once they are completed\n"
+        "-i: sync file path (repeat -i to sync multiple files in one session; without -i, \n"
+        "\tsync the recipes new or changed since the last sync to the dest)\n",
         my_name.c_str()
     );
 
     return;
 }
 
+/**
+ * @brief collect the source objects of the current dest
+ * 
+ * @return SyncDestPipeline_t 
+ */
+SyncDestPipeline_t GetDestPipeline() {
+    SyncDestPipeline_t dest_pipeline;
+    dest_pipeline.p2_MQ = p2_MQ;
+    dest_pipeline.p4_MQ = p4_MQ;
+    dest_pipeline.sync_mux = sync_mux_obj;
+    dest_pipeline.phase1_sender = phase1_sender_obj;
+    dest_pipeline.phase3_sender = phase3_sender_obj;
+    dest_pipeline.phase5_sender = phase5_sender_obj;
+    dest_pipeline.phase3_recv = phase3_recv_thd;
+    dest_pipeline.phase5_recv = phase5_recv_thd;
+    dest_pipeline.stream_phase_3 = stream_phase_3_thd;
+    dest_pipeline.stream_phase_5 = stream_phase_5_thd;
+
+    return dest_pipeline;
+}
+
+/**
+ * @brief point the globals at the source objects of a dest
+ * 
+ * @param dest_pipeline 
+ */
+void SetDestPipeline(SyncDestPipeline_t& dest_pipeline) {
+    p2_MQ = dest_pipeline.p2_MQ;
+    p4_MQ = dest_pipeline.p4_MQ;
+    sync_mux_obj = dest_pipeline.sync_mux;
+    phase1_sender_obj = dest_pipeline.phase1_sender;
+    phase3_sender_obj = dest_pipeline.phase3_sender;
+    phase5_sender_obj = dest_pipeline.phase5_sender;
+    phase3_recv_thd = dest_pipeline.phase3_recv;
+    phase5_recv_thd = dest_pipeline.phase5_recv;
+    stream_phase_3_thd = dest_pipeline.stream_phase_3;
+    stream_phase_5_thd = dest_pipeline.stream_phase_5;
+
+    return ;
+}
+
+/**
+ * @brief sync the files in the session (source side), at most max_inflight_files 
+ * files are in the pipeline at once
+ * 
+ * @param sync_file_list 
+ * @param src_log_file_hdl 
+ * @param is_recipe_list the list holds the recipe names (incremental sync)
+ */
+void SyncFileList(vector<string>& sync_file_list, std::ofstream& src_log_file_hdl,
+    bool is_recipe_list) {
+    SyncEnclaveInfo_t sync_enclave_info;
+    uint64_t max_inflight_num = sync_config.GetMaxInflightFiles();
+    // the files issued to phase-1 (the ones synced in the interrupted session are skipped)
+    vector<string> issued_file_list;
+    size_t done_num = 0;
+    // the files done in the previous rounds of the session (daemon mode)
+    vector<uint64_t> base_done_num;
+    for (auto& dest_pipeline : dest_pipeline_list) {
+        base_done_num.push_back(dest_pipeline.phase5_recv->GetDoneFileNum());
+    }
+
+    if (sync_config.GetSchedulePolicy() != SCHEDULE_MTIME) {
+        // the files that matter most go first
+        SyncScheduler sync_scheduler(stream_phase_1_thd);
+        sync_scheduler.Order(sync_file_list, is_recipe_list);
+    }
+
+    auto wait_one_file = [&]() {
+        // a file is done once all the dests have checked it
+        for (size_t i = 0; i < dest_pipeline_list.size(); i++) {
+            dest_pipeline_list[i].phase5_recv->WaitFileDone(base_done_num[i] + done_num + 1);
+        }
+
+        // get the enclave info here
+        Ecall_GetSyncEnclaveInfo(eid_sgx, &sync_enclave_info, SOURCE_CLOUD);
+
+        // update the source log (the files may finish out of order when resent, 
+        // the info is accumulated)
+        src_log_file_hdl << issued_file_list[done_num] << ", "
+            << sync_enclave_info.total_chunk_size << ", " << sync_enclave_info.total_chunk_num << ", "
+            << sync_enclave_info.total_unique_size << ", " << sync_enclave_info.total_unique_num << ", "
+            << sync_enclave_info.total_similar_size << ", " << sync_enclave_info.total_similar_num << ", "
+            << sync_enclave_info.total_base_size << ", "
+            << sync_enclave_info.total_delta_size << ", "
+            << sync_enclave_info.total_comp_delta_size << ", "
+            << stream_phase_1_thd->_phase1_process_time << ", "
+            << stream_phase_3_thd->_phase3_process_time << ", "
+            << stream_phase_5_thd->_phase5_process_time << ", "
+            <<endl;
+
+        src_log_file_hdl.flush();
+        done_num ++;
+    };
+
+    bool is_stopped = false;
+    for (size_t i = 0; i < sync_file_list.size(); i++) {
+        if (is_draining) {
+            // graceful stop: drain the files in the pipeline, leave the others 
+            // to the next session
+            tool::Logging(my_name.c_str(), "stop issuing files, %lu of %lu are left.\n",
+                sync_file_list.size() - i, sync_file_list.size());
+            is_stopped = true;
+            break;
+        }
+        string& file_name = sync_file_list[i];
+
+        // wait for the files out of the window
+        while (issued_file_list.size() - done_num >= max_inflight_num) {
+            wait_one_file();
+        }
+
+        // read the recipe of the next file while this one is being sent
+        if (i + 1 < sync_file_list.size()) {
+            string next_recipe_name = is_recipe_list ? sync_file_list[i + 1] :
+                stream_phase_1_thd->GetRecipeName(sync_file_list[i + 1]);
+            stream_phase_1_thd->SetNextRecipe(next_recipe_name);
+        }
+
+        bool is_issued = is_recipe_list ? stream_phase_1_thd->SyncRecipe(file_name) :
+            stream_phase_1_thd->SyncRequest(file_name);
+        if (is_issued) {
+            issued_file_list.push_back(file_name);
+        }
+        else if (is_draining) {
+            // cut in the middle (or skipped), the next session resumes from here
+            tool::Logging(my_name.c_str(), "stop issuing files, %lu of %lu are left.\n",
+                sync_file_list.size() - i, sync_file_list.size());
+            is_stopped = true;
+            break;
+        }
+    }
+
+    // wait for all the files
+    while (done_num < issued_file_list.size()) {
+        wait_one_file();
+    }
+
+    if (sync_config.GetSentFPCacheItem() != 0 && done_num != 0) {
+        tool::Logging(my_name.c_str(), "suppress %lu repeated chunk fps of %lu in phase-1.\n",
+            sync_enclave_info.total_suppressed_num, sync_enclave_info.total_chunk_num);
+    }
+
+    if (sync_checkpoint_obj != nullptr && !is_stopped) {
+        // the session is done, the next one starts from scratch
+        sync_checkpoint_obj->Clear();
+    }
+
+    if (sync_watermark_obj != nullptr) {
+        // advance the watermark only if all the dests have the selected recipes
+        bool is_all_done = true;
+        for (size_t i = 0; i < dest_pipeline_list.size(); i++) {
+            if (dest_pipeline_list[i].phase5_recv->GetDoneFileNum() - base_done_num[i] < 
+                issued_file_list.size()) {
+                is_all_done = false;
+            }
+        }
+        if (is_all_done && !is_stopped) {
+            sync_watermark_obj->Commit();
+        }
+        else {
+            tool::Logging(my_name.c_str(), "the session is interrupted, keep the watermark.\n");
+        }
+    }
+
+    return ;
+}
+
+/**
+ * @brief keep the session (the enclave, connections, and caches stay warm), and 
+ * sync the recipes completed since the last round
+ * 
+ * @param sync_file_list 
+ * @param src_log_file_hdl 
+ */
+void SyncDaemon(vector<string>& sync_file_list, std::ofstream& src_log_file_hdl) {
+    // watch first, then select the backlog, such that the recipes completed 
+    // during the selection are not missed
+    RecipeWatcher recipe_watcher(config.GetRecipeRootPath());
+    recipe_watcher.SetStopFlag(&is_draining);
+    tool::Logging(my_name.c_str(), "the daemon watches %s.\n", config.GetRecipeRootPath().c_str());
+    sync_watermark_obj->SelectRecipes(config.GetRecipeRootPath(), sync_file_list);
+
+    vector<string> recipe_name_list;
+    bool is_lost = false;
+    while (!is_draining) {
+        if (!sync_file_list.empty()) {
+            SyncFileList(sync_file_list, src_log_file_hdl, true);
+            sync_file_list.clear();
+        }
+
+        if (!recipe_watcher.WaitRecipes(recipe_name_list, is_lost)) {
+            break;
+        }
+        if (is_lost) {
+            sync_watermark_obj->SelectRecipes(config.GetRecipeRootPath(), sync_file_list);
+        }
+        else {
+            sync_watermark_obj->SelectNamedRecipes(config.GetRecipeRootPath(), 
+                recipe_name_list, sync_file_list);
+        }
+    }
+
+    return ;
+}
+
+/**
+ * @brief list the names of the local recipes
+ * 
+ * @param recipe_root_path 
+ * @param recipe_list 
+ */
+void ListLocalRecipes(string recipe_root_path, vector<string>& recipe_list) {
+    string recipe_suffix = config.GetRecipeSuffix();
+    for (const auto& entry : fs::directory_iterator(recipe_root_path)) {
+        if (!fs::is_regular_file(entry)) {
+            continue;
+        }
+        string file_name = entry.path().filename().string();
+        if (file_name.size() != CHUNK_HASH_SIZE * 2 + recipe_suffix.size() ||
+            file_name.compare(CHUNK_HASH_SIZE * 2, string::npos, recipe_suffix) != 0) {
+            continue;
+        }
+        recipe_list.push_back(file_name.substr(0, CHUNK_HASH_SIZE * 2));
+    }
+
+    return ;
+}
+
+/**
+ * @brief start a phase thread for one side in the single-process mode, whose
+ * ocalls use the indexes and storage of that side
+ * 
+ * @param thd_attrs 
+ * @param thd_obj 
+ * @param chunk_db 
+ * @param feature_db 
+ * @param storage 
+ * @param side_thd_list 
+ */
+template <class T>
+void StartSideThd(boost::thread::attributes& thd_attrs, T* thd_obj, AbsDatabase* chunk_db, 
+    AbsDatabase* feature_db, SyncStorage* storage, vector<boost::thread*>& side_thd_list) {
+    boost::thread* tmp_thd = new boost::thread(thd_attrs, [=] {
+        SyncOutEnclave::BindThread(chunk_db, feature_db, storage);
+        thd_obj->Run();
+    });
+    side_thd_list.push_back(tmp_thd);
+
+    return ;
+}
+
+/**
+ * @brief the graceful stop, the drain monitor does the work
+ * 
+ * @param s 
+ */
+void Drain(int s) {
+    is_draining = 1;
+}
+
+/**
+ * @brief make the dest state durable (no session in progress), then exit
+ * 
+ */
+void PersistAndExit() {
+    // no batch left in the phase threads, and none of them touches the indexes 
+    // while they are dumped
+    stream_phase_2_thd->SetDoneFlag();
+    stream_phase_4_thd->SetDoneFlag();
+    stream_phase_2_hdl->join();
+    stream_phase_4_hdl->join();
+
+    // the tail container and the index delta
+    sync_data_writer_obj->ProcessTailBatch();
+
+    // dump the outside indexes, the index delta is not needed then
+    delete out_chunk_db;
+    delete out_feature_db;
+    SyncOutEnclave::ResetIndexDelta(config.GetFp2ChunkDBName());
+
+    tool::Logging(my_name.c_str(), "the dest state is persisted, exit now.\n");
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief drain and stop on SIGTERM: the source stops issuing files and drains 
+ * the files in the pipeline; the dest refuses the next session, and persists its 
+ * state once the current one ends. beyond the timeout, the process exits with 
+ * the committed containers and index delta (replayed at the next start)
+ * 
+ * @param opt_type 
+ */
+void DrainMonitor(uint32_t opt_type) {
+    while (!is_draining) {
+        if (is_drain_done) {
+            return ;
+        }
+        usleep(DRAIN_POLL_MS * 1000);
+    }
+
+    uint64_t drain_timeout = sync_config.GetDrainTimeout();
+    tool::Logging(my_name.c_str(), "drain and stop (timeout: %lu s).\n", drain_timeout);
+    struct timeval drain_stime;
+    struct timeval drain_etime;
+    gettimeofday(&drain_stime, NULL);
+
+    if (opt_type == WAIT_OPT) {
+        // a session comes to phase-2 first
+        phase2_recv_thd->Drain();
+        if (phase2_recv_thd->IsInSession() && !phase2_sender_obj->StopRequest()) {
+            // the session has just ended
+            tool::Logging(my_name.c_str(), "cannot send the stop request to source.\n");
+        }
+    }
+
+    while (!is_drain_done) {
+        if (opt_type == WAIT_OPT && !phase2_recv_thd->IsInSession() && 
+            !phase4_recv_thd->IsInSession() && !phase6_recv_thd->IsInSession()) {
+            PersistAndExit();
+        }
+
+        gettimeofday(&drain_etime, NULL);
+        if (tool::GetTimeDiff(drain_stime, drain_etime) >= drain_timeout) {
+            tool::Logging(my_name.c_str(), "the drain times out, exit with the committed state.\n");
+            if (sync_data_writer_obj != nullptr) {
+                sync_data_writer_obj->ProcessTailBatch();
+            }
+            exit(EXIT_FAILURE);
+        }
+        usleep(DRAIN_POLL_MS * 1000);
+    }
+
+    return ;
+}
+
 void CTRLC(int s) {
     tool::Logging(my_name.c_str(), "terminated with ctrl+c interruption. \n");
 
@@ -168,12 +549,19 @@ int main(int argc, char* argv[]) {
     sigaction(SIGKILL, &sigIntHandler, 0);
     sigaction(SIGINT, &sigIntHandler, 0);
 
+    // graceful stop, restart the interrupted blocking I/O of the phase threads
+    struct sigaction sigTermHandler;
+    sigemptyset(&sigTermHandler.sa_mask);
+    sigTermHandler.sa_flags = SA_RESTART;
+    sigTermHandler.sa_handler = Drain;
+    sigaction(SIGTERM, &sigTermHandler, 0);
+
     srand(tool::GetStrongSeed());
 
     const char opt_str[] = "t:i:";
     int option;
 
-    if (argc < (int)sizeof(opt_str)) {
+    if (argc < 3) {
         // tool::Logging(my_name.c_str(), "wrong argc: %d\n", argc);
         Usage();
         exit(EXIT_FAILURE);
@@ -181,6 +569,7 @@ int main(int argc, char* argv[]) {
 
     uint32_t opt_type;
     string sync_file_name;
+    vector<string> sync_file_list;
 
     while ((option = getopt(argc, argv, opt_str)) != -1) {
         switch (option) {
@@ -191,6 +580,18 @@ int main(int argc, char* argv[]) {
                 else if (strcmp("w", optarg) == 0) {
                     opt_type = WAIT_OPT;
                 } 
+                else if (strcmp("l", optarg) == 0) {
+                    opt_type = LOCAL_OPT;
+                }
+                else if (strcmp("b", optarg) == 0) {
+                    opt_type = BI_SYNC_OPT;
+                }
+                else if (strcmp("r", optarg) == 0) {
+                    opt_type = BI_WAIT_OPT;
+                }
+                else if (strcmp("d", optarg) == 0) {
+                    opt_type = DAEMON_OPT;
+                }
                 else {
                     tool::Logging(my_name.c_str(), "wrong operation type.\n");
                     Usage();
@@ -200,6 +601,7 @@ int main(int argc, char* argv[]) {
             }
             case 'i': {
                 sync_file_name.assign(optarg);
+                sync_file_list.push_back(sync_file_name);
                 cout<<"get file name "<<sync_file_name<<endl;
                 break;
             }
@@ -212,6 +614,42 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    bool is_bidirectional = (opt_type == BI_SYNC_OPT || opt_type == BI_WAIT_OPT);
+    if (is_bidirectional && !sync_config.IsMuxEnabled()) {
+        // both directions share one connection
+        tool::Logging(my_name.c_str(), "bidirectional sync requires Network.enable_mux.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opt_type == DAEMON_OPT && !sync_file_list.empty()) {
+        // the daemon picks the recipes itself
+        tool::Logging(my_name.c_str(), "the daemon mode does not take -i.\n");
+        Usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // no file is given: sync the recipes new or changed since the last sync to 
+    // this dest (one watermark per dest, or per dest set with fan-out)
+    bool is_incremental = false;
+    if ((opt_type == SYNC_OPT || opt_type == LOCAL_OPT || is_bidirectional || 
+        opt_type == DAEMON_OPT) && sync_file_list.empty()) {
+        is_incremental = true;
+        int peer_id = (opt_type == BI_WAIT_OPT) ? sync_config.GetCloud1ID() : 
+            sync_config.GetCloud2ID();
+        string watermark_name = sync_config.GetWatermarkName() + "-" + to_string(peer_id);
+        if (opt_type == SYNC_OPT || opt_type == DAEMON_OPT) {
+            vector<SyncDest_t>& dest_list = sync_config.GetDestList();
+            for (size_t i = 1; i < dest_list.size(); i++) {
+                watermark_name += "-" + to_string(dest_list[i].id);
+            }
+        }
+        sync_watermark_obj = new SyncWatermark(watermark_name);
+        if (opt_type != DAEMON_OPT) {
+            // the daemon selects once its watch is set up
+            sync_watermark_obj->SelectRecipes(config.GetRecipeRootPath(), sync_file_list);
+        }
+    }
+
     // setup the log file
     string log_file_name = "Dest-Log";
     std::ofstream log_file_hdl;
@@ -278,9 +716,6 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // for enclave info
-    SyncEnclaveInfo_t sync_enclave_info;
-
     // for network connections
     // 5 connection pairs for per-phase send & recv
     int cloud_id;
@@ -321,6 +756,9 @@ int main(int argc, char* argv[]) {
     SSLConnection* p6_recv_channel;
     pair<int, SSL*> p6_recv_conn_record;
 
+    // multiplexed connection of all phases
+    SSLConnection* mux_channel;
+
     // for the recv buf
     recv_buf.sendBuffer = (uint8_t*) malloc(sizeof(NetworkHead_t) + 
         MAX_CHUNK_SIZE * sync_config.GetDataBatchSize());
@@ -357,20 +795,40 @@ int main(int argc, char* argv[]) {
     enclave_config.sendRecipeBatchSize = config.GetSendRecipeBatchSize();
     enclave_config.sendMetaBatchSize = sync_config.GetMetaBatchSize();
     enclave_config.enclaveCacheItemNum = sync_config.GetEnclaveCacheSize();
+    enclave_config.maxDeltaDepth = sync_config.GetMaxDeltaDepth();
+    enclave_config.sentFPCacheItemNum = sync_config.GetSentFPCacheItem();
     // init the sync enclave
     Ecall_Sync_Enclave_Init(eid_sgx, &enclave_config);
     // init the sync ecalls
     Ecall_Init_Sync(eid_sgx);
 
     // // init the out-enclave var
-    SyncOutEnclave::Init(out_chunk_db, out_feature_db, sync_storage_obj);
+    if (opt_type == LOCAL_OPT) {
+        // the dest keeps its own indexes (the containers of both sides are named 
+        // by UUIDs in the same container dir), the group commit is for the dest
+        dest_chunk_db = db_factory.CreateDatabase(IN_MEMORY, 
+            config.GetFp2ChunkDBName() + "-dest");
+        dest_feature_db = db_factory.CreateDatabase(IN_MEMORY, 
+            sync_config.GetOutFeatureDBName() + "-dest");
+        dest_storage_obj = new SyncStorage();
+        SyncOutEnclave::Init(dest_chunk_db, dest_feature_db, dest_storage_obj);
+        // the main thread issues the source requests
+        SyncOutEnclave::BindThread(out_chunk_db, out_feature_db, sync_storage_obj);
+    }
+    else {
+        SyncOutEnclave::Init(out_chunk_db, out_feature_db, sync_storage_obj);
+    }
 
-    switch (opt_type) {
-        case SYNC_OPT: {
-            // init MQ
-            p2_MQ = new MessageQueue<StreamPhase2MQ_t>(CHUNK_QUEUE_SIZE);
-            p4_MQ = new MessageQueue<StreamPhase4MQ_t>(CHUNK_QUEUE_SIZE);
+    // the sync-wide rate limit shared by all the senders
+    if (sync_config.GetRateLimit() != 0 || !sync_config.GetRateSchedule().empty()) {
+        sync_rate_limiter_obj = new SyncRateLimiter();
+    }
 
+    boost::thread* drain_thd = new boost::thread(boost::bind(&DrainMonitor, opt_type));
+
+    switch (opt_type) {
+        case SYNC_OPT:
+        case DAEMON_OPT: {
             // the cloud who issues a sync request
             cloud_id = sync_config.GetCloud1ID(); // assign cloud-1 as sync issuer
             cloud_ip = sync_config.GetCloud1IP();
@@ -382,111 +840,195 @@ int main(int argc, char* argv[]) {
             p5_recv_port = sync_config.GetP5RecvPort();
             p5_send_port = sync_config.GetP5SendPort();
 
-            p1_send_channel = new SSLConnection(sync_config.GetCloud2IP(),
-                sync_config.GetP2RecvPort(), IN_CLIENTSIDE);
-            p3_recv_channel = new SSLConnection(sync_config.GetCloud1IP(),
-                p3_recv_port, IN_SERVERSIDE);
-            p3_send_channel = new SSLConnection(sync_config.GetCloud2IP(),
-                sync_config.GetP4RecvPort(), IN_CLIENTSIDE);
-            p5_recv_channel = new SSLConnection(sync_config.GetCloud1IP(),
-                p5_recv_port, IN_SERVERSIDE);
-            p5_send_channel = new SSLConnection(sync_config.GetCloud2IP(),
-                sync_config.GetP6RecvPort(), IN_CLIENTSIDE);
-
-            // triggle the sync request
-            // step-1: phase-1 connect to phase-2
-            p1_send_conn_record = p1_send_channel->ConnectSSL();
-            phase1_sender_obj = new PhaseSender(p1_send_channel, p1_send_conn_record, 1);
-            
-            // TODO: if not the first time, set up the network
-            // if ()
-            phase1_sender_obj->SyncLogin();
-
-            // cout<<"after sync login"<<endl;
-
-            // phase-3 recv login from phase-2
-            p3_recv_conn_record = p3_recv_channel->ListenSSL();
-
-            // cout<<"p3 recv connects with p2 send"<<endl;
-
-            p3_send_conn_record = p3_send_channel->ConnectSSL();
-            phase3_sender_obj = new PhaseSender(p3_send_channel, p3_send_conn_record, 3);
-            phase3_sender_obj->SyncLogin();
-
-            // cout<<"p3 send connects with p4 recv"<<endl;
+            // fan-out: phase-1 reads the recipes once and sends the batches to 
+            // all the dests, each dest has its own phase-3/5 threads and connection 
+            // (the source containers are read via the shared container cache)
+            vector<SyncDest_t>& dest_list = sync_config.GetDestList();
+            if (sync_config.GetCheckpointBatchNum() != 0) {
+                // resume from the checkpoint of the interrupted session (if any)
+                sync_checkpoint_obj = new SyncCheckpoint(sync_config.GetSyncCheckpointName(),
+                    dest_list.size());
+            }
 
-            p5_recv_conn_record = p5_recv_channel->ListenSSL();
+            for (uint32_t dest_idx = 0; dest_idx < dest_list.size(); dest_idx++) {
+                SyncDest_t& dest = dest_list[dest_idx];
+
+                // init MQ
+                p2_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+                p4_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+
+                if (sync_config.IsMuxEnabled()) {
+                    // all the phases share one connection to the dest
+                    mux_channel = new SSLConnection(dest.ip,
+                        dest.mux_recv_port, IN_CLIENTSIDE);
+                    if (sync_config.IsKTLSEnabled()) {
+                        // the mux connection carries the bulk data as well
+                        mux_channel->EnableKTLS();
+                    }
+                    sync_mux_obj = new SyncMux(mux_channel, IN_CLIENTSIDE);
+                    sync_mux_obj->Start();
+
+                    phase1_sender_obj = new PhaseSender(sync_mux_obj, 1);
+                    phase1_sender_obj->SyncLogin();
+                    phase3_sender_obj = new PhaseSender(sync_mux_obj, 3);
+                    phase3_sender_obj->SyncLogin();
+                    phase5_sender_obj = new PhaseSender(sync_mux_obj, 5);
+                    phase5_sender_obj->SyncLogin();
+
+                    p3_recv_channel = nullptr;
+                    p3_recv_conn_record = make_pair(-1, nullptr);
+                    p5_recv_channel = nullptr;
+                    p5_recv_conn_record = make_pair(-1, nullptr);
+                }
+                else {
+                    // a single dest (checked in the config)
+                    p1_send_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                        sync_config.GetP2RecvPort(), IN_CLIENTSIDE);
+                    p3_recv_channel = new SSLConnection(sync_config.GetCloud1IP(),
+                        p3_recv_port, IN_SERVERSIDE);
+                    p3_send_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                        sync_config.GetP4RecvPort(), IN_CLIENTSIDE);
+                    p5_recv_channel = new SSLConnection(sync_config.GetCloud1IP(),
+                        p5_recv_port, IN_SERVERSIDE);
+                    p5_send_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                        sync_config.GetP6RecvPort(), IN_CLIENTSIDE);
+                    if (sync_config.IsKTLSEnabled()) {
+                        // the bulk data of phase-5 -> phase-6
+                        p5_send_channel->EnableKTLS();
+                    }
+
+                    // triggle the sync request
+                    // step-1: phase-1 connect to phase-2
+                    p1_send_conn_record = p1_send_channel->ConnectSSL();
+                    phase1_sender_obj = new PhaseSender(p1_send_channel, p1_send_conn_record, 1);
+                
+                    // TODO: if not the first time, set up the network
+                    // if ()
+                    phase1_sender_obj->SyncLogin();
+
+                    // cout<<"after sync login"<<endl;
+
+                    // phase-3 recv login from phase-2
+                    p3_recv_conn_record = p3_recv_channel->ListenSSL();
+
+                    // cout<<"p3 recv connects with p2 send"<<endl;
+
+                    p3_send_conn_record = p3_send_channel->ConnectSSL();
+                    phase3_sender_obj = new PhaseSender(p3_send_channel, p3_send_conn_record, 3);
+                    phase3_sender_obj->SyncLogin();
+
+                    // cout<<"p3 send connects with p4 recv"<<endl;
+
+                    p5_recv_conn_record = p5_recv_channel->ListenSSL();
+
+                    // cout<<"p4 send connects with p5 recv"<<endl;
+
+                    p5_send_conn_record = p5_send_channel->ConnectSSL();
+                    phase5_sender_obj = new PhaseSender(p5_send_channel, p5_send_conn_record, 5);
+                    phase5_sender_obj->SyncLogin();
+
+                    // cout<<"p5 send connects with p6 recv"<<endl;
+                }
 
-            // cout<<"p4 send connects with p5 recv"<<endl;
+                if (sync_rate_limiter_obj != nullptr) {
+                    phase1_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                    phase3_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                    phase5_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                }
 
-            p5_send_conn_record = p5_send_channel->ConnectSSL();
-            phase5_sender_obj = new PhaseSender(p5_send_channel, p5_send_conn_record, 5);
-            phase5_sender_obj->SyncLogin();
 
-            // cout<<"p5 send connects with p6 recv"<<endl;
+                phase3_recv_thd = new PhaseRecv(p3_recv_channel, p3_recv_conn_record, p2_MQ, 3);
+                if (sync_mux_obj != nullptr) {
+                    phase3_recv_thd->SetTransport(sync_mux_obj);
+                }
+                // a draining dest stops the session
+                phase3_recv_thd->SetStopFlag(&is_draining);
 
+                tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase3_recv_thd));
+                thd_list.push_back(tmp_thd);
 
-            phase3_recv_thd = new PhaseRecv(p3_recv_channel, p3_recv_conn_record, p2_MQ, 3);
+                stream_phase_3_thd = new StreamPhase3Thd(phase3_sender_obj, p2_MQ, out_chunk_db, eid_sgx);
 
-            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase3_recv_thd));
-            thd_list.push_back(tmp_thd);
+                tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase3Thd::Run, stream_phase_3_thd));
+                thd_list.push_back(tmp_thd);
 
-            stream_phase_3_thd = new StreamPhase3Thd(phase3_sender_obj, p2_MQ, out_chunk_db, eid_sgx);
+                stream_phase_5_thd = new StreamPhase5Thd(phase5_sender_obj, p4_MQ, out_chunk_db, eid_sgx);
+                
+                tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase5Thd::Run, stream_phase_5_thd));
+                thd_list.push_back(tmp_thd);
 
-            tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase3Thd::Run, stream_phase_3_thd));
-            thd_list.push_back(tmp_thd);
+                if (dest_idx == 0) {
+                    stream_phase_1_thd = new StreamPhase1Thd(phase1_sender_obj, eid_sgx);
+                    stream_phase_1_thd->SetStopFlag(&is_draining);
+                    if (sync_checkpoint_obj != nullptr) {
+                        stream_phase_1_thd->SetCheckpoint(sync_checkpoint_obj);
+                    }
+                }
+                else {
+                    stream_phase_1_thd->AddSender(phase1_sender_obj);
+                }
 
-            stream_phase_5_thd = new StreamPhase5Thd(phase5_sender_obj, p4_MQ, out_chunk_db, eid_sgx);
-            
-            tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase5Thd::Run, stream_phase_5_thd));
-            thd_list.push_back(tmp_thd);
+                phase5_recv_thd = new PhaseRecv(p5_recv_channel, p5_recv_conn_record, p4_MQ, 5);
+                if (sync_mux_obj != nullptr) {
+                    phase5_recv_thd->SetTransport(sync_mux_obj);
+                }
+                if (sync_checkpoint_obj != nullptr) {
+                    phase5_recv_thd->SetCheckpoint(sync_checkpoint_obj, dest_idx);
+                }
+                phase5_recv_thd->SetPhase1Obj(stream_phase_1_thd, sync_file_name);
+                phase5_recv_thd->SetPhaseObjForSrcLog(stream_phase_3_thd, stream_phase_5_thd);
 
-            stream_phase_1_thd = new StreamPhase1Thd(phase1_sender_obj, eid_sgx);
+                tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase5_recv_thd));
+                thd_list.push_back(tmp_thd);
 
-            phase5_recv_thd = new PhaseRecv(p5_recv_channel, p5_recv_conn_record, p4_MQ, 5);
-            phase5_recv_thd->SetPhase1Obj(stream_phase_1_thd, sync_file_name);
-            phase5_recv_thd->SetPhaseObjForSrcLog(stream_phase_3_thd, stream_phase_5_thd);
+                dest_pipeline_list.push_back(GetDestPipeline());
+                if (dest_list.size() > 1) {
+                    tool::Logging(my_name.c_str(), "connect to dest %d (%s).\n", dest.id, 
+                        dest.ip.c_str());
+                }
+            }
+            // the globals refer to the objects of cloud-2
+            SetDestPipeline(dest_pipeline_list[0]);
 
-            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase5_recv_thd));
-            thd_list.push_back(tmp_thd);
 
+            // the files share the phase connections, the batches of a file carry 
+            // its id such that several files can be in the pipeline at once
+            if (opt_type == DAEMON_OPT) {
+                SyncDaemon(sync_file_list, src_log_file_hdl);
+            }
+            else {
+                SyncFileList(sync_file_list, src_log_file_hdl, is_incremental);
+            }
 
-            stream_phase_1_thd->SyncRequest(sync_file_name);
+            // close the session: phase-3/5 threads send the file end when exiting
+            for (auto& dest_pipeline : dest_pipeline_list) {
+                dest_pipeline.phase1_sender->FileEnd();
+                dest_pipeline.stream_phase_3->SetDoneFlag();
+                dest_pipeline.stream_phase_5->SetDoneFlag();
+            }
 
             for (auto it : thd_list) {
                 it->join();
             }
 
-            // get the enclave info here
-            Ecall_GetSyncEnclaveInfo(eid_sgx, &sync_enclave_info, SOURCE_CLOUD);
-
+            for (auto& dest_pipeline : dest_pipeline_list) {
+                if (dest_pipeline.sync_mux != nullptr) {
+                    // flush the tail messages to the dest
+                    dest_pipeline.sync_mux->Stop();
+                }
+            }
 
             for (auto it : thd_list) {
                 delete it;
             }
 
-            // update the source log
-            src_log_file_hdl << sync_file_name << ", "
-                << sync_enclave_info.total_chunk_size << ", " << sync_enclave_info.total_chunk_num << ", "
-                << sync_enclave_info.total_unique_size << ", " << sync_enclave_info.total_unique_num << ", "
-                << sync_enclave_info.total_similar_size << ", " << sync_enclave_info.total_similar_num << ", "
-                << sync_enclave_info.total_base_size << ", "
-                << sync_enclave_info.total_delta_size << ", "
-                << sync_enclave_info.total_comp_delta_size << ", "
-                << stream_phase_1_thd->_phase1_process_time << ", "
-                << stream_phase_3_thd->_phase3_process_time << ", "
-                << stream_phase_5_thd->_phase5_process_time << ", "
-                <<endl;
-
-            src_log_file_hdl.flush();
-
             break;
         }
         case WAIT_OPT: {
             sync_data_writer_obj = new SyncDataWriter(eid_sgx, out_chunk_db);
             // init MQ
-            p1_MQ = new MessageQueue<StreamPhase1MQ_t>(CHUNK_QUEUE_SIZE);
-            p3_MQ = new MessageQueue<StreamPhase3MQ_t>(CHUNK_QUEUE_SIZE);
+            p1_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p3_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
             p5_MQ = new MessageQueue<StreamPhase5MQ_t>(1);
 
             // the cloud who receives a sync request
@@ -500,36 +1042,73 @@ int main(int argc, char* argv[]) {
             p4_send_port = sync_config.GetP4SendPort();
             p6_recv_port = sync_config.GetP6RecvPort();
 
-            p2_recv_channel = new SSLConnection(sync_config.GetCloud2IP(),
-                p2_recv_port, IN_SERVERSIDE);
-            p2_send_channel = new SSLConnection(sync_config.GetCloud1IP(),
-                sync_config.GetP3RecvPort(), IN_CLIENTSIDE);
-            p4_recv_channel = new SSLConnection(sync_config.GetCloud2IP(),
-                p4_recv_port, IN_SERVERSIDE);
-            p4_send_channel = new SSLConnection(sync_config.GetCloud1IP(),
-                sync_config.GetP5RecvPort(), IN_CLIENTSIDE);
-            p6_recv_channel = new SSLConnection(sync_config.GetCloud2IP(),
-                p6_recv_port, IN_SERVERSIDE);
+            if (sync_config.IsMuxEnabled()) {
+                // all the phases share one connection (accepted by the mux per sync session)
+                mux_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                    sync_config.GetMuxRecvPort(), IN_SERVERSIDE);
+                if (sync_config.IsKTLSEnabled()) {
+                    // the mux connection carries the bulk data as well
+                    mux_channel->EnableKTLS();
+                }
+                sync_mux_obj = new SyncMux(mux_channel, IN_SERVERSIDE);
+                sync_mux_obj->Start();
+
+                phase2_sender_obj = new PhaseSender(sync_mux_obj, 2);
+                phase2_sender_obj->SyncLogin();
+                phase4_sender_obj = new PhaseSender(sync_mux_obj, 4);
+                phase4_sender_obj->SyncLogin();
+
+                p2_recv_channel = nullptr;
+                p2_recv_conn_record = make_pair(-1, nullptr);
+                p4_recv_channel = nullptr;
+                p4_recv_conn_record = make_pair(-1, nullptr);
+                p6_recv_channel = nullptr;
+                p6_recv_conn_record = make_pair(-1, nullptr);
+            }
+            else {
+                p2_recv_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                    p2_recv_port, IN_SERVERSIDE);
+                p2_send_channel = new SSLConnection(sync_config.GetCloud1IP(),
+                    sync_config.GetP3RecvPort(), IN_CLIENTSIDE);
+                p4_recv_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                    p4_recv_port, IN_SERVERSIDE);
+                p4_send_channel = new SSLConnection(sync_config.GetCloud1IP(),
+                    sync_config.GetP5RecvPort(), IN_CLIENTSIDE);
+                p6_recv_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                    p6_recv_port, IN_SERVERSIDE);
+                if (sync_config.IsKTLSEnabled()) {
+                    // the bulk data of phase-5 -> phase-6
+                    p6_recv_channel->EnableKTLS();
+                }
             
-            // setup phase connections
+                // setup phase connections
 
-            // phase-2 recv login from phase-1
-            p2_recv_conn_record = p2_recv_channel->ListenSSL();
+                // phase-2 recv login from phase-1
+                p2_recv_conn_record = p2_recv_channel->ListenSSL();
 
-            p2_send_conn_record = p2_send_channel->ConnectSSL();
-            phase2_sender_obj = new PhaseSender(p2_send_channel, p2_send_conn_record, 2);
-            phase2_sender_obj->SyncLogin();
+                p2_send_conn_record = p2_send_channel->ConnectSSL();
+                phase2_sender_obj = new PhaseSender(p2_send_channel, p2_send_conn_record, 2);
+                phase2_sender_obj->SyncLogin();
 
-            p4_recv_conn_record = p4_recv_channel->ListenSSL();
+                p4_recv_conn_record = p4_recv_channel->ListenSSL();
 
-            p4_send_conn_record = p4_send_channel->ConnectSSL();
-            phase4_sender_obj = new PhaseSender(p4_send_channel, p4_send_conn_record, 4);
-            phase4_sender_obj->SyncLogin();
+                p4_send_conn_record = p4_send_channel->ConnectSSL();
+                phase4_sender_obj = new PhaseSender(p4_send_channel, p4_send_conn_record, 4);
+                phase4_sender_obj->SyncLogin();
 
-            p6_recv_conn_record = p6_recv_channel->ListenSSL();
+                p6_recv_conn_record = p6_recv_channel->ListenSSL();
+            }
+
+            if (sync_rate_limiter_obj != nullptr) {
+                phase2_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase4_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+            }
 
 
             phase2_recv_thd = new PhaseRecv(p2_recv_channel, p2_recv_conn_record, p1_MQ, 2);
+            if (sync_mux_obj != nullptr) {
+                phase2_recv_thd->SetTransport(sync_mux_obj);
+            }
             phase2_recv_thd->SetSenderObj(phase2_sender_obj);
 
             phase2_recv_thd->SetFirstFlag(is_first_file);
@@ -541,8 +1120,12 @@ int main(int argc, char* argv[]) {
 
             tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase2Thd::Run, stream_phase_2_thd));
             thd_list.push_back(tmp_thd);
+            stream_phase_2_hdl = tmp_thd;
 
             phase4_recv_thd = new PhaseRecv(p4_recv_channel, p4_recv_conn_record, p3_MQ, 4);
+            if (sync_mux_obj != nullptr) {
+                phase4_recv_thd->SetTransport(sync_mux_obj);
+            }
             phase4_recv_thd->SetSenderObj(phase4_sender_obj);
 
             phase4_recv_thd->SetFirstFlag(is_first_file);
@@ -551,13 +1134,19 @@ int main(int argc, char* argv[]) {
             thd_list.push_back(tmp_thd);
 
             stream_phase_4_thd = new StreamPhase4Thd(phase4_sender_obj, p3_MQ, eid_sgx);
+            stream_phase_4_thd->SetSyncDataWriter(sync_data_writer_obj);
 
             tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase4Thd::Run, stream_phase_4_thd));
             thd_list.push_back(tmp_thd);
+            stream_phase_4_hdl = tmp_thd;
 
             phase6_recv_thd = new PhaseRecv(p6_recv_channel, p6_recv_conn_record, p5_MQ, 6);
+            if (sync_mux_obj != nullptr) {
+                phase6_recv_thd->SetTransport(sync_mux_obj);
+            }
             // set the sync writer here
             phase6_recv_thd->SetSyncDataWriter(sync_data_writer_obj);
+            phase6_recv_thd->SetSenderObj(phase4_sender_obj);
             // set sgx eid
             phase6_recv_thd->SetSgxEid(eid_sgx);
             phase6_recv_thd->SetPhaseObjForDestLog(stream_phase_2_thd, stream_phase_4_thd);
@@ -575,10 +1164,341 @@ int main(int argc, char* argv[]) {
                 delete it;
             }
 
+            break;
+        }
+        case LOCAL_OPT: {
+            // both sides in one process: the messages go through the memory 
+            // instead of the network, for profiling the pipeline alone
+            vector<boost::thread*> dest_thd_list;
+            sync_data_writer_obj = new SyncDataWriter(eid_sgx, dest_chunk_db);
+            p1_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p2_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p3_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p4_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p5_MQ = new MessageQueue<StreamPhase5MQ_t>(1);
+
+            sync_local_obj = new SyncLocalTransport();
+            sync_local_obj->Start();
+
+            phase1_sender_obj = new PhaseSender(sync_local_obj, 1);
+            phase1_sender_obj->SyncLogin();
+            phase2_sender_obj = new PhaseSender(sync_local_obj, 2);
+            phase2_sender_obj->SyncLogin();
+            phase3_sender_obj = new PhaseSender(sync_local_obj, 3);
+            phase3_sender_obj->SyncLogin();
+            phase4_sender_obj = new PhaseSender(sync_local_obj, 4);
+            phase4_sender_obj->SyncLogin();
+            phase5_sender_obj = new PhaseSender(sync_local_obj, 5);
+            phase5_sender_obj->SyncLogin();
+
+            if (sync_rate_limiter_obj != nullptr) {
+                phase1_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase2_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase3_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase4_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase5_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+            }
+
+            // the dest phases
+            phase2_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p1_MQ, 2);
+            phase2_recv_thd->SetTransport(sync_local_obj);
+            phase2_recv_thd->SetSenderObj(phase2_sender_obj);
+            phase2_recv_thd->SetFirstFlag(is_first_file);
+            StartSideThd(thd_attrs, phase2_recv_thd, dest_chunk_db, dest_feature_db,
+                dest_storage_obj, dest_thd_list);
+
+            stream_phase_2_thd = new StreamPhase2Thd(phase2_sender_obj, p1_MQ, dest_chunk_db, eid_sgx);
+            StartSideThd(thd_attrs, stream_phase_2_thd, dest_chunk_db, dest_feature_db,
+                dest_storage_obj, dest_thd_list);
+
+            phase4_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p3_MQ, 4);
+            phase4_recv_thd->SetTransport(sync_local_obj);
+            phase4_recv_thd->SetSenderObj(phase4_sender_obj);
+            phase4_recv_thd->SetFirstFlag(is_first_file);
+            StartSideThd(thd_attrs, phase4_recv_thd, dest_chunk_db, dest_feature_db,
+                dest_storage_obj, dest_thd_list);
+
+            stream_phase_4_thd = new StreamPhase4Thd(phase4_sender_obj, p3_MQ, eid_sgx);
+            stream_phase_4_thd->SetSyncDataWriter(sync_data_writer_obj);
+            StartSideThd(thd_attrs, stream_phase_4_thd, dest_chunk_db, dest_feature_db,
+                dest_storage_obj, dest_thd_list);
+
+            phase6_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p5_MQ, 6);
+            phase6_recv_thd->SetTransport(sync_local_obj);
+            phase6_recv_thd->SetSyncDataWriter(sync_data_writer_obj);
+            phase6_recv_thd->SetSenderObj(phase4_sender_obj);
+            phase6_recv_thd->SetSgxEid(eid_sgx);
+            phase6_recv_thd->SetPhaseObjForDestLog(stream_phase_2_thd, stream_phase_4_thd);
+            StartSideThd(thd_attrs, phase6_recv_thd, dest_chunk_db, dest_feature_db,
+                dest_storage_obj, dest_thd_list);
+
+            phase4_sender_obj->LoginResponse();
+
+            // the source phases
+            phase3_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p2_MQ, 3);
+            phase3_recv_thd->SetTransport(sync_local_obj);
+            StartSideThd(thd_attrs, phase3_recv_thd, out_chunk_db, out_feature_db,
+                sync_storage_obj, thd_list);
+
+            stream_phase_3_thd = new StreamPhase3Thd(phase3_sender_obj, p2_MQ, out_chunk_db, eid_sgx);
+            StartSideThd(thd_attrs, stream_phase_3_thd, out_chunk_db, out_feature_db,
+                sync_storage_obj, thd_list);
+
+            stream_phase_5_thd = new StreamPhase5Thd(phase5_sender_obj, p4_MQ, out_chunk_db, eid_sgx);
+            StartSideThd(thd_attrs, stream_phase_5_thd, out_chunk_db, out_feature_db,
+                sync_storage_obj, thd_list);
+
+            stream_phase_1_thd = new StreamPhase1Thd(phase1_sender_obj, eid_sgx);
+            stream_phase_1_thd->SetStopFlag(&is_draining);
+
+            phase5_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p4_MQ, 5);
+            phase5_recv_thd->SetTransport(sync_local_obj);
+            if (sync_config.GetCheckpointBatchNum() != 0) {
+                // a single dest in this mode
+                sync_checkpoint_obj = new SyncCheckpoint(sync_config.GetSyncCheckpointName(), 1);
+                stream_phase_1_thd->SetCheckpoint(sync_checkpoint_obj);
+                phase5_recv_thd->SetCheckpoint(sync_checkpoint_obj, 0);
+            }
+            phase5_recv_thd->SetPhase1Obj(stream_phase_1_thd, sync_file_name);
+            phase5_recv_thd->SetPhaseObjForSrcLog(stream_phase_3_thd, stream_phase_5_thd);
+            StartSideThd(thd_attrs, phase5_recv_thd, out_chunk_db, out_feature_db,
+                sync_storage_obj, thd_list);
+            dest_pipeline_list.push_back(GetDestPipeline());
+
+            SyncFileList(sync_file_list, src_log_file_hdl, is_incremental);
+
+            // close the session: the source threads exit after the dest passes 
+            // the session end back
+            phase1_sender_obj->FileEnd();
+            stream_phase_3_thd->SetDoneFlag();
+            stream_phase_5_thd->SetDoneFlag();
+
+            for (auto it : thd_list) {
+                it->join();
+            }
+
+            // no more sessions: the dest recv threads exit once their messages 
+            // are consumed
+            sync_local_obj->Stop();
+            stream_phase_2_thd->SetDoneFlag();
+            stream_phase_4_thd->SetDoneFlag();
+
+            for (auto it : dest_thd_list) {
+                it->join();
+            }
+
+            for (auto it : thd_list) {
+                delete it;
+            }
+            for (auto it : dest_thd_list) {
+                delete it;
+            }
+
+            delete p1_MQ;
+            delete p3_MQ;
+            delete p5_MQ;
+            delete phase2_sender_obj;
+            delete phase4_sender_obj;
+            delete phase2_recv_thd;
+            delete phase4_recv_thd;
+            delete phase6_recv_thd;
+            delete stream_phase_2_thd;
+            delete stream_phase_4_thd;
+
+            break;
+        }
+        case BI_SYNC_OPT:
+        case BI_WAIT_OPT: {
+            // both roles in one process over one mux connection: the source and 
+            // dest phases use distinct phase ids, and share the indexes, storage, 
+            // and locality cache of this cloud
+            vector<boost::thread*> dest_thd_list;
+            sync_data_writer_obj = new SyncDataWriter(eid_sgx, out_chunk_db);
+            p1_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p2_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p3_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p4_MQ = new MessageQueue<StreamBatchMQ_t>(SYNC_BATCH_POOL_SIZE);
+            p5_MQ = new MessageQueue<StreamPhase5MQ_t>(1);
+
+            if (opt_type == BI_SYNC_OPT) {
+                cloud_id = sync_config.GetCloud1ID();
+                cloud_ip = sync_config.GetCloud1IP();
+                mux_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                    sync_config.GetMuxRecvPort(), IN_CLIENTSIDE);
+            }
+            else {
+                cloud_id = sync_config.GetCloud2ID();
+                cloud_ip = sync_config.GetCloud2IP();
+                mux_channel = new SSLConnection(sync_config.GetCloud2IP(),
+                    sync_config.GetMuxRecvPort(), IN_SERVERSIDE);
+            }
+            if (sync_config.IsKTLSEnabled()) {
+                mux_channel->EnableKTLS();
+            }
+            sync_mux_obj = new SyncMux(mux_channel, 
+                (opt_type == BI_SYNC_OPT) ? IN_CLIENTSIDE : IN_SERVERSIDE);
+            // a single session, the dest phases do not wait for the next one
+            sync_mux_obj->SetOneSession();
+            sync_mux_obj->Start();
+
+            phase1_sender_obj = new PhaseSender(sync_mux_obj, 1);
+            phase1_sender_obj->SyncLogin();
+            phase2_sender_obj = new PhaseSender(sync_mux_obj, 2);
+            phase2_sender_obj->SyncLogin();
+            phase3_sender_obj = new PhaseSender(sync_mux_obj, 3);
+            phase3_sender_obj->SyncLogin();
+            phase4_sender_obj = new PhaseSender(sync_mux_obj, 4);
+            phase4_sender_obj->SyncLogin();
+            phase5_sender_obj = new PhaseSender(sync_mux_obj, 5);
+            phase5_sender_obj->SyncLogin();
+
+            if (sync_rate_limiter_obj != nullptr) {
+                phase1_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase2_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase3_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase4_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+                phase5_sender_obj->SetRateLimiter(sync_rate_limiter_obj);
+            }
+
+            // the dest phases (for the files of the other cloud)
+            phase2_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p1_MQ, 2);
+            phase2_recv_thd->SetTransport(sync_mux_obj);
+            phase2_recv_thd->SetSenderObj(phase2_sender_obj);
+            phase2_recv_thd->SetFirstFlag(is_first_file);
+            phase2_recv_thd->SetOneSession();
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase2_recv_thd));
+            thd_list.push_back(tmp_thd);
+
+            stream_phase_2_thd = new StreamPhase2Thd(phase2_sender_obj, p1_MQ, out_chunk_db, eid_sgx);
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase2Thd::Run, stream_phase_2_thd));
+            dest_thd_list.push_back(tmp_thd);
+
+            phase4_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p3_MQ, 4);
+            phase4_recv_thd->SetTransport(sync_mux_obj);
+            phase4_recv_thd->SetSenderObj(phase4_sender_obj);
+            phase4_recv_thd->SetFirstFlag(is_first_file);
+            phase4_recv_thd->SetOneSession();
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase4_recv_thd));
+            thd_list.push_back(tmp_thd);
+
+            stream_phase_4_thd = new StreamPhase4Thd(phase4_sender_obj, p3_MQ, eid_sgx);
+            stream_phase_4_thd->SetSyncDataWriter(sync_data_writer_obj);
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase4Thd::Run, stream_phase_4_thd));
+            dest_thd_list.push_back(tmp_thd);
+
+            phase6_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p5_MQ, 6);
+            phase6_recv_thd->SetTransport(sync_mux_obj);
+            phase6_recv_thd->SetSyncDataWriter(sync_data_writer_obj);
+            phase6_recv_thd->SetSenderObj(phase4_sender_obj);
+            phase6_recv_thd->SetSgxEid(eid_sgx);
+            phase6_recv_thd->SetPhaseObjForDestLog(stream_phase_2_thd, stream_phase_4_thd);
+            phase6_recv_thd->SetOneSession();
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase6_recv_thd));
+            thd_list.push_back(tmp_thd);
+
+            phase4_sender_obj->LoginResponse();
+
+            // the source phases (for the files of this cloud)
+            phase3_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p2_MQ, 3);
+            phase3_recv_thd->SetTransport(sync_mux_obj);
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase3_recv_thd));
+            thd_list.push_back(tmp_thd);
+
+            stream_phase_3_thd = new StreamPhase3Thd(phase3_sender_obj, p2_MQ, out_chunk_db, eid_sgx);
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase3Thd::Run, stream_phase_3_thd));
+            thd_list.push_back(tmp_thd);
+
+            stream_phase_5_thd = new StreamPhase5Thd(phase5_sender_obj, p4_MQ, out_chunk_db, eid_sgx);
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&StreamPhase5Thd::Run, stream_phase_5_thd));
+            thd_list.push_back(tmp_thd);
+
+            stream_phase_1_thd = new StreamPhase1Thd(phase1_sender_obj, eid_sgx);
+            stream_phase_1_thd->SetStopFlag(&is_draining);
+
+            phase5_recv_thd = new PhaseRecv(nullptr, make_pair(-1, nullptr), p4_MQ, 5);
+            phase5_recv_thd->SetTransport(sync_mux_obj);
+            if (sync_config.GetCheckpointBatchNum() != 0) {
+                sync_checkpoint_obj = new SyncCheckpoint(sync_config.GetSyncCheckpointName(), 1);
+                stream_phase_1_thd->SetCheckpoint(sync_checkpoint_obj);
+                phase5_recv_thd->SetCheckpoint(sync_checkpoint_obj, 0);
+            }
+            phase5_recv_thd->SetPhase1Obj(stream_phase_1_thd, sync_file_name);
+            phase5_recv_thd->SetPhaseObjForSrcLog(stream_phase_3_thd, stream_phase_5_thd);
+            tmp_thd = new boost::thread(thd_attrs, boost::bind(&PhaseRecv::Run, phase5_recv_thd));
+            thd_list.push_back(tmp_thd);
+            dest_pipeline_list.push_back(GetDestPipeline());
+
+            // exchange the recipe lists, each cloud sends only the recipes the 
+            // other one misses (on a name clash, the copy of the other cloud is kept)
+            vector<string> local_recipe_list;
+            vector<string> peer_recipe_list;
+            ListLocalRecipes(config.GetRecipeRootPath(), local_recipe_list);
+            phase1_sender_obj->RecipeList(local_recipe_list);
+            phase2_recv_thd->WaitPeerRecipeList(peer_recipe_list);
+            tool::Logging(my_name.c_str(), "cloud-%d has %lu recipes, the other cloud has %lu.\n",
+                cloud_id, local_recipe_list.size(), peer_recipe_list.size());
+
+            if (is_incremental) {
+                std::unordered_set<string> peer_recipe_set(peer_recipe_list.begin(), 
+                    peer_recipe_list.end());
+                vector<string> missing_recipe_list;
+                for (auto& recipe_name : sync_file_list) {
+                    if (peer_recipe_set.find(recipe_name) == peer_recipe_set.end()) {
+                        missing_recipe_list.push_back(recipe_name);
+                    }
+                }
+                tool::Logging(my_name.c_str(), "%lu recipes of %lu are missing in the other cloud.\n",
+                    missing_recipe_list.size(), sync_file_list.size());
+                sync_file_list.swap(missing_recipe_list);
+            }
+
+            SyncFileList(sync_file_list, src_log_file_hdl, is_incremental);
+
+            // close this direction, the recv threads exit once both directions 
+            // have passed their session end
+            phase1_sender_obj->FileEnd();
+            stream_phase_3_thd->SetDoneFlag();
+            stream_phase_5_thd->SetDoneFlag();
+
+            for (auto it : thd_list) {
+                it->join();
+            }
+
+            stream_phase_2_thd->SetDoneFlag();
+            stream_phase_4_thd->SetDoneFlag();
+            for (auto it : dest_thd_list) {
+                it->join();
+            }
+
+            // flush the tail messages to the other cloud
+            sync_mux_obj->Stop();
+
+            for (auto it : thd_list) {
+                delete it;
+            }
+            for (auto it : dest_thd_list) {
+                delete it;
+            }
+
+            delete p1_MQ;
+            delete p3_MQ;
+            delete p5_MQ;
+            delete phase2_sender_obj;
+            delete phase4_sender_obj;
+            delete phase2_recv_thd;
+            delete phase4_recv_thd;
+            delete phase6_recv_thd;
+            delete stream_phase_2_thd;
+            delete stream_phase_4_thd;
+
             break;
         }
     }
 
+    is_drain_done = true;
+    drain_thd->join();
+    delete drain_thd;
+
     // close log file
     src_log_file_hdl.close();
     
@@ -596,10 +1516,38 @@ int main(int argc, char* argv[]) {
     delete stream_phase_1_thd;
     delete stream_phase_3_thd;
     delete stream_phase_5_thd;
+    delete sync_mux_obj;
+    for (size_t i = 1; i < dest_pipeline_list.size(); i++) {
+        // the objects of the fan-out dests
+        SyncDestPipeline_t& dest_pipeline = dest_pipeline_list[i];
+        delete dest_pipeline.p2_MQ;
+        delete dest_pipeline.p4_MQ;
+        delete dest_pipeline.phase1_sender;
+        delete dest_pipeline.phase3_sender;
+        delete dest_pipeline.phase5_sender;
+        delete dest_pipeline.phase3_recv;
+        delete dest_pipeline.phase5_recv;
+        delete dest_pipeline.stream_phase_3;
+        delete dest_pipeline.stream_phase_5;
+        delete dest_pipeline.sync_mux;
+    }
+    delete sync_local_obj;
+    delete sync_rate_limiter_obj;
+    delete sync_checkpoint_obj;
+    delete sync_watermark_obj;
 
     Ecall_Destroy_Sync(eid_sgx);
     Ecall_Sync_Enclave_Destroy(eid_sgx);
     SyncOutEnclave::Destroy();
+    delete dest_storage_obj;
+
+    // dump the outside indexes (clean shutdown), the index delta is not needed then
+    delete out_chunk_db;
+    delete out_feature_db;
+    delete dest_chunk_db;
+    delete dest_feature_db;
+    SyncOutEnclave::ResetIndexDelta(opt_type == LOCAL_OPT ? 
+        config.GetFp2ChunkDBName() + "-dest" : config.GetFp2ChunkDBName());
 
     return 0;
 }
\ No newline at end of file
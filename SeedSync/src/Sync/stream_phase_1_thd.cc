@@ -24,7 +24,7 @@ struct timeval phase1_etime;
  */
 StreamPhase1Thd::StreamPhase1Thd(PhaseSender* phase_sender_obj,
     sgx_enclave_id_t eid_sgx) {
-    phase_sender_obj_ = phase_sender_obj;
+    phase_sender_list_.push_back(phase_sender_obj);
     eid_sgx_ = eid_sgx;
 
     // for send batch
@@ -40,6 +40,8 @@ StreamPhase1Thd::StreamPhase1Thd(PhaseSender* phase_sender_obj,
     if (read_recipe_buf_ == NULL) {
         cout << "read recipe buf malloc fail" << endl;
     }
+    checkpoint_batch_num_ = sync_config.GetCheckpointBatchNum();
+    recipe_reader_ = new RecipeReader();
 
     // for debugging
     cryptoObj_ = new CryptoPrimitive(CIPHER_TYPE, HASH_TYPE);
@@ -55,6 +57,7 @@ StreamPhase1Thd::StreamPhase1Thd(PhaseSender* phase_sender_obj,
 StreamPhase1Thd::~StreamPhase1Thd() {
     free(send_batch_buf_.sendBuffer);
     free(read_recipe_buf_);
+    delete recipe_reader_;
 
     EVP_CIPHER_CTX_free(cipherCtx_);
     delete cryptoObj_;
@@ -86,6 +89,9 @@ void StreamPhase1Thd::SyncRequest() {
     for (const auto& file : sorted_files) {
         string recipe_name;
         recipe_name.assign(file.second.filename().c_str(), CHUNK_HASH_SIZE * 2);
+        if (checkpoint_ != nullptr && checkpoint_->IsFileDone(recipe_name)) {
+            continue;
+        }
         // process one recipe to send the batches of chunk FP list
         ProcessOneRecipe(recipe_name);
     }
@@ -97,13 +103,29 @@ void StreamPhase1Thd::SyncRequest() {
  * @brief process one file recipe
  *
  * @param recipe_name
+ * @return true
+ * @return false the file is cut by the stop (resumed from the checkpoint)
  */
-void StreamPhase1Thd::ProcessOneRecipe(string recipe_name) {
+bool StreamPhase1Thd::ProcessOneRecipe(string recipe_name) {
 
 #if (PHASE_BREAKDOWN == 1)
     gettimeofday(&phase1_stime, NULL);
 #endif      
 
+    // the files of a session share the same connection, all the batches 
+    // of this file carry its id
+    last_file_id_ ++;
+    send_batch_buf_.header->clientID = last_file_id_;
+    for (auto phase_sender_obj : phase_sender_list_) {
+        phase_sender_obj->FileStart(recipe_name, last_file_id_);
+    }
+
+    uint64_t resume_offset = 0;
+    if (checkpoint_ != nullptr) {
+        checkpoint_->StartFile(last_file_id_, recipe_name);
+        resume_offset = checkpoint_->GetResumeOffset(recipe_name);
+    }
+
     // do ecall to read the recipe and send the encrypted FP list in batches
 
     // read the recipe file
@@ -111,25 +133,37 @@ void StreamPhase1Thd::ProcessOneRecipe(string recipe_name) {
         + config.GetRecipeSuffix();
     // cout<<"recipe path "<<recipe_path<<endl;
 
-    ifstream recipe_hdl;
-    recipe_hdl.open(recipe_path, ios_base::in | ios_base::binary);
-    if (!recipe_hdl.is_open()) {
+    if (!recipe_reader_->Open(recipe_path)) {
         tool::Logging(my_name_.c_str(), "open recipe file failed %s.\n", recipe_path.c_str());
         exit(EXIT_FAILURE);
     }
+    if (!next_recipe_name_.empty()) {
+        // the current recipe is taken from the prefetch slot, read the next one
+        this->PrefetchRecipe(next_recipe_name_);
+        next_recipe_name_.clear();
+    }
 
-    // read the recipe file in batches
+    // read the recipe file in batches (from the large blocks of the reader)
     FileRecipeHead_t skip_head;
-    recipe_hdl.read((char*)&skip_head, sizeof(FileRecipeHead_t));
+    recipe_reader_->Read((uint8_t*)&skip_head, sizeof(FileRecipeHead_t));
 
     bool file_end = false;
+    bool is_cut = false;
     uint32_t processedRecipeBatchIndex = 0;
-    while (!file_end) {
-        recipe_hdl.read((char*)read_recipe_buf_,
+    if (resume_offset != 0) {
+        // the acked offsets are at the recipe batch boundary (the batches are 
+        // read and verified one by one)
+        processedRecipeBatchIndex = resume_offset / config.GetSendRecipeBatchSize();
+        recipe_reader_->Seek(sizeof(FileRecipeHead_t) + (uint64_t)processedRecipeBatchIndex * 
             config.GetSendRecipeBatchSize() * sizeof(RecipeEntry_t));
-        size_t read_cnt = recipe_hdl.gcount();
+        tool::Logging(my_name_.c_str(), "resume recipe %s from entry %lu.\n", 
+            recipe_name.c_str(), resume_offset);
+    }
+    while (!file_end) {
+        size_t batch_size = config.GetSendRecipeBatchSize() * sizeof(RecipeEntry_t);
+        size_t read_cnt = recipe_reader_->Read(read_recipe_buf_, batch_size);
 
-        file_end = recipe_hdl.eof();
+        file_end = (read_cnt < batch_size);
         size_t recipe_entry_num = read_cnt / sizeof(RecipeEntry_t);
 
         if (read_cnt == 0) {
@@ -137,25 +171,61 @@ void StreamPhase1Thd::ProcessOneRecipe(string recipe_name) {
             break;
         }
 
+        // the fps sent in the earlier batches of this session are dropped
+        size_t fp_num = 0;
         Ecall_Stream_Phase1_ProcessBatch(eid_sgx_, (uint8_t*)recipe_path.c_str(), processedRecipeBatchIndex,
-            read_recipe_buf_, recipe_entry_num, send_batch_buf_.dataBuffer);
+            read_recipe_buf_, recipe_entry_num, send_batch_buf_.dataBuffer, &fp_num);
         processedRecipeBatchIndex++;
         // prepare the send buf
-        send_batch_buf_.header->messageType = SYNC_CHUNK_FP;
-        send_batch_buf_.header->currentItemNum = recipe_entry_num;
-        send_batch_buf_.header->dataSize = recipe_entry_num * CHUNK_HASH_SIZE;
-        phase_sender_obj_->SendBatch(&send_batch_buf_);
+        if (fp_num != 0) {
+            send_batch_buf_.header->messageType = SYNC_CHUNK_FP;
+            send_batch_buf_.header->currentItemNum = fp_num;
+            send_batch_buf_.header->dataSize = fp_num * CHUNK_HASH_SIZE;
+            for (auto phase_sender_obj : phase_sender_list_) {
+                phase_sender_obj->SendBatch(&send_batch_buf_);
+            }
+        }
 
         // reset the send buf
         send_batch_buf_.header->currentItemNum = 0;
         send_batch_buf_.header->dataSize = 0;
+
+        if (checkpoint_ != nullptr && !file_end && 
+            processedRecipeBatchIndex % checkpoint_batch_num_ == 0) {
+            // dest acks the marker once the chunks before it are durable
+            for (auto phase_sender_obj : phase_sender_list_) {
+                phase_sender_obj->Checkpoint(SYNC_CHECKPOINT, last_file_id_, 
+                    processedRecipeBatchIndex * config.GetSendRecipeBatchSize());
+            }
+        }
+
+        if (stop_flag_ != nullptr && *stop_flag_ && !file_end) {
+            // graceful stop: no file end, such that dest does not take the file 
+            // as done; the next session resumes it from the last acked marker
+            if (checkpoint_ != nullptr && 
+                processedRecipeBatchIndex % checkpoint_batch_num_ != 0) {
+                for (auto phase_sender_obj : phase_sender_list_) {
+                    phase_sender_obj->Checkpoint(SYNC_CHECKPOINT, last_file_id_, 
+                        processedRecipeBatchIndex * config.GetSendRecipeBatchSize());
+                }
+            }
+            tool::Logging(my_name_.c_str(), "cut recipe %s at entry %lu for the stop.\n", 
+                recipe_name.c_str(), (uint64_t)processedRecipeBatchIndex * 
+                config.GetSendRecipeBatchSize());
+            is_cut = true;
+            break;
+        }
     }
 
-    // reach recipe end
-    send_batch_buf_.header->messageType = FILE_END_CHUNK_FP;
-    phase_sender_obj_->SendBatch(&send_batch_buf_);
+    if (!is_cut) {
+        // reach recipe end
+        send_batch_buf_.header->messageType = FILE_END_CHUNK_FP;
+        for (auto phase_sender_obj : phase_sender_list_) {
+            phase_sender_obj->SendBatch(&send_batch_buf_);
+        }
+    }
 
-    recipe_hdl.close();
+    recipe_reader_->Close();
 
 #if (PHASE_BREAKDOWN == 1)
     gettimeofday(&phase1_etime, NULL);
@@ -164,25 +234,40 @@ void StreamPhase1Thd::ProcessOneRecipe(string recipe_name) {
     tool::Logging(my_name_.c_str(), "Process time for phase 1: %f.\n", _phase1_process_time);
 #endif
 
-    return;
+    return !is_cut;
 }
 
 /**
  * @brief sync a single file
  *
  * @param file_name
+ * @return true
+ * @return false the file has been synced in the interrupted session, 
+ * or is cut by the stop
+ */
+bool StreamPhase1Thd::SyncRequest(string& file_name)
+{
+    string recipe_name = GetRecipeName(file_name);
+
+    cout << "Sync start for recipe name: " << recipe_name << endl;
+
+    return SyncRecipe(recipe_name);
+}
+
+/**
+ * @brief get the recipe name of a file
+ *
+ * @param file_name
+ * @return string
  */
-void StreamPhase1Thd::SyncRequest(string& file_name)
+string StreamPhase1Thd::GetRecipeName(string& file_name)
 {
     int client_id = 1;
     string full_name = file_name + to_string(client_id);
-    cout << full_name << endl;
     uint8_t file_name_hash[CHUNK_HASH_SIZE] = { 0 };
     cryptoObj_->GenerateHMAC((uint8_t*)&full_name[0],
         full_name.size(), file_name_hash);
 
-    tool::PrintBinaryArray(file_name_hash, CHUNK_HASH_SIZE);
-
     char file_hash_buf[CHUNK_HASH_SIZE * 2 + 1];
     for (uint32_t i = 0; i < CHUNK_HASH_SIZE; i++) {
         sprintf(file_hash_buf + i * 2, "%02x", file_name_hash[i]);
@@ -190,26 +275,44 @@ void StreamPhase1Thd::SyncRequest(string& file_name)
     string recipe_name;
     recipe_name.assign(file_hash_buf, CHUNK_HASH_SIZE * 2);
 
-    cout << "Sync start for recipe name: " << recipe_name << endl;
+    return recipe_name;
+}
 
-    // string recipe_path = config.GetRecipeRootPath() + recipe_name
-    //     + config.GetRecipeSuffix();
+/**
+ * @brief sync a single file by its recipe name
+ *
+ * @param recipe_name
+ * @return true
+ * @return false the file has been synced in the interrupted session, 
+ * or is cut by the stop
+ */
+bool StreamPhase1Thd::SyncRecipe(string& recipe_name)
+{
+    if (checkpoint_ != nullptr && checkpoint_->IsFileDone(recipe_name)) {
+        tool::Logging(my_name_.c_str(), "skip recipe %s synced in the last session.\n", 
+            recipe_name.c_str());
+        next_recipe_name_.clear();
+        return false;
+    }
 
-    // string fullName = inputFile + to_string(clientID);
-    // uint8_t fileNameHash[CHUNK_HASH_SIZE] = {0};
-    // cryptoObj->GenerateHMAC(mdCtx, (uint8_t*)&fullName[0],
-    //     fullName.size(), fileNameHash);
+    return ProcessOneRecipe(recipe_name);
+}
 
-    // char fileHashBuf[CHUNK_HASH_SIZE * 2 + 1];
-    // for (uint32_t i = 0; i < CHUNK_HASH_SIZE; i++) {
-    //     sprintf(fileHashBuf + i * 2, "%02x", recvBuf.dataBuffer[i]);
-    // }
-    // string fileName;
-    // fileName.assign(fileHashBuf, CHUNK_HASH_SIZE * 2);
-    // string recipePath = config.GetRecipeRootPath() +
-    //     fileName + config.GetRecipeSuffix();
+/**
+ * @brief start to read the recipe of the next file (while the current one is 
+ * being sent)
+ *
+ * @param recipe_name
+ */
+void StreamPhase1Thd::PrefetchRecipe(string& recipe_name)
+{
+    if (checkpoint_ != nullptr && checkpoint_->IsFileDone(recipe_name)) {
+        return;
+    }
 
-    ProcessOneRecipe(recipe_name);
+    string recipe_path = config.GetRecipeRootPath() + recipe_name
+        + config.GetRecipeSuffix();
+    recipe_reader_->Prefetch(recipe_path);
 
     return;
 }
@@ -24,7 +24,7 @@ struct timeval phase2_etime;
  * @param out_fp_db 
  * @param eid_sgx 
  */
-StreamPhase2Thd::StreamPhase2Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase1MQ_t>* inputMQ,
+StreamPhase2Thd::StreamPhase2Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ,
     AbsDatabase* out_fp_db, sgx_enclave_id_t eid_sgx) {
     
     phase_sender_obj_ = phase_sender_obj;
@@ -106,7 +106,7 @@ StreamPhase2Thd::~StreamPhase2Thd() {
  */
 void StreamPhase2Thd::Run() {
     bool job_done = false;
-    StreamPhase1MQ_t tmp_chunk_hash;
+    StreamBatchMQ_t tmp_entry;
 
     // tool::Logging(my_name_.c_str(), "the main thread is running.\n");
 
@@ -116,16 +116,31 @@ void StreamPhase2Thd::Run() {
             job_done = true;
         }
 
-        if (inputMQ_->Pop(tmp_chunk_hash)) {
-            if (tmp_chunk_hash.is_file_end == NOT_FILE_END) {
-                // cout<<"pop chunk hash"<<endl;
-                memcpy(process_batch_buf_.dataBuffer + process_batch_buf_.header->dataSize,
-                    tmp_chunk_hash.chunkHash, CHUNK_HASH_SIZE);
-                process_batch_buf_.header->dataSize += CHUNK_HASH_SIZE;
-                process_batch_buf_.header->currentItemNum ++;
+        if (inputMQ_->PopWait(tmp_entry)) {
+            // the outputs belong to the file of the input
+            send_batch_buf_.header->clientID = tmp_entry.file_id;
 
-                if (process_batch_buf_.header->currentItemNum == sync_config.GetMetaBatchSize()) {
-                    ProcessOneBatch();
+            if (tmp_entry.is_file_end == NOT_FILE_END && 
+                tmp_entry.batch->msg_buf.header->messageType == SYNC_CHECKPOINT) {
+                // the outputs of the batches before the marker go first
+                if (send_batch_buf_.header->currentItemNum != 0) {
+                    send_batch_buf_.header->messageType = SYNC_UNI_CHUNK_FP;
+                    phase_sender_obj_->SendBatch(&send_batch_buf_);
+                    send_batch_buf_.header->dataSize = 0;
+                    send_batch_buf_.header->currentItemNum = 0;
+                }
+                phase_sender_obj_->SendBatch(&tmp_entry.batch->msg_buf);
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
+            }
+            else if (tmp_entry.is_file_end == NOT_FILE_END) {
+                // cout<<"pop chunk hash"<<endl;
+                // process the received batch in place
+                SendMsgBuffer_t* in_buf = &tmp_entry.batch->msg_buf;
+                uint32_t item_num = in_buf->header->currentItemNum;
+                for (uint32_t i = 0; i < item_num; i += sync_config.GetMetaBatchSize()) {
+                    uint32_t cur_num = min((uint64_t)(item_num - i), 
+                        sync_config.GetMetaBatchSize());
+                    ProcessOneBatch(in_buf->dataBuffer + i * CHUNK_HASH_SIZE, cur_num);
 
                     SendOneBatch();
 
@@ -135,31 +150,16 @@ void StreamPhase2Thd::Run() {
                     process_batch_buf_.header->dataSize = 0;
                     process_batch_buf_.header->currentItemNum = 0;
                 }
+
+                // recycle the recv buffer
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
             }
-            else if (tmp_chunk_hash.is_file_end == FILE_END) {
+            else if (tmp_entry.is_file_end == FILE_END) {
                 // cout<<"file end phase-2"<<endl;
-                if (process_batch_buf_.header->currentItemNum != 0) {
-                    ProcessOneBatch();
-
-                    SendOneBatch();
-
-                    // cout<<"after sendonebatch (file end)"<<endl;
-
-                    // send the tail
-                    if (send_batch_buf_.header->currentItemNum != 0) {
-                        phase_sender_obj_->SendBatch(&send_batch_buf_);
-                        // tool::Logging("phase2 sent tail batch size", "%d\n", send_batch_buf_.header->currentItemNum);
-                        send_batch_buf_.header->dataSize = 0;
-                        send_batch_buf_.header->currentItemNum = 0;
-                    }
-
-                    // reset the batch buffer
-                    process_batch_buf_.header->dataSize = 0;
-                    process_batch_buf_.header->currentItemNum = 0;
-                }
 
                 // send the tail
                 if (send_batch_buf_.header->currentItemNum != 0) {
+                    send_batch_buf_.header->messageType = SYNC_UNI_CHUNK_FP;
                     phase_sender_obj_->SendBatch(&send_batch_buf_);
                     send_batch_buf_.header->dataSize = 0;
                     send_batch_buf_.header->currentItemNum = 0;
@@ -194,10 +194,13 @@ void StreamPhase2Thd::Run() {
 }
 
 /**
- * @brief process one batch of fp list
+ * @brief process one batch of fp list (in place), the uni fp list is 
+ * written into process_batch_buf_
  * 
+ * @param fp_list 
+ * @param fp_num 
  */
-void StreamPhase2Thd::ProcessOneBatch() {
+void StreamPhase2Thd::ProcessOneBatch(uint8_t* fp_list, uint32_t fp_num) {
 #if (PHASE_BREAKDOWN == 1)    
     gettimeofday(&phase2_stime, NULL);
 #endif
@@ -210,15 +213,13 @@ void StreamPhase2Thd::ProcessOneBatch() {
 
     // do ecall: input is recv FP list, output is uni_fp_list
 #if (RECOVER_CHECK == 0)
-    Ecall_Stream_Phase2_ProcessBatch_NaiveStreamCache(sgx_eid_, process_batch_buf_.dataBuffer, 
-        process_batch_buf_.header->currentItemNum,
+    Ecall_Stream_Phase2_ProcessBatch_NaiveStreamCache(sgx_eid_, fp_list, fp_num,
         process_batch_buf_.dataBuffer, &uni_fp_num, 
         &req_container_);
 #endif
 
 #if (RECOVER_CHECK == 1)
-    Ecall_Stream_Phase2_ProcessBatch_NaiveStreamCache_Debug(sgx_eid_, process_batch_buf_.dataBuffer, 
-        process_batch_buf_.header->currentItemNum,
+    Ecall_Stream_Phase2_ProcessBatch_NaiveStreamCache_Debug(sgx_eid_, fp_list, fp_num,
         process_batch_buf_.dataBuffer, &uni_fp_num, 
         &req_container_, &debug_out_query_, single_out_query);
 #endif
@@ -16,6 +16,8 @@ struct timeval phase3_stime;
 struct timeval phase3_etime;
 #endif
 
+std::mutex StreamPhase3Thd::ecall_mutex_;
+
 /**
  * @brief Construct a new Stream Phase 3 Thd:: Stream Phase 3 Thd object
  * 
@@ -24,7 +26,7 @@ struct timeval phase3_etime;
  * @param out_fp_db 
  * @param eid_sgx 
  */
-StreamPhase3Thd::StreamPhase3Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase2MQ_t>* inputMQ,
+StreamPhase3Thd::StreamPhase3Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ,
     AbsDatabase* out_fp_db, sgx_enclave_id_t eid_sgx) {
     
     phase_sender_obj_ = phase_sender_obj;
@@ -40,9 +42,6 @@ StreamPhase3Thd::StreamPhase3Thd(PhaseSender* phase_sender_obj, MessageQueue<Str
     send_batch_buf_.header->currentItemNum = 0;
     send_batch_buf_.header->dataSize = 0;
 
-    recv_buf_ = (uint8_t*)malloc(sync_config.GetMetaBatchSize() * (CHUNK_HASH_SIZE + SUPER_FEATURE_PER_CHUNK * sizeof(uint64_t)));
-    recv_num_ = 0;
-    recv_offset_ = 0;
 
     // for chunk outquery
     out_chunk_query_.OutChunkQueryBase = (OutChunkQueryEntry_t*) malloc(sizeof(OutChunkQueryEntry_t) * 
@@ -69,7 +68,6 @@ StreamPhase3Thd::StreamPhase3Thd(PhaseSender* phase_sender_obj, MessageQueue<Str
  */
 StreamPhase3Thd::~StreamPhase3Thd() {
     free(send_batch_buf_.sendBuffer);
-    free(recv_buf_);
     free(out_chunk_query_.OutChunkQueryBase);
     free(req_containers_.idBuffer);
     for (size_t i = 0; i < CONTAINER_CAPPING_VALUE; i++) {
@@ -84,7 +82,7 @@ StreamPhase3Thd::~StreamPhase3Thd() {
  */
 void StreamPhase3Thd::Run() {
     bool job_done = false;
-    StreamPhase2MQ_t tmp_uni_hash;
+    StreamBatchMQ_t tmp_entry;
 
     // tool::Logging(my_name_.c_str(), "the main thread is running.\n");
 
@@ -94,28 +92,34 @@ void StreamPhase3Thd::Run() {
             job_done = true;
         }
 
-        if (inputMQ_->Pop(tmp_uni_hash)) {
-            if (tmp_uni_hash.is_file_end == NOT_FILE_END) {
+        if (inputMQ_->PopWait(tmp_entry)) {
+            // the outputs belong to the file of the input
+            send_batch_buf_.header->clientID = tmp_entry.file_id;
+
+            if (tmp_entry.is_file_end == NOT_FILE_END && 
+                tmp_entry.batch->msg_buf.header->messageType == SYNC_CHECKPOINT) {
+                // pass the checkpoint marker on (the outputs of the earlier batches
+                // have been sent)
+                phase_sender_obj_->SendBatch(&tmp_entry.batch->msg_buf);
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
+            }
+            else if (tmp_entry.is_file_end == NOT_FILE_END) {
                 // cout<<"pop uni hash"<<endl;
-                memcpy(recv_buf_ + recv_offset_, tmp_uni_hash.chunkHash, CHUNK_HASH_SIZE);
-                recv_offset_ += CHUNK_HASH_SIZE;
-                recv_num_ ++;
-
-                if (recv_num_ == sync_config.GetMetaBatchSize()) {
-                    ProcessOneBatch();
-                    recv_num_ = 0;
-                    recv_offset_ = 0;
+                // process the received batch in place
+                SendMsgBuffer_t* in_buf = &tmp_entry.batch->msg_buf;
+                uint32_t item_num = in_buf->header->currentItemNum;
+                for (uint32_t i = 0; i < item_num; i += sync_config.GetMetaBatchSize()) {
+                    uint32_t cur_num = min((uint64_t)(item_num - i), 
+                        sync_config.GetMetaBatchSize());
+                    ProcessOneBatch(in_buf->dataBuffer + i * CHUNK_HASH_SIZE, cur_num);
                 }
+
+                // recycle the recv buffer
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
             } 
-            else if (tmp_uni_hash.is_file_end == FILE_END) {
+            else if (tmp_entry.is_file_end == FILE_END) {
                 // cout<<"file end phase-3"<<endl;
 
-                if (recv_num_ != 0) {
-                    ProcessOneBatch();
-                    recv_num_ = 0;
-                    recv_offset_ = 0;
-                }
-
                 // send the file end flag
                 send_batch_buf_.header->messageType = FILE_END_FEATURE;
                 phase_sender_obj_->SendBatch(&send_batch_buf_);
@@ -123,8 +127,7 @@ void StreamPhase3Thd::Run() {
 #if (PHASE_BREAKDOWN == 1)
                 tool::Logging(my_name_.c_str(), "Process time for phase 3: %f.\n", _phase3_process_time);
 #endif                
-                job_done = true;
-                 
+                // the next file comes in the same session
             }
         }
 
@@ -133,9 +136,8 @@ void StreamPhase3Thd::Run() {
         }
     }
 
-    // send the end flag
-    send_batch_buf_.header->messageType = SYNC_FEATURE_END;
-    phase_sender_obj_->SendBatch(&send_batch_buf_);
+    // no more files in this session
+    phase_sender_obj_->FileEnd();
 
     // tool::Logging(my_name_.c_str(), "StreamPhase3Thd exits.\n");
 
@@ -143,10 +145,21 @@ void StreamPhase3Thd::Run() {
 }
 
 /**
- * @brief process one batch of uni fp list, return the features
+ * @brief Set the Done Flag object
  * 
  */
-void StreamPhase3Thd::ProcessOneBatch() {
+void StreamPhase3Thd::SetDoneFlag() {
+    inputMQ_->done_ = true;
+    return ;
+}
+
+/**
+ * @brief process one batch of uni fp list (in place), return the features
+ * 
+ * @param unifp_list 
+ * @param unifp_num 
+ */
+void StreamPhase3Thd::ProcessOneBatch(uint8_t* unifp_list, uint32_t unifp_num) {
 #if (PHASE_BREAKDOWN == 1)    
     gettimeofday(&phase3_stime, NULL);
 #endif    
@@ -155,10 +168,13 @@ void StreamPhase3Thd::ProcessOneBatch() {
     req_containers_.idNum = 0;
 
     // do ecall: input is recv uni FP list, output is [features + fps]
-    send_batch_buf_.header->currentItemNum = recv_num_;
-    Ecall_Stream_Phase3_ProcessBatch(sgx_eid_, recv_buf_, recv_num_,
-        &req_containers_, &out_chunk_query_, 
-        send_batch_buf_.dataBuffer, send_batch_buf_.header->currentItemNum);
+    send_batch_buf_.header->currentItemNum = unifp_num;
+    {
+        std::lock_guard<std::mutex> lck(ecall_mutex_);
+        Ecall_Stream_Phase3_ProcessBatch(sgx_eid_, unifp_list, unifp_num,
+            &req_containers_, &out_chunk_query_, 
+            send_batch_buf_.dataBuffer, send_batch_buf_.header->currentItemNum);
+    }
     
     // cout<<"feature header "<<send_batch_buf_.header->currentItemNum<<endl;
 
@@ -23,7 +23,7 @@ struct timeval phase4_etime;
  * @param inputMQ 
  * @param eid_sgx 
  */
-StreamPhase4Thd::StreamPhase4Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase3MQ_t>* inputMQ,
+StreamPhase4Thd::StreamPhase4Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ,
     sgx_enclave_id_t eid_sgx) {
     
     // send_thd_obj_ = send_thd_obj;
@@ -56,7 +56,8 @@ StreamPhase4Thd::~StreamPhase4Thd() {
  */
 void StreamPhase4Thd::Run() {
     bool job_done = false;
-    StreamPhase3MQ_t tmp_entry;
+    StreamBatchMQ_t tmp_entry;
+    uint32_t feature_item_size = SUPER_FEATURE_PER_CHUNK * sizeof(uint64_t) + CHUNK_HASH_SIZE;
 
     // tool::Logging(my_name_.c_str(), "the main thread is running.\n");
 
@@ -66,33 +67,36 @@ void StreamPhase4Thd::Run() {
             job_done = true;
         }
 
-        if (inputMQ_->Pop(tmp_entry)) {
-            if (tmp_entry.is_file_end == NOT_FILE_END) {
+        if (inputMQ_->PopWait(tmp_entry)) {
+            // the outputs belong to the file of the input
+            send_batch_buf_.header->clientID = tmp_entry.file_id;
+
+            if (tmp_entry.is_file_end == NOT_FILE_END && 
+                tmp_entry.batch->msg_buf.header->messageType == SYNC_CHECKPOINT) {
+                // the chunks before the marker are checked by phase-6
+                if (sync_data_writer_obj_ != nullptr) {
+                    sync_data_writer_obj_->MarkCheckpoint(tmp_entry.file_id);
+                }
+                phase_sender_obj_->SendBatch(&tmp_entry.batch->msg_buf);
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
+            }
+            else if (tmp_entry.is_file_end == NOT_FILE_END) {
                 // cout<<"pop features"<<endl;
-                memcpy(send_batch_buf_.dataBuffer + send_batch_buf_.header->dataSize, 
-                    tmp_entry.features, SUPER_FEATURE_PER_CHUNK * sizeof(uint64_t));
-                send_batch_buf_.header->dataSize += SUPER_FEATURE_PER_CHUNK * sizeof(uint64_t);
-                memcpy(send_batch_buf_.dataBuffer + send_batch_buf_.header->dataSize,
-                    tmp_entry.chunkHash, CHUNK_HASH_SIZE);
-                send_batch_buf_.header->dataSize += CHUNK_HASH_SIZE;
-                send_batch_buf_.header->currentItemNum ++;
-
-                if (send_batch_buf_.header->currentItemNum == sync_config.GetDataBatchSize()) {
-                    ProcessOneBatch();
-                    send_batch_buf_.header->currentItemNum = 0;
-                    send_batch_buf_.header->dataSize = 0;
+                // process the received batch in place
+                SendMsgBuffer_t* in_buf = &tmp_entry.batch->msg_buf;
+                uint32_t item_num = in_buf->header->currentItemNum;
+                for (uint32_t i = 0; i < item_num; i += sync_config.GetDataBatchSize()) {
+                    uint32_t cur_num = min((uint64_t)(item_num - i), 
+                        sync_config.GetDataBatchSize());
+                    ProcessOneBatch(in_buf->dataBuffer + i * feature_item_size, cur_num);
                 }
-                
+
+                // recycle the recv buffer
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
             } 
             else if (tmp_entry.is_file_end == FILE_END) {
                 // cout<<"file end phase-4"<<endl;
 
-                if (send_batch_buf_.header->currentItemNum != 0) {
-                    ProcessOneBatch();
-                    send_batch_buf_.header->currentItemNum = 0;
-                    send_batch_buf_.header->dataSize = 0;
-                }
-
                 // send the file end flag
                 send_batch_buf_.header->messageType = FILE_END_BASE_HASH;
                 phase_sender_obj_->SendBatch(&send_batch_buf_);
@@ -120,23 +124,30 @@ void StreamPhase4Thd::Run() {
 }
 
 /**
- * @brief process one batch of uni fp list, return the features
+ * @brief process one batch of features (in place), return the base hashes
  * 
+ * @param feature_list 
+ * @param feature_num 
  */
-void StreamPhase4Thd::ProcessOneBatch() {
+void StreamPhase4Thd::ProcessOneBatch(uint8_t* feature_list, uint32_t feature_num) {
 #if (PHASE_BREAKDOWN == 1)
     gettimeofday(&phase4_stime, NULL);
 #endif
 
     // ecall
     uint32_t out_item_num = 0;
-    Ecall_Stream_Phase4_ProcessBatch(sgx_eid_, send_batch_buf_.dataBuffer, 
-        send_batch_buf_.header->currentItemNum, 
+    Ecall_Stream_Phase4_ProcessBatch(sgx_eid_, feature_list, feature_num, 
         send_batch_buf_.dataBuffer, 
         out_item_num);
 
     // tmp fix
-    out_item_num = send_batch_buf_.header->currentItemNum;
+    out_item_num = feature_num;
+
+    // record the chunks to be written for the integrity check in phase-6
+    if (sync_data_writer_obj_ != nullptr) {
+        sync_data_writer_obj_->AddExpectedChunk(send_batch_buf_.header->clientID,
+            send_batch_buf_.dataBuffer, out_item_num);
+    }
 
     // prepare the send buf
     send_batch_buf_.header->messageType = SYNC_BASE_HASH;
@@ -164,6 +175,16 @@ void StreamPhase4Thd::SetDoneFlag() {
     return ;
 }
 
+/**
+ * @brief Set the Sync Data Writer object
+ * 
+ * @param sync_data_writer_obj 
+ */
+void StreamPhase4Thd::SetSyncDataWriter(SyncDataWriter* sync_data_writer_obj) {
+    sync_data_writer_obj_ = sync_data_writer_obj;
+    return ;
+}
+
 /**
  * @brief insert the batch into send MQ
  * 
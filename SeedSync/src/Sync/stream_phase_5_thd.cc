@@ -16,6 +16,8 @@ struct timeval phase5_stime;
 struct timeval phase5_etime;
 #endif
 
+std::mutex StreamPhase5Thd::ecall_mutex_;
+
 /**
  * @brief Construct a new Stream Phase 5 Thd:: Stream Phase 5 Thd object
  * 
@@ -24,7 +26,7 @@ struct timeval phase5_etime;
  * @param out_fp_db 
  * @param eid_sgx 
  */
-StreamPhase5Thd::StreamPhase5Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamPhase4MQ_t>* inputMQ, 
+StreamPhase5Thd::StreamPhase5Thd(PhaseSender* phase_sender_obj, MessageQueue<StreamBatchMQ_t>* inputMQ, 
     AbsDatabase* out_fp_db, sgx_enclave_id_t eid_sgx) {
     
     phase_sender_obj_ = phase_sender_obj;
@@ -32,13 +34,6 @@ StreamPhase5Thd::StreamPhase5Thd(PhaseSender* phase_sender_obj, MessageQueue<Str
     out_fp_db_ = out_fp_db;
     sgx_eid_ = eid_sgx;
 
-    // for recv batch
-    recv_batch_buf_.sendBuffer = (uint8_t*)malloc(sizeof(NetworkHead_t) + sync_config.GetMetaBatchSize() * sizeof(StreamPhase4MQ_t));
-    recv_batch_buf_.dataBuffer = recv_batch_buf_.sendBuffer + sizeof(NetworkHead_t);
-    recv_batch_buf_.header = (NetworkHead_t*) recv_batch_buf_.sendBuffer;
-    recv_batch_buf_.header->currentItemNum = 0;
-    recv_batch_buf_.header->dataSize = 0;
-
     // for send batch
     send_batch_buf_.sendBuffer = (uint8_t*)malloc(sizeof(NetworkHead_t) + sync_config.GetDataBatchSize() * (MAX_CHUNK_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + CHUNK_HASH_SIZE) * sizeof(uint8_t));
     // cout << "phase-5 allocate " << sizeof(NetworkHead_t) + sync_config.GetDataBatchSize() * (MAX_CHUNK_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + CHUNK_HASH_SIZE) << endl;
@@ -71,7 +66,6 @@ StreamPhase5Thd::StreamPhase5Thd(PhaseSender* phase_sender_obj, MessageQueue<Str
  * 
  */
 StreamPhase5Thd::~StreamPhase5Thd() {
-    free(recv_batch_buf_.sendBuffer);
     free(send_batch_buf_.sendBuffer);
     free(out_chunk_query_.OutChunkQueryBase);
 
@@ -88,7 +82,7 @@ StreamPhase5Thd::~StreamPhase5Thd() {
  */
 void StreamPhase5Thd::Run() {
     bool job_done = false;
-    StreamPhase4MQ_t tmp_entry;
+    StreamBatchMQ_t tmp_entry;
 
     // tool::Logging(my_name_.c_str(), "The main thread is running.\n");
 
@@ -97,34 +91,37 @@ void StreamPhase5Thd::Run() {
             job_done = true;
         }
 
-        if (inputMQ_->Pop(tmp_entry)) {
-            if (tmp_entry.is_file_end == NOT_FILE_END) {
+        if (inputMQ_->PopWait(tmp_entry)) {
+            // the outputs belong to the file of the input
+            send_batch_buf_.header->clientID = tmp_entry.file_id;
+
+            if (tmp_entry.is_file_end == NOT_FILE_END && 
+                tmp_entry.batch->msg_buf.header->messageType == SYNC_CHECKPOINT) {
+                // pass the checkpoint marker on (the outputs of the earlier batches
+                // have been sent)
+                phase_sender_obj_->SendBatch(&tmp_entry.batch->msg_buf);
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
+            }
+            else if (tmp_entry.is_file_end == NOT_FILE_END) {
                 // cout<<"pop chunk hash info"<<endl;
-                memcpy(recv_batch_buf_.dataBuffer + recv_batch_buf_.header->dataSize, 
-                    &tmp_entry, sizeof(StreamPhase4MQ_t));
-                recv_batch_buf_.header->dataSize += sizeof(StreamPhase4MQ_t);
-                recv_batch_buf_.header->currentItemNum ++;
-
-                if (recv_batch_buf_.header->currentItemNum == sync_config.GetDataBatchSize()) {
-                    ProcessOneBatch();
-                    recv_batch_buf_.header->currentItemNum = 0;
-                    recv_batch_buf_.header->dataSize = 0;
+                // process the received batch in place
+                SendMsgBuffer_t* in_buf = &tmp_entry.batch->msg_buf;
+                uint32_t item_num = in_buf->header->currentItemNum;
+                for (uint32_t i = 0; i < item_num; i += sync_config.GetDataBatchSize()) {
+                    uint32_t cur_num = min((uint64_t)(item_num - i), 
+                        sync_config.GetDataBatchSize());
+                    ProcessOneBatch(in_buf->dataBuffer + i * sizeof(StreamPhase4MQ_t), 
+                        cur_num * sizeof(StreamPhase4MQ_t));
                     send_batch_buf_.header->currentItemNum = 0;
                     send_batch_buf_.header->dataSize = 0;
                 }
 
+                // recycle the recv buffer
+                tmp_entry.batch->pool->Release(tmp_entry.batch);
             }
             else if (tmp_entry.is_file_end == FILE_END) {
                 // cout<<"file end phase-5"<<endl;
 
-                if (recv_batch_buf_.header->currentItemNum != 0) {
-                    ProcessOneBatch();
-                    recv_batch_buf_.header->currentItemNum = 0;
-                    recv_batch_buf_.header->dataSize = 0;
-                    send_batch_buf_.header->currentItemNum = 0;
-                    send_batch_buf_.header->dataSize = 0;
-                }
-
                 // send the end flag
                 send_batch_buf_.header->messageType = FILE_END_SYNC_DATA;
                 phase_sender_obj_->SendBatch(&send_batch_buf_);
@@ -133,9 +130,7 @@ void StreamPhase5Thd::Run() {
                 tool::Logging(my_name_.c_str(), "Process time for phase 5: %f.\n", _phase5_process_time);
 #endif   
 
-                sleep(10);
-                
-                job_done = true;
+                // wait for the integrity check result of dest (may resend)
             }
         }
 
@@ -144,9 +139,8 @@ void StreamPhase5Thd::Run() {
         }
     }
 
-    // send the end flag
-    send_batch_buf_.header->messageType = SYNC_DATA_END_FLAG;
-    phase_sender_obj_->SendBatch(&send_batch_buf_);
+    // no more files in this session
+    phase_sender_obj_->FileEnd();
 
     // tool::Logging(my_name_.c_str(), "StreamPhase5Thd exits.\n");
 
@@ -154,17 +148,22 @@ void StreamPhase5Thd::Run() {
 }
 
 /**
- * @brief process one batch of uni fp list, return the features
+ * @brief process one batch of base hashes (in place), return the data
  * 
+ * @param in_buf 
+ * @param in_size 
  */
-void StreamPhase5Thd::ProcessOneBatch() {
+void StreamPhase5Thd::ProcessOneBatch(uint8_t* in_buf, uint32_t in_size) {
 #if (PHASE_BREAKDOWN == 1)    
     gettimeofday(&phase5_stime, NULL);
 #endif    
     // do ecall
-    Ecall_Stream_Phase5_ProcessBatch(sgx_eid_, recv_batch_buf_.dataBuffer, 
-        recv_batch_buf_.header->dataSize, &req_containers_, &out_chunk_query_, 
-        send_batch_buf_.dataBuffer, &send_batch_buf_.header->dataSize);
+    {
+        std::lock_guard<std::mutex> lck(ecall_mutex_);
+        Ecall_Stream_Phase5_ProcessBatch(sgx_eid_, in_buf, in_size, 
+            &req_containers_, &out_chunk_query_, 
+            send_batch_buf_.dataBuffer, &send_batch_buf_.header->dataSize);
+    }
 
     // try parallel ecall
 #if (PARALLEL_ECALL == 1)
@@ -197,6 +196,15 @@ void StreamPhase5Thd::ProcessOneBatch() {
     return ;    
 }
 
+/**
+ * @brief Set the Done Flag object
+ * 
+ */
+void StreamPhase5Thd::SetDoneFlag() {
+    inputMQ_->done_ = true;
+    return ;
+}
+
 /**
  * @brief insert the batch into send MQ
  * 
@@ -0,0 +1,88 @@
+/**
+ * @file sync_buffer_pool.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_buffer_pool.h
+ * @version 0.1
+ * @date 2024-08-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_buffer_pool.h"
+
+/**
+ * @brief Construct a new Sync Buffer Pool object
+ *
+ * @param buf_size the size of each buffer (including the header)
+ * @param buf_num
+ */
+SyncBufferPool::SyncBufferPool(uint64_t buf_size, uint32_t buf_num) {
+    buf_size_ = buf_size;
+
+    for (uint32_t i = 0; i < buf_num; i++) {
+        SyncBatch_t* batch = new SyncBatch_t;
+        batch->msg_buf.sendBuffer = (uint8_t*) malloc(buf_size_);
+        batch->msg_buf.header = (NetworkHead_t*) batch->msg_buf.sendBuffer;
+        batch->msg_buf.dataBuffer = batch->msg_buf.sendBuffer + sizeof(NetworkHead_t);
+        batch->msg_buf.header->currentItemNum = 0;
+        batch->msg_buf.header->dataSize = 0;
+        batch->pool = this;
+
+        all_batch_list_.push_back(batch);
+        free_batch_list_.push_back(batch);
+    }
+}
+
+/**
+ * @brief Destroy the Sync Buffer Pool object
+ *
+ */
+SyncBufferPool::~SyncBufferPool() {
+    if (free_batch_list_.size() != all_batch_list_.size()) {
+        tool::Logging(my_name_.c_str(), "%lu buffers are still in use.\n",
+            all_batch_list_.size() - free_batch_list_.size());
+    }
+
+    for (auto batch : all_batch_list_) {
+        free(batch->msg_buf.sendBuffer);
+        delete batch;
+    }
+}
+
+/**
+ * @brief get a free buffer (wait if all buffers are in use)
+ *
+ * @return SyncBatch_t*
+ */
+SyncBatch_t* SyncBufferPool::Get() {
+    std::unique_lock<std::mutex> lck(pool_mutex_);
+    pool_cond_.wait(lck, [this] {
+        return !free_batch_list_.empty();
+    });
+
+    SyncBatch_t* batch = free_batch_list_.back();
+    free_batch_list_.pop_back();
+
+    return batch;
+}
+
+/**
+ * @brief recycle the buffer (by its single owner, the phase thread 
+ * processing it)
+ *
+ * @param batch
+ */
+void SyncBufferPool::Release(SyncBatch_t* batch) {
+    {
+        std::lock_guard<std::mutex> lck(pool_mutex_);
+        free_batch_list_.push_back(batch);
+    }
+    pool_cond_.notify_one();
+
+    if (release_callback_) {
+        release_callback_();
+    }
+
+    return ;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file sync_checkpoint.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_checkpoint.h
+ * @version 0.1
+ * @date 2024-09-05
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_checkpoint.h"
+
+/**
+ * @brief Construct a new Sync Checkpoint object
+ *
+ * @param checkpoint_name the manifest path
+ * @param dest_num the num of dests sharing the source pipeline
+ */
+SyncCheckpoint::SyncCheckpoint(string checkpoint_name, uint32_t dest_num) {
+    checkpoint_name_ = checkpoint_name;
+    dest_num_ = dest_num;
+    this->Load();
+}
+
+/**
+ * @brief Destroy the Sync Checkpoint object
+ *
+ */
+SyncCheckpoint::~SyncCheckpoint() {
+}
+
+/**
+ * @brief load the manifest of the last (interrupted) session
+ *
+ */
+void SyncCheckpoint::Load() {
+    ifstream checkpoint_hdl;
+    checkpoint_hdl.open(checkpoint_name_, ios_base::in);
+    if (!checkpoint_hdl.is_open()) {
+        // no interrupted session
+        return ;
+    }
+
+    string line;
+    while (getline(checkpoint_hdl, line)) {
+        istringstream line_stream(line);
+        string type;
+        string recipe_name;
+        line_stream >> type >> recipe_name;
+        if (type == "done") {
+            done_file_set_.insert(recipe_name);
+        }
+        else if (type == "offset") {
+            uint64_t entry_offset = 0;
+            line_stream >> entry_offset;
+            file_offset_list_[recipe_name] = entry_offset;
+        }
+    }
+    checkpoint_hdl.close();
+
+    tool::Logging(my_name_.c_str(), "resume the last session: %lu files done, %lu files partly done.\n",
+        done_file_set_.size(), file_offset_list_.size());
+
+    return ;
+}
+
+/**
+ * @brief persist the manifest (hold checkpoint_mutex_)
+ *
+ */
+void SyncCheckpoint::Persist() {
+    string content;
+    for (auto& recipe_name : done_file_set_) {
+        content += "done " + recipe_name + "\n";
+    }
+    for (auto& file_offset : file_offset_list_) {
+        content += "offset " + file_offset.first + " " + to_string(file_offset.second) + "\n";
+    }
+
+    // a crash keeps the old checkpoint
+    if (!tool::PersistFile(checkpoint_name_, content)) {
+        tool::Logging(my_name_.c_str(), "fail to write the checkpoint.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return ;
+}
+
+/**
+ * @brief check whether the recipe has been synced completely
+ *
+ * @param recipe_name
+ * @return true
+ * @return false
+ */
+bool SyncCheckpoint::IsFileDone(string& recipe_name) {
+    std::lock_guard<std::mutex> lck(checkpoint_mutex_);
+    return done_file_set_.find(recipe_name) != done_file_set_.end();
+}
+
+/**
+ * @brief get the recipe entry to resume from
+ *
+ * @param recipe_name
+ * @return uint64_t 0 if not synced before
+ */
+uint64_t SyncCheckpoint::GetResumeOffset(string& recipe_name) {
+    std::lock_guard<std::mutex> lck(checkpoint_mutex_);
+    auto find_it = file_offset_list_.find(recipe_name);
+    if (find_it == file_offset_list_.end()) {
+        return 0;
+    }
+    return find_it->second;
+}
+
+/**
+ * @brief record the recipe of a file id (phase-1)
+ *
+ * @param file_id
+ * @param recipe_name
+ */
+void SyncCheckpoint::StartFile(uint32_t file_id, string& recipe_name) {
+    std::lock_guard<std::mutex> lck(checkpoint_mutex_);
+    inflight_file_list_[file_id] = recipe_name;
+    dest_offset_list_[file_id].assign(dest_num_, 0);
+    return ;
+}
+
+/**
+ * @brief dest has made the chunks before the recipe entry durable
+ *
+ * @param file_id
+ * @param entry_offset
+ * @param dest_idx
+ */
+void SyncCheckpoint::Ack(uint32_t file_id, uint64_t entry_offset, uint32_t dest_idx) {
+    std::lock_guard<std::mutex> lck(checkpoint_mutex_);
+    auto find_it = inflight_file_list_.find(file_id);
+    if (find_it == inflight_file_list_.end()) {
+        tool::Logging(my_name_.c_str(), "recv the checkpoint ack of unknown file %u.\n", file_id);
+        return ;
+    }
+
+    // the entries acked by all the dests
+    vector<uint64_t>& dest_offset = dest_offset_list_[file_id];
+    dest_offset[dest_idx] = max(dest_offset[dest_idx], entry_offset);
+    entry_offset = *std::min_element(dest_offset.begin(), dest_offset.end());
+
+    uint64_t& file_offset = file_offset_list_[find_it->second];
+    if (entry_offset <= file_offset) {
+        // e.g., the markers resent in a resumed recipe
+        return ;
+    }
+    file_offset = entry_offset;
+    this->Persist();
+
+    return ;
+}
+
+/**
+ * @brief dest has checked all the chunks of the file
+ *
+ * @param file_id
+ * @param dest_idx
+ */
+void SyncCheckpoint::FileDone(uint32_t file_id, uint32_t dest_idx) {
+    std::lock_guard<std::mutex> lck(checkpoint_mutex_);
+    auto find_it = inflight_file_list_.find(file_id);
+    if (find_it == inflight_file_list_.end()) {
+        tool::Logging(my_name_.c_str(), "unknown done file %u.\n", file_id);
+        return ;
+    }
+
+    vector<uint64_t>& dest_offset = dest_offset_list_[file_id];
+    dest_offset[dest_idx] = UINT64_MAX;
+    if (*std::min_element(dest_offset.begin(), dest_offset.end()) != UINT64_MAX) {
+        // wait for the other dests (the acked offsets are kept)
+        return ;
+    }
+
+    done_file_set_.insert(find_it->second);
+    file_offset_list_.erase(find_it->second);
+    inflight_file_list_.erase(find_it);
+    dest_offset_list_.erase(file_id);
+    this->Persist();
+
+    return ;
+}
+
+/**
+ * @brief remove the manifest after all the files of the session are done
+ *
+ */
+void SyncCheckpoint::Clear() {
+    std::lock_guard<std::mutex> lck(checkpoint_mutex_);
+    if (inflight_file_list_.size() != 0) {
+        // e.g., dest closes the session in the middle
+        tool::Logging(my_name_.c_str(), "keep the checkpoint, %lu files are unfinished.\n",
+            inflight_file_list_.size());
+        return ;
+    }
+
+    done_file_set_.clear();
+    file_offset_list_.clear();
+    if (remove(checkpoint_name_.c_str()) != 0 && errno != ENOENT) {
+        tool::Logging(my_name_.c_str(), "fail to remove the checkpoint.\n");
+    }
+
+    return ;
+}
@@ -73,14 +73,143 @@ void SyncConfigure::ReadConfig(string path) {
     p4_recv_port_ = root.get<int>("Cloud_2.p4_recv_port");
     p4_send_port_ = root.get<int>("Cloud_2.p4_send_port");
     p6_recv_port_ = root.get<int>("Cloud_2.p6_recv_port");
+    mux_recv_port_ = root.get<int>("Cloud_2.mux_recv_port");
     file_root_path_2_ = root.get<string>("Cloud_2.file_root_path");
+
+    // fan-out settings (the extra dests of the source)
+    SyncDest_t cloud_2_dest;
+    cloud_2_dest.id = id_2_;
+    cloud_2_dest.ip = ip_2_;
+    cloud_2_dest.mux_recv_port = mux_recv_port_;
+    dest_list_.push_back(cloud_2_dest);
+    for (auto& item : root.get_child("Fanout.dest_list")) {
+        SyncDest_t dest;
+        dest.id = item.second.get<int>("id");
+        dest.ip = item.second.get<string>("ip");
+        dest.mux_recv_port = item.second.get<int>("mux_recv_port");
+        dest_list_.push_back(dest);
+    }
     
     // sender settings
     send_data_batch_size_ = root.get<uint64_t>("Sender.send_data_batch_size");
     send_meta_batch_size_ = root.get<uint64_t>("Sender.send_meta_batch_size");
+    max_inflight_files_ = root.get<uint64_t>("Sender.max_inflight_files");
+    if (max_inflight_files_ == 0) {
+        tool::Logging(my_name_.c_str(), "max_inflight_files should be at least 1.\n");
+        exit(EXIT_FAILURE);
+    }
+    recipe_read_size_ = root.get<uint64_t>("Sender.recipe_read_size");
+    if (recipe_read_size_ == 0 || recipe_read_size_ % RECIPE_IO_ALIGN != 0) {
+        tool::Logging(my_name_.c_str(), "recipe_read_size should be a multiple of %u.\n",
+            RECIPE_IO_ALIGN);
+        exit(EXIT_FAILURE);
+    }
+    is_recipe_direct_io_ = root.get<bool>("Sender.recipe_direct_io");
+    sent_fp_cache_item_ = root.get<uint64_t>("Sender.sent_fp_cache_item");
 
     // enclave cache size
     enclave_cache_size_ = root.get<uint64_t>("EnclaveCache.enclave_cache_item");
 
+    // max depth of the delta chain in a sync batch
+    max_delta_depth_ = root.get<uint64_t>("Delta.max_delta_depth");
+
+    // max rounds of resending the chunks failing the integrity check
+    max_resend_round_ = root.get<uint64_t>("Integrity.max_resend_round");
+
+    // network settings
+    enable_mux_ = root.get<bool>("Network.enable_mux");
+    send_buf_size_ = root.get<uint64_t>("Network.send_buf_size");
+    flow_window_ = root.get<uint64_t>("Network.flow_window");
+    enable_ktls_ = root.get<bool>("Network.enable_ktls");
+    if (dest_list_.size() > 1 && !enable_mux_) {
+        // the source listens on fixed phase ports without the mux connection
+        tool::Logging(my_name_.c_str(), "fan-out to %lu dests requires enable_mux.\n",
+            dest_list_.size());
+        exit(EXIT_FAILURE);
+    }
+
+    // rate limit settings
+    rate_limit_mbps_ = root.get<uint64_t>("RateLimit.rate_limit_mbps");
+    rate_burst_size_ = root.get<uint64_t>("RateLimit.burst_size");
+    for (uint32_t i = 1; i <= SYNC_SEND_PHASE_NUM; i++) {
+        phase_weight_[i - 1] = root.get<uint64_t>("RateLimit.p" + to_string(i) + "_weight");
+    }
+    for (auto& item : root.get_child("RateLimit.schedule")) {
+        RateSchedule_t schedule;
+        schedule.start_min = this->ParseTimeOfDay(item.second.get<string>("start"));
+        schedule.end_min = this->ParseTimeOfDay(item.second.get<string>("end"));
+        schedule.rate_limit_mbps = item.second.get<uint64_t>("rate_limit_mbps");
+        rate_schedule_.push_back(schedule);
+    }
+
+    // durability settings (group commit)
+    group_commit_container_num_ = root.get<uint64_t>("Durability.group_commit_container_num");
+    group_commit_interval_ms_ = root.get<uint64_t>("Durability.group_commit_interval_ms");
+    index_delta_log_name_ = root.get<string>("Durability.index_delta_log_name");
+    commit_manifest_name_ = root.get<string>("Durability.commit_manifest_name");
+
+    // resumable sync settings (checkpoint)
+    sync_checkpoint_name_ = root.get<string>("Durability.sync_checkpoint_name");
+    checkpoint_batch_num_ = root.get<uint64_t>("Durability.checkpoint_batch_num");
+
+    // incremental sync settings (recipe watermark)
+    watermark_name_ = root.get<string>("Incremental.watermark_name");
+
+    // daemon settings
+    daemon_settle_ms_ = root.get<uint64_t>("Daemon.settle_ms");
+
+    // graceful stop settings
+    drain_timeout_sec_ = root.get<uint64_t>("Shutdown.drain_timeout_sec");
+
+    // schedule settings (the order of the files)
+    string schedule_policy = root.get<string>("Schedule.policy");
+    if (schedule_policy == "mtime") {
+        schedule_policy_ = SCHEDULE_MTIME;
+    }
+    else if (schedule_policy == "size") {
+        schedule_policy_ = SCHEDULE_SIZE;
+    }
+    else if (schedule_policy == "priority") {
+        schedule_policy_ = SCHEDULE_PRIORITY;
+    }
+    else if (schedule_policy == "fair_share") {
+        schedule_policy_ = SCHEDULE_FAIR_SHARE;
+    }
+    else {
+        tool::Logging(my_name_.c_str(), "wrong schedule policy %s.\n", schedule_policy.c_str());
+        exit(EXIT_FAILURE);
+    }
+    priority_list_name_ = root.get<string>("Schedule.priority_list_name");
+    for (auto& item : root.get_child("Schedule.dir_weight")) {
+        SyncDirWeight_t dir_weight;
+        dir_weight.dir = item.second.get<string>("dir");
+        dir_weight.weight = item.second.get<uint64_t>("weight");
+        if (dir_weight.weight == 0) {
+            tool::Logging(my_name_.c_str(), "the weight of %s should be at least 1.\n",
+                dir_weight.dir.c_str());
+            exit(EXIT_FAILURE);
+        }
+        dir_weight_list_.push_back(dir_weight);
+    }
+
     return ;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief parse the time of day ("HH:MM")
+ * 
+ * @param time_str 
+ * @return uint32_t minutes since 00:00
+ */
+uint32_t SyncConfigure::ParseTimeOfDay(string time_str) {
+    uint32_t hour = 0;
+    uint32_t minute = 0;
+    if (sscanf(time_str.c_str(), "%u:%u", &hour, &minute) != 2 || hour > 24 || 
+        minute >= 60 || hour * 60 + minute > 24 * 60) {
+        tool::Logging(my_name_.c_str(), "wrong time of day %s in the rate schedule.\n",
+            time_str.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    return hour * 60 + minute;
+}
@@ -41,6 +41,11 @@ SyncDataWriter::SyncDataWriter(sgx_enclave_id_t sgx_eid, AbsDatabase* out_fp_db)
         sync_config.GetDataBatchSize());
     debug_index_.queryNum = 0;
 
+    // for integrity check
+    check_index_.OutChunkQueryBase = (OutChunkQueryEntry_t*) malloc(sizeof(OutChunkQueryEntry_t) * 
+        sync_config.GetMetaBatchSize());
+    check_index_.queryNum = 0;
+
     // container write buffer
     container_buf_.currentSize = 0;
     container_buf_.currentMetaSize = 0;
@@ -84,6 +89,7 @@ SyncDataWriter::~SyncDataWriter() {
     free(update_index_.OutChunkQueryBase);
 
     free(debug_index_.OutChunkQueryBase);
+    free(check_index_.OutChunkQueryBase);
 
     // // delete container_buf_;
     // free(container_buf_.containerID);
@@ -98,6 +104,7 @@ SyncDataWriter::~SyncDataWriter() {
  * @param recv_size 
  */
 void SyncDataWriter::ProcessOneBatch(uint8_t* recv_buf, uint32_t recv_size) {
+    std::lock_guard<std::mutex> lck(writer_mutex_);
 #if (PHASE_BREAKDOWN == 1)
     gettimeofday(&phase6_stime, NULL);
 #endif
@@ -131,6 +138,7 @@ void SyncDataWriter::ProcessOneBatch(uint8_t* recv_buf, uint32_t recv_size) {
  * 
  */
 void SyncDataWriter::ProcessTailBatch() {
+    std::lock_guard<std::mutex> lck(writer_mutex_);
 #if (PHASE_BREAKDOWN == 1)
     gettimeofday(&phase6_stime, NULL);
 #endif
@@ -142,9 +150,12 @@ void SyncDataWriter::ProcessTailBatch() {
 
     // update the tail metadata
     if (update_index_.queryNum != 0) {
-        Ocall_UpdateOutFPIndex((void*)&update_index_);
+        Ocall_InsertOutFPIndex((void*)&update_index_);
     }
 
+    // persist the containers and index delta of this file
+    SyncOutEnclave::ForceGroupCommit();
+
 #if (RECOVER_CHECK == 1)
     // debug
     if (debug_index_.queryNum != 0) {
@@ -158,4 +169,161 @@ void SyncDataWriter::ProcessTailBatch() {
 #endif
 
     return ;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief add the chunks (from phase-4) expected to be written
+ * 
+ * @param file_id 
+ * @param entry_list 
+ * @param entry_num 
+ */
+void SyncDataWriter::AddExpectedChunk(uint32_t file_id, uint8_t* entry_list, uint32_t entry_num) {
+    StreamPhase4MQ_t* tmp_entry = (StreamPhase4MQ_t*)entry_list;
+    string tmp_fp;
+
+    std::lock_guard<std::mutex> lck(expected_fp_mutex_);
+    vector<string>& file_fp_list = expected_fp_list_[file_id];
+    for (size_t i = 0; i < entry_num; i++) {
+        tmp_fp.assign((char*)tmp_entry->chunkHash, CHUNK_HASH_SIZE);
+        file_fp_list.push_back(tmp_fp);
+        tmp_entry ++;
+    }
+
+    return ;
+}
+
+/**
+ * @brief check whether the expected chunks of a file have been written
+ * 
+ * @param file_id 
+ * @param fail_fp_list the chunks failing the check
+ */
+void SyncDataWriter::CheckIntegrity(uint32_t file_id, vector<string>& fail_fp_list) {
+    std::lock_guard<std::mutex> lck(expected_fp_mutex_);
+    auto find_it = expected_fp_list_.find(file_id);
+    if (find_it == expected_fp_list_.end()) {
+        // no chunk of this file to write
+        return ;
+    }
+    vector<string>& file_fp_list = find_it->second;
+    this->CheckWritten(file_fp_list, file_fp_list.size(), fail_fp_list);
+    // all the checkpoint markers of this file come before its end
+    checkpoint_fp_num_.erase(file_id);
+
+    // only the failed chunks are expected in the next resend round
+    if (fail_fp_list.empty()) {
+        expected_fp_list_.erase(find_it);
+    }
+    else {
+        file_fp_list = fail_fp_list;
+    }
+
+    return ;
+}
+
+/**
+ * @brief clear the expected chunks of a file
+ * 
+ * @param file_id 
+ */
+void SyncDataWriter::ClearExpectedChunk(uint32_t file_id) {
+    std::lock_guard<std::mutex> lck(expected_fp_mutex_);
+    expected_fp_list_.erase(file_id);
+    checkpoint_fp_num_.erase(file_id);
+
+    return ;
+}
+
+/**
+ * @brief mark a checkpoint after the expected chunks added so far (phase-4)
+ * 
+ * @param file_id 
+ */
+void SyncDataWriter::MarkCheckpoint(uint32_t file_id) {
+    std::lock_guard<std::mutex> lck(expected_fp_mutex_);
+    size_t fp_num = 0;
+    auto find_it = expected_fp_list_.find(file_id);
+    if (find_it != expected_fp_list_.end()) {
+        fp_num = find_it->second.size();
+    }
+    checkpoint_fp_num_[file_id].push_back(fp_num);
+
+    return ;
+}
+
+/**
+ * @brief check the expected chunks before the next checkpoint of a file
+ * 
+ * @param file_id 
+ * @return true all of them (and the earlier ones) have been written
+ * @return false 
+ */
+bool SyncDataWriter::CheckCheckpoint(uint32_t file_id) {
+    std::lock_guard<std::mutex> lck(expected_fp_mutex_);
+    auto num_it = checkpoint_fp_num_.find(file_id);
+    if (num_it == checkpoint_fp_num_.end() || num_it->second.empty()) {
+        tool::Logging(my_name_.c_str(), "no checkpoint of file %u to check.\n", file_id);
+        return false;
+    }
+    size_t check_num = num_it->second.front();
+    num_it->second.pop_front();
+
+    vector<string> fail_fp_list;
+    auto find_it = expected_fp_list_.find(file_id);
+    if (find_it != expected_fp_list_.end() && check_num != 0) {
+        vector<string>& file_fp_list = find_it->second;
+        this->CheckWritten(file_fp_list, check_num, fail_fp_list);
+
+        // drop the written chunks, the failed ones stay before the next checkpoint 
+        // (checked again at the file end)
+        file_fp_list.erase(file_fp_list.begin(), file_fp_list.begin() + check_num);
+        file_fp_list.insert(file_fp_list.begin(), fail_fp_list.begin(), fail_fp_list.end());
+        size_t pass_num = check_num - fail_fp_list.size();
+        for (auto& fp_num : num_it->second) {
+            fp_num -= pass_num;
+        }
+    }
+    if (num_it->second.empty()) {
+        checkpoint_fp_num_.erase(num_it);
+    }
+
+    return fail_fp_list.empty();
+}
+
+/**
+ * @brief check the first chunks of the expected list (hold expected_fp_mutex_)
+ * 
+ * @param fp_list 
+ * @param fp_num 
+ * @param fail_fp_list the chunks failing the check
+ */
+void SyncDataWriter::CheckWritten(vector<string>& fp_list, size_t fp_num, vector<string>& fail_fp_list) {
+    size_t check_batch_size = sync_config.GetMetaBatchSize();
+    size_t checked_num = 0;
+    while (checked_num < fp_num) {
+        size_t cur_num = min(check_batch_size, fp_num - checked_num);
+        OutChunkQueryEntry_t* tmp_entry = check_index_.OutChunkQueryBase;
+        for (size_t i = 0; i < cur_num; i++) {
+            memcpy(tmp_entry->chunkHash, fp_list[checked_num + i].c_str(),
+                CHUNK_HASH_SIZE);
+            tmp_entry ++;
+        }
+        check_index_.queryNum = cur_num;
+
+        Ecall_Stream_Phase6_CheckIntegrity(sgx_eid_, &check_index_);
+
+        tmp_entry = check_index_.OutChunkQueryBase;
+        for (size_t i = 0; i < cur_num; i++) {
+            if (tmp_entry->dedupFlag != DUPLICATE) {
+                // not written (e.g., dropped delta or corrupted base)
+                fail_fp_list.push_back(fp_list[checked_num + i]);
+            }
+            tmp_entry ++;
+        }
+        checked_num += cur_num;
+    }
+    check_index_.queryNum = 0;
+
+    return ;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file sync_local_transport.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_local_transport.h
+ * @version 0.1
+ * @date 2024-09-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_local_transport.h"
+
+/**
+ * @brief Construct a new Sync Local Transport object
+ *
+ */
+SyncLocalTransport::SyncLocalTransport() {
+}
+
+/**
+ * @brief Destroy the Sync Local Transport object
+ *
+ */
+SyncLocalTransport::~SyncLocalTransport() {
+}
+
+/**
+ * @brief start to carry the messages
+ *
+ */
+void SyncLocalTransport::Start() {
+    std::lock_guard<std::mutex> lck(queue_mutex_);
+    is_closed_ = false;
+
+    return ;
+}
+
+/**
+ * @brief stop after the queued messages are received
+ *
+ */
+void SyncLocalTransport::Stop() {
+    {
+        std::lock_guard<std::mutex> lck(queue_mutex_);
+        is_closed_ = true;
+    }
+    recv_cond_.notify_all();
+
+    return ;
+}
+
+/**
+ * @brief send a message to the given phase
+ *
+ * @param recv_phase_id
+ * @param data
+ * @param size
+ */
+void SyncLocalTransport::SendFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t size) {
+    if (recv_phase_id >= MUX_PHASE_NUM) {
+        tool::Logging(my_name_.c_str(), "wrong phase id %u in send.\n", recv_phase_id);
+        exit(EXIT_FAILURE);
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(queue_mutex_);
+        recv_queue_[recv_phase_id].emplace_back((char*)data, size);
+    }
+    recv_cond_.notify_all();
+
+    return ;
+}
+
+/**
+ * @brief recv a message of the given phase
+ *
+ * @param recv_phase_id
+ * @param data
+ * @param size
+ * @return true success
+ * @return false the transport is stopped and no message left
+ */
+bool SyncLocalTransport::RecvFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t& size) {
+    std::unique_lock<std::mutex> lck(queue_mutex_);
+    recv_cond_.wait(lck, [this, recv_phase_id] {
+        return !recv_queue_[recv_phase_id].empty() || is_closed_;
+    });
+
+    if (recv_queue_[recv_phase_id].empty()) {
+        return false;
+    }
+
+    string& frame = recv_queue_[recv_phase_id].front();
+    memcpy(data, frame.c_str(), frame.size());
+    size = frame.size();
+    recv_queue_[recv_phase_id].pop_front();
+
+    return true;
+}
+
+/**
+ * @brief check whether the transport is stopped
+ *
+ * @return true
+ * @return false
+ */
+bool SyncLocalTransport::IsClosed() {
+    std::lock_guard<std::mutex> lck(queue_mutex_);
+    return is_closed_;
+}
+
+/**
+ * @brief return the credits to the given phase (sender)
+ *
+ * @param send_phase_id
+ * @param credit_num
+ */
+void SyncLocalTransport::SendCredit(uint8_t send_phase_id, uint32_t credit_num) {
+    if (send_phase_id >= MUX_PHASE_NUM || flow_credit_list_[send_phase_id] == nullptr) {
+        tool::Logging(my_name_.c_str(), "no sender of phase %u for credits.\n", send_phase_id);
+        return ;
+    }
+    flow_credit_list_[send_phase_id]->Grant(credit_num);
+
+    return ;
+}
+
+/**
+ * @brief Set the Flow Credit object of a sender
+ *
+ * @param send_phase_id
+ * @param flow_credit
+ */
+void SyncLocalTransport::SetFlowCredit(uint8_t send_phase_id, FlowCredit* flow_credit) {
+    if (send_phase_id >= MUX_PHASE_NUM) {
+        tool::Logging(my_name_.c_str(), "wrong phase id %u for credits.\n", send_phase_id);
+        exit(EXIT_FAILURE);
+    }
+    flow_credit_list_[send_phase_id] = flow_credit;
+
+    return ;
+}
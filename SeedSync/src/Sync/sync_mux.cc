@@ -0,0 +1,487 @@
+/**
+ * @file sync_mux.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_mux.h
+ * @version 0.1
+ * @date 2024-08-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_mux.h"
+
+/**
+ * @brief Construct a new Sync Mux object
+ *
+ * @param mux_channel
+ * @param conn_type IN_CLIENTSIDE (source) / IN_SERVERSIDE (dest)
+ */
+SyncMux::SyncMux(SSLConnection* mux_channel, int conn_type) {
+    mux_channel_ = mux_channel;
+    conn_type_ = conn_type;
+
+    read_buf_ = (uint8_t*) malloc(MUX_READ_BUF_SIZE);
+}
+
+/**
+ * @brief Destroy the Sync Mux object
+ *
+ */
+SyncMux::~SyncMux() {
+    if (io_thd_ != nullptr) {
+        delete io_thd_;
+    }
+    free(read_buf_);
+}
+
+/**
+ * @brief start the I/O thread (the client side connects first)
+ *
+ */
+void SyncMux::Start() {
+    if (conn_type_ == IN_CLIENTSIDE) {
+        mux_conn_record_ = mux_channel_->ConnectSSL();
+        this->SetNonBlocking();
+        is_connected_ = true;
+    }
+    else if (is_one_session_) {
+        // both clouds send from the start, accept before any frame is queued
+        mux_conn_record_ = mux_channel_->ListenSSL();
+        this->SetNonBlocking();
+        is_connected_ = true;
+    }
+
+    io_thd_ = new boost::thread(boost::bind(&SyncMux::Run, this));
+
+    return ;
+}
+
+/**
+ * @brief carry one session only, with both clouds sending over it
+ * (call before start)
+ *
+ */
+void SyncMux::SetOneSession() {
+    is_one_session_ = true;
+
+    return ;
+}
+
+/**
+ * @brief stop the I/O thread after flushing the pending frames
+ *
+ */
+void SyncMux::Stop() {
+    {
+        std::unique_lock<std::mutex> lck(send_mutex_);
+        flush_cond_.wait(lck, [this] {
+            return pending_frame_num_ == 0 || !is_connected_;
+        });
+        if (is_one_session_ && conn_type_ == IN_CLIENTSIDE) {
+            // the server side closes first, keep reading (e.g., the late credits)
+            // such that the frames of the server are not reset
+            flush_cond_.wait(lck, [this] {
+                return !is_connected_;
+            });
+        }
+    }
+
+    done_flag_ = true;
+    io_thd_->join();
+
+    if (is_connected_) {
+        mux_channel_->ClearAcceptedClientSd(mux_conn_record_.second);
+        is_connected_ = false;
+    }
+
+    {
+        // wake up the receivers still waiting
+        std::lock_guard<std::mutex> lck(recv_mutex_);
+        is_closed_ = true;
+    }
+    recv_cond_.notify_all();
+
+    return ;
+}
+
+/**
+ * @brief send a message to the given phase of the other cloud
+ *
+ * @param recv_phase_id
+ * @param data
+ * @param size
+ */
+void SyncMux::SendFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t size) {
+    if (recv_phase_id >= MUX_PHASE_NUM) {
+        tool::Logging(my_name_.c_str(), "wrong phase id %u in send.\n", recv_phase_id);
+        exit(EXIT_FAILURE);
+    }
+
+    string frame;
+    frame.resize(MUX_FRAME_HEAD_SIZE + size);
+    memcpy(&frame[0], &size, sizeof(uint32_t));
+    frame[sizeof(uint32_t)] = (char)recv_phase_id;
+    memcpy(&frame[MUX_FRAME_HEAD_SIZE], data, size);
+
+    std::lock_guard<std::mutex> lck(send_mutex_);
+    send_queue_[recv_phase_id].push_back(std::move(frame));
+    pending_frame_num_ ++;
+
+    return ;
+}
+
+/**
+ * @brief return the credits to the given phase (sender) of the other cloud
+ *
+ * @param send_phase_id
+ * @param credit_num
+ */
+void SyncMux::SendCredit(uint8_t send_phase_id, uint32_t credit_num) {
+    uint32_t size = sizeof(uint32_t);
+    string frame;
+    frame.resize(MUX_FRAME_HEAD_SIZE + size);
+    memcpy(&frame[0], &size, sizeof(uint32_t));
+    frame[sizeof(uint32_t)] = (char)(send_phase_id | MUX_CREDIT_FLAG);
+    memcpy(&frame[MUX_FRAME_HEAD_SIZE], &credit_num, sizeof(uint32_t));
+
+    std::lock_guard<std::mutex> lck(send_mutex_);
+    send_queue_[0].push_back(std::move(frame));
+    pending_frame_num_ ++;
+
+    return ;
+}
+
+/**
+ * @brief Set the Flow Credit object of a local sender
+ *
+ * @param send_phase_id
+ * @param flow_credit
+ */
+void SyncMux::SetFlowCredit(uint8_t send_phase_id, FlowCredit* flow_credit) {
+    if (send_phase_id >= MUX_PHASE_NUM) {
+        tool::Logging(my_name_.c_str(), "wrong phase id %u for credits.\n", send_phase_id);
+        exit(EXIT_FAILURE);
+    }
+    flow_credit_list_[send_phase_id] = flow_credit;
+
+    return ;
+}
+
+/**
+ * @brief recv a message of the given phase
+ *
+ * @param recv_phase_id
+ * @param data
+ * @param size
+ * @return true success
+ * @return false the connection is closed, or the session is reset
+ */
+bool SyncMux::RecvFrame(uint8_t recv_phase_id, uint8_t* data, uint32_t& size) {
+    std::unique_lock<std::mutex> lck(recv_mutex_);
+    is_recv_phase_[recv_phase_id] = true;
+    recv_cond_.wait(lck, [this, recv_phase_id] {
+        return !recv_queue_[recv_phase_id].empty() || is_closed_;
+    });
+
+    if (recv_queue_[recv_phase_id].empty()) {
+        return false;
+    }
+    if (recv_queue_[recv_phase_id].front().empty()) {
+        // the session ends here, the frames behind belong to the next one
+        recv_queue_[recv_phase_id].pop_front();
+        return false;
+    }
+
+    string& frame = recv_queue_[recv_phase_id].front();
+    memcpy(data, frame.c_str(), frame.size());
+    size = frame.size();
+    recv_queue_[recv_phase_id].pop_front();
+
+    return true;
+}
+
+/**
+ * @brief check whether the mux is closed (otherwise a failed recv is
+ * a reset session)
+ *
+ * @return true
+ * @return false
+ */
+bool SyncMux::IsClosed() {
+    std::lock_guard<std::mutex> lck(recv_mutex_);
+    return is_closed_;
+}
+
+/**
+ * @brief the main loop of the I/O thread
+ *
+ */
+void SyncMux::Run() {
+    while (!done_flag_) {
+        if (!is_connected_) {
+            if (conn_type_ == IN_CLIENTSIDE || is_one_session_) {
+                // the other cloud closed the connection
+                break;
+            }
+
+            // dest: wait for the next sync session
+            pair<int, SSL*> conn_record = mux_channel_->ListenSSL();
+            std::lock_guard<std::mutex> lck(send_mutex_);
+            mux_conn_record_ = conn_record;
+            this->SetNonBlocking();
+            is_connected_ = true;
+        }
+
+        struct pollfd poll_fd;
+        poll_fd.fd = mux_conn_record_.first;
+        poll_fd.events = POLLIN;
+        poll_fd.revents = 0;
+        {
+            std::lock_guard<std::mutex> lck(send_mutex_);
+            if (pending_frame_num_ != 0) {
+                poll_fd.events |= POLLOUT;
+            }
+        }
+        if (SSL_pending(mux_conn_record_.second) == 0) {
+            poll(&poll_fd, 1, MUX_POLL_TIMEOUT_MS);
+        }
+
+        if (!this->ReadFrames() || !this->WriteFrames()) {
+            this->CloseSession();
+        }
+        this->DeliverBacklog();
+    }
+
+    return ;
+}
+
+/**
+ * @brief read the available frames from the connection
+ *
+ * @return true the connection is alive
+ * @return false the connection is closed
+ */
+bool SyncMux::ReadFrames() {
+    // keep reading even if some phase cannot catch up, its sender is held back
+    // by the credits while the frames of the other phases go on
+    while (true) {
+        int ret = SSL_read(mux_conn_record_.second, read_buf_, MUX_READ_BUF_SIZE);
+        if (ret > 0) {
+            in_buf_.append((char*)read_buf_, ret);
+            this->DispatchFrames();
+            continue;
+        }
+
+        int err = SSL_get_error(mux_conn_record_.second, ret);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            return true;
+        }
+        return false;
+    }
+}
+
+/**
+ * @brief write the pending frames to the connection
+ *
+ * @return true the connection is alive
+ * @return false the connection is closed
+ */
+bool SyncMux::WriteFrames() {
+    while (true) {
+        if (!is_out_frame_ && !this->NextOutFrame()) {
+            return true;
+        }
+
+        int ret = SSL_write(mux_conn_record_.second, out_frame_.c_str() + out_offset_,
+            out_frame_.size() - out_offset_);
+        if (ret > 0) {
+            out_offset_ += ret;
+            if (out_offset_ == out_frame_.size()) {
+                is_out_frame_ = false;
+                std::lock_guard<std::mutex> lck(send_mutex_);
+                pending_frame_num_ --;
+                if (pending_frame_num_ == 0) {
+                    flush_cond_.notify_all();
+                }
+            }
+            continue;
+        }
+
+        int err = SSL_get_error(mux_conn_record_.second, ret);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            return true;
+        }
+        return false;
+    }
+}
+
+/**
+ * @brief pick the next frame to write (round-robin among phases)
+ *
+ * @return true get a frame
+ * @return false no pending frame
+ */
+bool SyncMux::NextOutFrame() {
+    std::lock_guard<std::mutex> lck(send_mutex_);
+    for (uint32_t i = 1; i <= MUX_PHASE_NUM; i++) {
+        uint8_t phase_id = (last_send_phase_ + i) % MUX_PHASE_NUM;
+        if (!send_queue_[phase_id].empty()) {
+            out_frame_.swap(send_queue_[phase_id].front());
+            send_queue_[phase_id].pop_front();
+            out_offset_ = 0;
+            is_out_frame_ = true;
+            last_send_phase_ = phase_id;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief dispatch the whole frames in the in-buffer to the recv queues
+ *
+ */
+void SyncMux::DispatchFrames() {
+    size_t offset = 0;
+    while (in_buf_.size() - offset >= MUX_FRAME_HEAD_SIZE) {
+        uint32_t payload_size;
+        memcpy(&payload_size, in_buf_.c_str() + offset, sizeof(uint32_t));
+        uint8_t phase_id = (uint8_t)in_buf_[offset + sizeof(uint32_t)];
+        if (in_buf_.size() - offset - MUX_FRAME_HEAD_SIZE < payload_size) {
+            // wait for the rest of this frame
+            break;
+        }
+        if (phase_id & MUX_CREDIT_FLAG) {
+            // the credits returned to a local sender
+            uint8_t send_phase_id = phase_id & ~MUX_CREDIT_FLAG;
+            uint32_t credit_num;
+            memcpy(&credit_num, in_buf_.c_str() + offset + MUX_FRAME_HEAD_SIZE, sizeof(uint32_t));
+            if (send_phase_id < MUX_PHASE_NUM && flow_credit_list_[send_phase_id] != nullptr) {
+                flow_credit_list_[send_phase_id]->Grant(credit_num);
+            }
+
+            offset += MUX_FRAME_HEAD_SIZE + payload_size;
+            continue;
+        }
+        if (phase_id >= MUX_PHASE_NUM) {
+            tool::Logging(my_name_.c_str(), "wrong phase id %u in recv.\n", phase_id);
+            exit(EXIT_FAILURE);
+        }
+
+        {
+            std::lock_guard<std::mutex> lck(recv_mutex_);
+            if (backlog_[phase_id].empty() &&
+                recv_queue_[phase_id].size() < MUX_RECV_QUEUE_SIZE) {
+                recv_queue_[phase_id].emplace_back(in_buf_, offset + MUX_FRAME_HEAD_SIZE,
+                    payload_size);
+            }
+            else {
+                // keep the order behind the held-back frames of this phase
+                backlog_[phase_id].emplace_back(in_buf_, offset + MUX_FRAME_HEAD_SIZE,
+                    payload_size);
+            }
+        }
+        recv_cond_.notify_all();
+
+        offset += MUX_FRAME_HEAD_SIZE + payload_size;
+    }
+
+    if (offset != 0) {
+        in_buf_.erase(0, offset);
+    }
+
+    return ;
+}
+
+/**
+ * @brief move the held-back frames to the recv queues with free space
+ *
+ */
+void SyncMux::DeliverBacklog() {
+    bool is_delivered = false;
+    {
+        std::lock_guard<std::mutex> lck(recv_mutex_);
+        for (uint32_t i = 0; i < MUX_PHASE_NUM; i++) {
+            while (!backlog_[i].empty() && recv_queue_[i].size() < MUX_RECV_QUEUE_SIZE) {
+                recv_queue_[i].push_back(std::move(backlog_[i].front()));
+                backlog_[i].pop_front();
+                is_delivered = true;
+            }
+        }
+    }
+    if (is_delivered) {
+        recv_cond_.notify_all();
+    }
+
+    return ;
+}
+
+/**
+ * @brief set the connection as non-blocking after the handshake
+ *
+ */
+void SyncMux::SetNonBlocking() {
+    int flags = fcntl(mux_conn_record_.first, F_GETFL, 0);
+    if (fcntl(mux_conn_record_.first, F_SETFL, flags | O_NONBLOCK) < 0) {
+        tool::Logging(my_name_.c_str(), "cannot set the mux connection as non-blocking.\n");
+        exit(EXIT_FAILURE);
+    }
+    SSL_set_mode(mux_conn_record_.second, SSL_MODE_ENABLE_PARTIAL_WRITE |
+        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    return ;
+}
+
+/**
+ * @brief clear the closed connection (and the frames of this session)
+ *
+ */
+void SyncMux::CloseSession() {
+    mux_channel_->ClearAcceptedClientSd(mux_conn_record_.second);
+
+    in_buf_.clear();
+    out_frame_.clear();
+    out_offset_ = 0;
+    is_out_frame_ = false;
+
+    {
+        // the pending frames belong to the closed session
+        std::lock_guard<std::mutex> lck(send_mutex_);
+        for (uint32_t i = 0; i < MUX_PHASE_NUM; i++) {
+            send_queue_[i].clear();
+        }
+        pending_frame_num_ = 0;
+        is_connected_ = false;
+    }
+    flush_cond_.notify_all();
+
+    if (conn_type_ == IN_CLIENTSIDE || is_one_session_) {
+        std::lock_guard<std::mutex> lck(recv_mutex_);
+        is_closed_ = true;
+        recv_cond_.notify_all();
+        return ;
+    }
+
+    // dest: each receiver sees the end of the session after the frames of it,
+    // and drops the state of a broken session before the next one
+    {
+        std::lock_guard<std::mutex> lck(recv_mutex_);
+        for (uint32_t i = 0; i < MUX_PHASE_NUM; i++) {
+            if (is_recv_phase_[i]) {
+                backlog_[i].emplace_back();
+            }
+        }
+    }
+    this->DeliverBacklog();
+
+    // the receivers of the next session hold no batch of the local senders
+    for (uint32_t i = 0; i < MUX_PHASE_NUM; i++) {
+        if (flow_credit_list_[i] != nullptr) {
+            flow_credit_list_[i]->Reset();
+        }
+    }
+
+    return ;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file sync_rate_limiter.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_rate_limiter.h
+ * @version 0.1
+ * @date 2024-08-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_rate_limiter.h"
+
+/**
+ * @brief Construct a new Sync Rate Limiter object
+ *
+ */
+SyncRateLimiter::SyncRateLimiter() {
+    burst_size_ = sync_config.GetRateBurstSize();
+    token_num_ = burst_size_;
+    gettimeofday(&last_refill_time_, NULL);
+
+    for (uint32_t i = 1; i <= SYNC_SEND_PHASE_NUM; i++) {
+        if (sync_config.GetPhaseWeight(i) == 0) {
+            tool::Logging(my_name_.c_str(), "the weight of phase-%u should not be 0.\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * @brief Destroy the Sync Rate Limiter object
+ *
+ */
+SyncRateLimiter::~SyncRateLimiter() {
+    ;
+}
+
+/**
+ * @brief wait until the message of the phase can be sent under the rate limit
+ *
+ * @param phase_id
+ * @param size
+ */
+void SyncRateLimiter::Acquire(uint8_t phase_id, uint32_t size) {
+    std::unique_lock<std::mutex> lck(rate_mutex_);
+
+    // the virtual finish time of this message
+    double finish_vtime = max(phase_vtime_[phase_id], global_vtime_) + 
+        (double)size / sync_config.GetPhaseWeight(phase_id);
+    phase_vtime_[phase_id] = finish_vtime;
+    pair<double, uint64_t> wait_entry = make_pair(finish_vtime, next_ticket_);
+    next_ticket_ ++;
+    wait_list_.insert(wait_entry);
+
+    while (true) {
+        if (*wait_list_.begin() != wait_entry) {
+            // wait for the messages before
+            rate_cond_.wait(lck);
+            continue;
+        }
+
+        uint64_t rate = this->GetCurRate();
+        this->Refill(rate);
+        if (rate == 0 || token_num_ > 0) {
+            if (rate != 0) {
+                token_num_ -= size;
+            }
+            break;
+        }
+
+        // wait for the tokens (re-check the schedule at least every second)
+        uint64_t wait_us = (uint64_t)((1 - token_num_) * 1000000 / rate) + 1;
+        rate_cond_.wait_for(lck, std::chrono::microseconds(min(wait_us, 
+            (uint64_t)1000000)));
+    }
+
+    wait_list_.erase(wait_entry);
+    global_vtime_ = finish_vtime;
+    lck.unlock();
+    rate_cond_.notify_all();
+
+    return ;
+}
+
+/**
+ * @brief get the rate limit of current time (by the schedule)
+ *
+ * @return uint64_t bytes per second (0: unlimited)
+ */
+uint64_t SyncRateLimiter::GetCurRate() {
+    uint64_t rate_limit_mbps = sync_config.GetRateLimit();
+
+    vector<RateSchedule_t>& rate_schedule = sync_config.GetRateSchedule();
+    if (!rate_schedule.empty()) {
+        time_t cur_time = time(NULL);
+        struct tm local_time;
+        localtime_r(&cur_time, &local_time);
+        uint32_t cur_min = local_time.tm_hour * 60 + local_time.tm_min;
+
+        for (auto& schedule : rate_schedule) {
+            bool is_in = false;
+            if (schedule.start_min <= schedule.end_min) {
+                is_in = (cur_min >= schedule.start_min && cur_min < schedule.end_min);
+            }
+            else {
+                // across the midnight
+                is_in = (cur_min >= schedule.start_min || cur_min < schedule.end_min);
+            }
+
+            if (is_in) {
+                rate_limit_mbps = schedule.rate_limit_mbps;
+                break;
+            }
+        }
+    }
+
+    return rate_limit_mbps * 1000 * 1000 / 8;
+}
+
+/**
+ * @brief add the tokens since the last refill
+ *
+ * @param rate bytes per second
+ */
+void SyncRateLimiter::Refill(uint64_t rate) {
+    struct timeval cur_time;
+    gettimeofday(&cur_time, NULL);
+
+    if (rate == 0) {
+        token_num_ = burst_size_;
+    }
+    else {
+        token_num_ += tool::GetTimeDiff(last_refill_time_, cur_time) * rate;
+        token_num_ = min(token_num_, burst_size_);
+    }
+    last_refill_time_ = cur_time;
+
+    return ;
+}
@@ -0,0 +1,286 @@
+/**
+ * @file sync_scheduler.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_scheduler.h
+ * @version 0.1
+ * @date 2024-09-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_scheduler.h"
+
+/**
+ * @brief Construct a new Sync Scheduler object
+ *
+ * @param stream_phase_1_obj
+ */
+SyncScheduler::SyncScheduler(StreamPhase1Thd* stream_phase_1_obj) {
+    stream_phase_1_obj_ = stream_phase_1_obj;
+    policy_ = sync_config.GetSchedulePolicy();
+    recipe_root_path_ = config.GetRecipeRootPath();
+    recipe_suffix_ = config.GetRecipeSuffix();
+}
+
+/**
+ * @brief Destroy the Sync Scheduler object
+ *
+ */
+SyncScheduler::~SyncScheduler() {
+}
+
+/**
+ * @brief order the files of a session by the policy
+ *
+ * @param sync_file_list
+ * @param is_recipe_list the list holds the recipe names
+ */
+void SyncScheduler::Order(vector<string>& sync_file_list, bool is_recipe_list) {
+    if (sync_file_list.size() < 2) {
+        return ;
+    }
+
+    switch (policy_) {
+        case SCHEDULE_SIZE: {
+            this->OrderBySize(sync_file_list, is_recipe_list);
+            break;
+        }
+        case SCHEDULE_PRIORITY: {
+            this->OrderByPriority(sync_file_list, is_recipe_list);
+            break;
+        }
+        case SCHEDULE_FAIR_SHARE: {
+            this->OrderByFairShare(sync_file_list, is_recipe_list);
+            break;
+        }
+        default: {
+            // as selected
+            break;
+        }
+    }
+
+    return ;
+}
+
+/**
+ * @brief get the recipe name of an entry in the list
+ *
+ * @param entry
+ * @param is_recipe_list
+ * @return string
+ */
+string SyncScheduler::GetRecipeName(string& entry, bool is_recipe_list) {
+    if (is_recipe_list) {
+        return entry;
+    }
+
+    return stream_phase_1_obj_->GetRecipeName(entry);
+}
+
+/**
+ * @brief check whether a file is under a dir (by whole path components)
+ *
+ * @param file_path
+ * @param dir
+ * @return size_t the length of the matched dir (0: not under it)
+ */
+size_t SyncScheduler::MatchDir(string& file_path, string& dir) {
+    size_t dir_len = dir.size();
+    while (dir_len > 1 && dir[dir_len - 1] == '/') {
+        dir_len --;
+    }
+    if (dir_len == 0 || file_path.compare(0, dir_len, dir, 0, dir_len) != 0) {
+        return 0;
+    }
+    // e.g., "/data/a" holds "/data/a/x" but not "/data/ab/x"
+    if (file_path.size() > dir_len && file_path[dir_len] != '/' && dir[dir_len - 1] != '/') {
+        return 0;
+    }
+
+    return dir_len;
+}
+
+/**
+ * @brief the smaller recipes first
+ *
+ * @param sync_file_list
+ * @param is_recipe_list
+ */
+void SyncScheduler::OrderBySize(vector<string>& sync_file_list, bool is_recipe_list) {
+    // the recipe size is in proportion to the num of chunks of the file
+    vector<pair<uint64_t, string>> sized_list;
+    for (auto& entry : sync_file_list) {
+        string recipe_path = recipe_root_path_ + this->GetRecipeName(entry, is_recipe_list) +
+            recipe_suffix_;
+        boost::system::error_code ec;
+        uint64_t recipe_size = fs::file_size(recipe_path, ec);
+        if (ec) {
+            // reported in phase-1
+            recipe_size = 0;
+        }
+        sized_list.push_back({recipe_size, entry});
+    }
+
+    std::stable_sort(sized_list.begin(), sized_list.end(), 
+        [](const pair<uint64_t, string>& a, const pair<uint64_t, string>& b) {
+            return a.first < b.first;
+        });
+
+    for (size_t i = 0; i < sized_list.size(); i++) {
+        sync_file_list[i] = sized_list[i].second;
+    }
+
+    return ;
+}
+
+/**
+ * @brief the files in the priority list first
+ *
+ * @param sync_file_list
+ * @param is_recipe_list
+ */
+void SyncScheduler::OrderByPriority(vector<string>& sync_file_list, bool is_recipe_list) {
+    string priority_list_name = sync_config.GetPriorityListName();
+    ifstream priority_hdl;
+    priority_hdl.open(priority_list_name, ios_base::in);
+    if (!priority_hdl.is_open()) {
+        tool::Logging(my_name_.c_str(), "no priority list %s, keep the order.\n",
+            priority_list_name.c_str());
+        return ;
+    }
+
+    // recipe name -> rank
+    std::unordered_map<string, uint64_t> rank_list;
+    string line;
+    while (getline(priority_hdl, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        string recipe_name = (line.size() == CHUNK_HASH_SIZE * 2 && 
+            line.find_first_not_of("0123456789abcdef") == string::npos) ? line :
+            stream_phase_1_obj_->GetRecipeName(line);
+        rank_list.insert({recipe_name, rank_list.size()});
+    }
+    priority_hdl.close();
+
+    vector<pair<uint64_t, string>> ranked_list;
+    uint64_t priority_num = 0;
+    for (auto& entry : sync_file_list) {
+        auto find_it = rank_list.find(this->GetRecipeName(entry, is_recipe_list));
+        if (find_it != rank_list.end()) {
+            ranked_list.push_back({find_it->second, entry});
+            priority_num ++;
+        }
+        else {
+            ranked_list.push_back({UINT64_MAX, entry});
+        }
+    }
+
+    std::stable_sort(ranked_list.begin(), ranked_list.end(),
+        [](const pair<uint64_t, string>& a, const pair<uint64_t, string>& b) {
+            return a.first < b.first;
+        });
+
+    for (size_t i = 0; i < ranked_list.size(); i++) {
+        sync_file_list[i] = ranked_list[i].second;
+    }
+
+    tool::Logging(my_name_.c_str(), "%lu of %lu files are in the priority list.\n",
+        priority_num, sync_file_list.size());
+
+    return ;
+}
+
+/**
+ * @brief weighted round-robin among the dirs
+ *
+ * @param sync_file_list
+ * @param is_recipe_list
+ */
+void SyncScheduler::OrderByFairShare(vector<string>& sync_file_list, bool is_recipe_list) {
+    vector<SyncDirWeight_t>& dir_weight_list = sync_config.GetDirWeightList();
+
+    // the recipes under the weighted dirs (recipe name -> dir index)
+    std::unordered_map<string, size_t> recipe_dir_list;
+    if (is_recipe_list) {
+        for (size_t i = 0; i < dir_weight_list.size(); i++) {
+            boost::system::error_code ec;
+            for (fs::recursive_directory_iterator it(dir_weight_list[i].dir, ec), end; 
+                !ec && it != end; it.increment(ec)) {
+                if (!fs::is_regular_file(it->path())) {
+                    continue;
+                }
+                string file_path = it->path().string();
+                string recipe_name = stream_phase_1_obj_->GetRecipeName(file_path);
+                auto find_it = recipe_dir_list.find(recipe_name);
+                if (find_it == recipe_dir_list.end()) {
+                    recipe_dir_list.insert({recipe_name, i});
+                }
+                else if (dir_weight_list[i].dir.size() > 
+                    dir_weight_list[find_it->second].dir.size()) {
+                    // a nested weighted dir: the longest one holding the file
+                    find_it->second = i;
+                }
+            }
+        }
+    }
+
+    // group the files (in the order of the first file of each group)
+    vector<std::deque<string>> group_list;
+    vector<uint64_t> group_weight;
+    std::unordered_map<string, size_t> group_index;
+    for (auto& entry : sync_file_list) {
+        string group_name;
+        uint64_t weight = 1;
+        if (is_recipe_list) {
+            auto find_it = recipe_dir_list.find(entry);
+            if (find_it != recipe_dir_list.end()) {
+                group_name = dir_weight_list[find_it->second].dir;
+                weight = dir_weight_list[find_it->second].weight;
+            }
+        }
+        else {
+            // the longest weighted dir holding the file, or its parent dir
+            group_name = fs::path(entry).parent_path().string();
+            size_t match_len = 0;
+            for (auto& dir_weight : dir_weight_list) {
+                size_t dir_len = this->MatchDir(entry, dir_weight.dir);
+                if (dir_len > match_len) {
+                    group_name = dir_weight.dir;
+                    weight = dir_weight.weight;
+                    match_len = dir_len;
+                }
+            }
+        }
+
+        auto find_it = group_index.find(group_name);
+        if (find_it == group_index.end()) {
+            find_it = group_index.insert({group_name, group_list.size()}).first;
+            group_list.emplace_back();
+            group_weight.push_back(weight);
+        }
+        group_list[find_it->second].push_back(entry);
+    }
+
+    sync_file_list.clear();
+    while (true) {
+        bool is_empty = true;
+        for (size_t i = 0; i < group_list.size(); i++) {
+            for (uint64_t j = 0; j < group_weight[i] && !group_list[i].empty(); j++) {
+                sync_file_list.push_back(group_list[i].front());
+                group_list[i].pop_front();
+            }
+            if (!group_list[i].empty()) {
+                is_empty = false;
+            }
+        }
+        if (is_empty) {
+            break;
+        }
+    }
+
+    tool::Logging(my_name_.c_str(), "share the session among %lu dirs.\n", group_list.size());
+
+    return ;
+}
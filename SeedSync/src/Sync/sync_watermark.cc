@@ -0,0 +1,247 @@
+/**
+ * @file sync_watermark.cc
+ * @author Jia Zhao (jzhao@cse.cuhk.edu.hk)
+ * @brief implement the interfaces defined in sync_watermark.h
+ * @version 0.1
+ * @date 2024-09-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "../../include/sync_watermark.h"
+
+extern Configure config;
+
+/**
+ * @brief Construct a new Sync Watermark object
+ *
+ * @param watermark_name the watermark path (of a dest)
+ */
+SyncWatermark::SyncWatermark(string watermark_name) {
+    watermark_name_ = watermark_name;
+    md_ctx_ = EVP_MD_CTX_new();
+    read_buf_ = (uint8_t*) malloc(WATERMARK_READ_BUF_SIZE);
+
+    this->Load();
+}
+
+/**
+ * @brief Destroy the Sync Watermark object
+ *
+ */
+SyncWatermark::~SyncWatermark() {
+    EVP_MD_CTX_free(md_ctx_);
+    free(read_buf_);
+}
+
+/**
+ * @brief load the watermark file
+ *
+ */
+void SyncWatermark::Load() {
+    ifstream watermark_hdl;
+    watermark_hdl.open(watermark_name_, ios_base::in);
+    if (!watermark_hdl.is_open()) {
+        // the first sync to this dest
+        return ;
+    }
+
+    string line;
+    while (getline(watermark_hdl, line)) {
+        istringstream line_stream(line);
+        string type;
+        line_stream >> type;
+        if (type == "mtime") {
+            line_stream >> watermark_time_;
+        }
+        else if (type == "recipe") {
+            string recipe_name;
+            string digest;
+            line_stream >> recipe_name >> digest;
+            recipe_digest_list_[recipe_name] = digest;
+        }
+    }
+    watermark_hdl.close();
+
+    tool::Logging(my_name_.c_str(), "load the watermark: mtime %ld, %lu recipes synced.\n",
+        (int64_t)watermark_time_, recipe_digest_list_.size());
+
+    return ;
+}
+
+/**
+ * @brief compute the digest of a recipe file
+ *
+ * @param recipe_path
+ * @param digest
+ */
+void SyncWatermark::GetRecipeDigest(string recipe_path, string& digest) {
+    ifstream recipe_hdl;
+    recipe_hdl.open(recipe_path, ios_base::in | ios_base::binary);
+    if (!recipe_hdl.is_open()) {
+        tool::Logging(my_name_.c_str(), "open recipe file failed %s.\n", recipe_path.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    if (!EVP_DigestInit_ex(md_ctx_, EVP_sha256(), NULL)) {
+        tool::Logging(my_name_.c_str(), "hash init error.\n");
+        exit(EXIT_FAILURE);
+    }
+    while (true) {
+        recipe_hdl.read((char*)read_buf_, WATERMARK_READ_BUF_SIZE);
+        size_t read_cnt = recipe_hdl.gcount();
+        if (read_cnt == 0) {
+            break;
+        }
+        if (!EVP_DigestUpdate(md_ctx_, read_buf_, read_cnt)) {
+            tool::Logging(my_name_.c_str(), "hash update error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    recipe_hdl.close();
+
+    uint8_t hash[CHUNK_HASH_SIZE];
+    if (!EVP_DigestFinal_ex(md_ctx_, hash, NULL)) {
+        tool::Logging(my_name_.c_str(), "hash final error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char hash_buf[CHUNK_HASH_SIZE * 2 + 1];
+    for (uint32_t i = 0; i < CHUNK_HASH_SIZE; i++) {
+        sprintf(hash_buf + i * 2, "%02x", hash[i]);
+    }
+    digest.assign(hash_buf, CHUNK_HASH_SIZE * 2);
+
+    return ;
+}
+
+/**
+ * @brief select the new or changed recipes since the watermark
+ *
+ * @param recipe_root_path
+ * @param recipe_list the selected recipe names (in the order of mtime)
+ */
+void SyncWatermark::SelectRecipes(string recipe_root_path, vector<string>& recipe_list) {
+    std::multimap<std::time_t, string> sorted_recipes;
+    string recipe_suffix = config.GetRecipeSuffix();
+    uint64_t total_num = 0;
+
+    pending_digest_list_.clear();
+    pending_time_ = watermark_time_;
+
+    for (const auto& entry : fs::directory_iterator(recipe_root_path)) {
+        if (!fs::is_regular_file(entry)) {
+            continue;
+        }
+        string file_name = entry.path().filename().string();
+        if (file_name.size() != CHUNK_HASH_SIZE * 2 + recipe_suffix.size() ||
+            file_name.compare(CHUNK_HASH_SIZE * 2, string::npos, recipe_suffix) != 0) {
+            continue;
+        }
+        total_num ++;
+
+        string recipe_name = file_name.substr(0, CHUNK_HASH_SIZE * 2);
+        std::time_t mtime = fs::last_write_time(entry);
+        auto find_it = recipe_digest_list_.find(recipe_name);
+        if (find_it != recipe_digest_list_.end() && mtime < watermark_time_) {
+            // not touched since the last sync (the recipes of the same second
+            // as the watermark are checked by the digest)
+            continue;
+        }
+
+        string digest;
+        this->GetRecipeDigest(entry.path().string(), digest);
+        if (find_it != recipe_digest_list_.end() && find_it->second == digest) {
+            // touched but not changed
+            continue;
+        }
+
+        sorted_recipes.insert({mtime, recipe_name});
+        pending_digest_list_[recipe_name] = digest;
+        pending_time_ = max(pending_time_, mtime);
+    }
+
+    for (auto& recipe : sorted_recipes) {
+        recipe_list.push_back(recipe.second);
+    }
+
+    tool::Logging(my_name_.c_str(), "select %lu new or changed recipes of %lu.\n",
+        recipe_list.size(), total_num);
+
+    return ;
+}
+
+/**
+ * @brief select the new or changed recipes among the given ones (e.g., 
+ * the completed recipes), the watermark mtime is kept
+ *
+ * @param recipe_root_path
+ * @param recipe_name_list
+ * @param recipe_list the selected recipe names (in the order of mtime)
+ */
+void SyncWatermark::SelectNamedRecipes(string recipe_root_path, vector<string>& recipe_name_list,
+    vector<string>& recipe_list) {
+    std::multimap<std::time_t, string> sorted_recipes;
+    string recipe_suffix = config.GetRecipeSuffix();
+
+    // the other recipes may be in writing, their mtime can be older than the 
+    // given ones: keep the watermark mtime such that a later scan checks them
+    pending_digest_list_.clear();
+    pending_time_ = watermark_time_;
+
+    for (auto& recipe_name : recipe_name_list) {
+        fs::path recipe_path(recipe_root_path + recipe_name + recipe_suffix);
+        boost::system::error_code ec;
+        std::time_t mtime = fs::last_write_time(recipe_path, ec);
+        if (ec) {
+            // removed (or moved away) since the event
+            continue;
+        }
+
+        // checked by the digest whatever the mtime is
+        string digest;
+        this->GetRecipeDigest(recipe_path.string(), digest);
+        auto find_it = recipe_digest_list_.find(recipe_name);
+        if (find_it != recipe_digest_list_.end() && find_it->second == digest) {
+            continue;
+        }
+
+        sorted_recipes.insert({mtime, recipe_name});
+        pending_digest_list_[recipe_name] = digest;
+    }
+
+    for (auto& recipe : sorted_recipes) {
+        recipe_list.push_back(recipe.second);
+    }
+
+    tool::Logging(my_name_.c_str(), "select %lu new or changed recipes of %lu completed.\n",
+        recipe_list.size(), recipe_name_list.size());
+
+    return ;
+}
+
+/**
+ * @brief advance the watermark after the selected recipes are synced
+ *
+ */
+void SyncWatermark::Commit() {
+    for (auto& recipe_digest : pending_digest_list_) {
+        recipe_digest_list_[recipe_digest.first] = recipe_digest.second;
+    }
+    watermark_time_ = pending_time_;
+    pending_digest_list_.clear();
+
+    string content = "mtime " + to_string((int64_t)watermark_time_) + "\n";
+    for (auto& recipe_digest : recipe_digest_list_) {
+        content += "recipe " + recipe_digest.first + " " + recipe_digest.second + "\n";
+    }
+
+    // a crash keeps the old watermark
+    if (!tool::PersistFile(watermark_name_, content)) {
+        tool::Logging(my_name_.c_str(), "fail to write the watermark.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return ;
+}